@@ -12,9 +12,188 @@ LICENSE:
 
 #include "avr-i2c-slave.h"
 
+// The application keeps a flight recorder (flightRecorder.h) and logs bus
+//  errors to it.  The bootloader doesn't have one.
+#ifdef FLIGHT_RECORDER_ENTRIES
+#include "flightRecorder.h"
+#define i2cLogError(s)  flightLogFromISR(0, FLIGHT_I2C_ERROR, (s))
+#else
+#define i2cLogError(s)
+#endif
+
 extern volatile uint8_t i2c_registerMap[];
-extern volatile uint8_t i2c_registerAttributes[];
 extern const uint8_t i2c_registerMapSize;
+
+#if defined(I2C_FRAME_MAX) || defined(I2C_PAGE_SIZE)
+#include <avr/pgmspace.h>
+#endif
+
+// Framed writes hold their data, sequence number and CRC here until the STOP
+#ifdef I2C_FRAME_MAX
+#define I2C_FRAME_BUFFER  (I2C_FRAME_MAX + 2)
+static uint8_t i2c_buffer[I2C_FRAME_BUFFER];
+#endif
+
+#ifdef I2C_PAGE_SIZE
+extern const I2CRegisterRange i2c_registerRanges[] PROGMEM;
+extern const uint8_t i2c_registerRangeCount;
+extern const I2CPage i2c_pages[] PROGMEM;
+extern const uint8_t i2c_pageCount;
+extern const uint8_t i2c_pageSelectReg;
+
+// Where the next byte of the page being read comes from, and how much of
+//  it is left
+static const uint8_t* i2c_pageAddr;
+static uint8_t i2c_pageCol = 0;
+static uint8_t i2c_pageLeft = 0;
+
+static inline bool i2cRegisterReadOnly(uint8_t registerIdx)
+{
+	uint8_t r;
+
+	for (r=0; r<i2c_registerRangeCount; r++)
+	{
+		if (registerIdx < pgm_read_byte(&i2c_registerRanges[r].first))
+			break;
+		if (registerIdx <= pgm_read_byte(&i2c_registerRanges[r].last))
+			return (pgm_read_byte(&i2c_registerRanges[r].attributes) & I2CREG_ATTR_READONLY);
+	}
+	return false;
+}
+
+// The main loop could be part way through an EEPROM access of its own, so
+//  put its address and data back afterwards.  Waiting out a write would
+//  hold off the PWM timer for milliseconds, so during one this reads 0xFF.
+static inline uint8_t i2cEepromRead(uint16_t addr)
+{
+	uint16_t savedAddr;
+	uint8_t savedData, data;
+
+	if (EECR & _BV(EEPE))
+		return 0xFF;
+
+	savedAddr = EEAR;
+	savedData = EEDR;
+	EEAR = addr;
+	EECR |= _BV(EERE);
+	data = EEDR;
+	EEAR = savedAddr;
+	EEDR = savedData;
+	return data;
+}
+
+static inline const I2CPage* i2cPage(void)
+{
+	return &i2c_pages[i2c_registerMap[i2c_pageSelectReg]];
+}
+
+// Each byte comes straight from the page's source as it goes out
+static inline uint8_t i2cPageNext(void)
+{
+	const I2CPage* page = i2cPage();
+	uint8_t source, data;
+
+	if (0 == i2c_pageLeft)
+		return 0xFF;
+
+	source = pgm_read_byte(&page->source);
+	if (I2C_PAGE_FLASH == source)
+		data = pgm_read_byte(i2c_pageAddr);
+	else if (I2C_PAGE_EEPROM == source)
+		data = i2cEepromRead((uintptr_t)i2c_pageAddr);
+	else
+		data = *i2c_pageAddr;
+
+	i2c_pageLeft--;
+	i2c_pageAddr++;
+	if (++i2c_pageCol >= pgm_read_byte(&page->width))
+	{
+		i2c_pageCol = 0;
+		i2c_pageAddr += pgm_read_byte(&page->stride) - pgm_read_byte(&page->width);
+	}
+	return data;
+}
+
+// Called as a read gets to the window, whether it started there or ran into
+//  it from the registers below, with how far into the page it starts
+static inline void i2cPageStart(uint8_t offset)
+{
+	const I2CPage* page = i2cPage();
+
+	i2c_pageLeft = 0;
+	if (i2c_registerMap[i2c_pageSelectReg] >= i2c_pageCount)
+		return;
+
+	i2c_pageAddr = (const uint8_t*)(uintptr_t)pgm_read_word(&page->addr);
+	i2c_pageCol = 0;
+	i2c_pageLeft = pgm_read_byte(&page->len);
+	if (i2c_pageLeft > I2C_PAGE_SIZE)
+		i2c_pageLeft = I2C_PAGE_SIZE;
+
+	// Only a read that starts part way into the window skips anything
+	while (offset-- && i2c_pageLeft)
+		i2cPageNext();
+}
+#else
+extern volatile uint8_t i2c_registerAttributes[];
+
+static inline bool i2cRegisterReadOnly(uint8_t registerIdx)
+{
+	return (i2c_registerAttributes[registerIdx] & I2CREG_ATTR_READONLY);
+}
+#endif
+
+#ifdef I2C_FRAME_MAX
+extern const uint8_t i2c_frameStatusReg;
+
+static uint8_t i2c_frameLen = 0;
+static uint8_t i2c_frameCrc = 0;
+static bool i2c_framed = false;
+
+// CRC-8 a nibble at a time, so the ISR only spends a couple of table
+//  lookups on each byte
+static const uint8_t i2c_crcNibble[16] PROGMEM =
+{
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+	0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+static inline uint8_t i2cCrc8(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	crc = (crc << 4) ^ pgm_read_byte(&i2c_crcNibble[crc >> 4]);
+	crc = (crc << 4) ^ pgm_read_byte(&i2c_crcNibble[crc >> 4]);
+	return crc;
+}
+
+// Running the CRC over the CRC byte too leaves zero when it's right
+static inline void i2cFrameCommit(uint8_t registerIdx)
+{
+	volatile uint8_t* status = &i2c_registerMap[i2c_frameStatusReg];
+	uint8_t dataLen = i2c_frameLen - 2;
+	uint8_t i;
+
+	// Just the register byte, setting up a read
+	if (0 == i2c_frameLen)
+		return;
+
+	if (i2c_frameLen < 2 || i2c_frameLen > I2C_FRAME_BUFFER || 0 != i2c_frameCrc
+		|| (uint16_t)registerIdx + dataLen > i2c_registerMapSize)
+	{
+		if (status[I2C_FRAME_STATUS_REJECTS] < 0xFF)
+			status[I2C_FRAME_STATUS_REJECTS]++;
+		return;
+	}
+
+	for (i=0; i<dataLen; i++)
+	{
+		if (!i2cRegisterReadOnly(registerIdx + i))
+			i2c_registerMap[registerIdx + i] = i2c_buffer[i];
+	}
+	status[I2C_FRAME_STATUS_SEQ] = i2c_buffer[dataLen];
+	status[I2C_FRAME_STATUS_GOOD]++;
+}
+#endif
  
 volatile I2CState i2c_state = I2C_NO_STATE;  // State byte. Default set to I2C_NO_STATE.
 
@@ -23,12 +202,21 @@ volatile I2CState i2c_state = I2C_NO_STATE;  // State byte. Default set to I2C_N
 // Also used to determine how deep we can sleep.
 volatile bool i2c_busy = false;
 
+// Bumped on every TWI interrupt so the main loop can tell a transfer that's
+// making progress from one that's stuck
+volatile uint8_t i2c_activity = 0;
+
+static uint8_t i2c_slaveAddress = 0;
+static bool i2c_slaveAllCall = false;
+
 void i2cSlaveInitialize(uint8_t i2c_address, bool i2c_all_call)
 {
+	i2c_slaveAddress = i2c_address;
+	i2c_slaveAllCall = i2c_all_call;
 	i2c_state = I2C_NO_STATE;
 	TWBR = I2C_TWBR;
 	TWAR = ((i2c_address<<1) & 0xFE) | (i2c_all_call?1:0);                            // Set own TWI slave address. Accept TWI General Calls.
-	TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT);
+	TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWEA) | _BV(TWINT);
 	i2c_busy = false;
 }
 
@@ -49,35 +237,75 @@ bool i2cBusy(void)
 	return (i2c_busy);
 }
 
-ISR(TWI_vect)
+uint8_t i2cActivity(void)
+{
+	return (i2c_activity);
+}
+
+/****************************************************************************
+Drop whatever the TWI was doing and start over listening for our address.
+Turning TWEN off releases SDA and SCL, so this also frees a bus we were
+holding.  Nothing else on the chip is touched.
+****************************************************************************/
+void i2cSlaveReset(void)
+{
+	TWCR = 0;
+	i2cSlaveInitialize(i2c_slaveAddress, i2c_slaveAllCall);
+}
+
+// The state machine, shared by the interrupt and polled builds.  Inlined into
+//  the ISR so the interrupt doesn't pay for a call.
+static inline void i2cSlaveStep(void) __attribute__((always_inline));
+static inline void i2cSlaveStep(void)
 {
 	static uint8_t i2c_rxIdx=0;
 	static uint8_t i2c_txIdx=0;
 	static uint8_t i2c_registerIdx=0;
 
 	uint8_t i;
+	i2c_activity++;
 	switch (TWSR & 0xF8)
 	{
 		case I2C_STX_ADR_ACK:              // Own SLA+R has been received; ACK has been returned
 			i2c_txIdx   = i2c_registerIdx;   // Set buffer pointer to first data location
+#ifdef I2C_PAGE_SIZE
+			if (i2c_txIdx >= I2C_PAGE_WINDOW)
+				i2cPageStart(i2c_txIdx - I2C_PAGE_WINDOW);
+#endif
 		case I2C_STX_DATA_ACK:             // Data byte in TWDR has been transmitted; ACK has been received
 			if (i2c_txIdx < i2c_registerMapSize)
-				TWDR = i2c_registerMap[i2c_txIdx++];
+				TWDR = i2c_registerMap[i2c_txIdx];
+#ifdef I2C_PAGE_SIZE
+			else if (i2c_txIdx >= I2C_PAGE_WINDOW)
+				TWDR = i2cPageNext();
+#endif
 			else
 				TWDR = 0xFF;
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);
+			if (255 != i2c_txIdx)
+			{
+				i2c_txIdx++;
+#ifdef I2C_PAGE_SIZE
+				// Ran off the end of the registers into the window
+				if (I2C_PAGE_WINDOW == i2c_txIdx)
+					i2cPageStart(0);
+#endif
+			}
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWINT) | _BV(TWEA);
 			i2c_busy = true;
 			break;
 
 		case I2C_STX_DATA_NACK:          // Data byte in TWDR has been transmitted; NACK has been received. 
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWINT) | _BV(TWEA);
 			i2c_busy = false;   // Transmit is finished, we are not busy anymore
 			break;     
 
 		case I2C_SRX_GEN_ACK:            // General call address has been received; ACK has been returned
 		case I2C_SRX_ADR_ACK:            // Own SLA+W has been received ACK has been returned
 			i2c_rxIdx = 0;               // Set buffer pointer to first data location
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);
+#ifdef I2C_FRAME_MAX
+			i2c_framed = false;
+#endif
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWINT) | _BV(TWEA);
 			i2c_busy = true;
 			break;
 
@@ -89,8 +317,24 @@ ISR(TWI_vect)
 				// First byte of a write, this will become our new register index
 				i2c_registerIdx = i;
 				i2c_rxIdx++;
-			} else if (i2c_rxIdx >= i2c_registerMapSize) {
-				// NACK the SOB - out of range
+#ifdef I2C_FRAME_MAX
+				if (i & I2C_FRAME_FLAG)
+				{
+					i2c_registerIdx = i & ~I2C_FRAME_FLAG;
+					i2c_framed = true;
+					i2c_frameLen = 0;
+					i2c_frameCrc = i2cCrc8(0, i);
+				}
+			} else if (i2c_framed) {
+				// Held until the STOP, anything past the end just makes it too long
+				if (i2c_frameLen < I2C_FRAME_BUFFER)
+					i2c_buffer[i2c_frameLen] = i;
+				if (255 != i2c_frameLen)
+					i2c_frameLen++;
+				i2c_frameCrc = i2cCrc8(i2c_frameCrc, i);
+#endif
+			} else if (i2c_registerIdx >= i2c_registerMapSize) {
+				// NACK the SOB - out of range, or the page window
 				if (255 != i2c_rxIdx)
 					i2c_rxIdx++;
 				if (255 != i2c_registerIdx)
@@ -98,7 +342,7 @@ ISR(TWI_vect)
 					
 			} else {
 				// Subsequent byte of a write.  If register marked writable, write it
-				if (!(i2c_registerAttributes[i2c_registerIdx] & I2CREG_ATTR_READONLY))
+				if (!i2cRegisterReadOnly(i2c_registerIdx))
 					i2c_registerMap[i2c_registerIdx]	= i;
 
 				if (255 != i2c_rxIdx)
@@ -108,13 +352,18 @@ ISR(TWI_vect)
 					i2c_registerIdx++;
 			}
 				
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWINT) | _BV(TWEA);
 			i2c_busy = true;
 			break;
 
 		case I2C_SRX_STOP_RESTART:       // A STOP condition or repeated START condition has been received while still addressed as Slave    
                                                         // Enter not addressed mode and listen to address match
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);  // Enable TWI-interface and release TWI pins
+#ifdef I2C_FRAME_MAX
+			if (i2c_framed)
+				i2cFrameCommit(i2c_registerIdx);
+			i2c_framed = false;
+#endif
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWINT) | _BV(TWEA);  // Enable TWI-interface and release TWI pins
 			i2c_busy = false;  // We are waiting for a new address match, so we are not busy
 			break;           
 
@@ -124,16 +373,30 @@ ISR(TWI_vect)
 //    case I2C_NO_STATE              // No relevant state information available; TWINT = \930\94
 		case I2C_BUS_ERROR:         // Bus error due to an illegal START or STOP condition
 			i2c_state = TWSR;                 //Store TWI State as errormessage, operation also clears noErrors bit
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWSTO) | _BV(TWINT) | _BV(TWEA);
+			i2cLogError(i2c_state);
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWSTO) | _BV(TWINT) | _BV(TWEA);
 			i2c_busy = false;
 			break;
 
 		default:     
 			i2c_state = TWSR;                                 // Store TWI State as errormessage, operation also clears the Success bit.      
-			TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);
+			i2cLogError(i2c_state);
+			TWCR = _BV(TWEN) | I2C_TWCR_IE | _BV(TWINT) | _BV(TWEA);
 			i2c_busy = false; // Unknown status, so we wait for a new address match that might be something we can handle
 			break;
 	}
 }
 
+#ifdef I2C_SLAVE_POLLED
+void i2cSlaveService(void)
+{
+	if (TWCR & _BV(TWINT))
+		i2cSlaveStep();
+}
+#else
+ISR(TWI_vect)
+{
+	i2cSlaveStep();
+}
+#endif
 
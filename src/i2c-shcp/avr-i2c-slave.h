@@ -21,6 +21,77 @@ LICENSE:
 #include <avr/interrupt.h>
 
 #define I2CREG_ATTR_READONLY  0x01
+
+// Framed writes, built in when I2C_FRAME_MAX is defined (the most data bytes
+//  one frame can carry).  A write whose register byte has I2C_FRAME_FLAG set
+//  is framed:
+//
+//    register | I2C_FRAME_FLAG, data..., sequence, CRC-8
+//
+//  The CRC is SMBus PEC style (polynomial 0x07, starting at 0) over every
+//  byte before it, register byte included.  Nothing is written until the
+//  STOP, and then only if the CRC checks and every byte fits, so a frame
+//  lands whole or not at all.  Three read-only status registers, starting at
+//  i2c_frameStatusReg in the application's map, tell the master how it went.
+//  Plain writes work the same as always.
+#define I2C_FRAME_FLAG            0x80
+#define I2C_FRAME_STATUS_SEQ      0   // Sequence number of the last good frame
+#define I2C_FRAME_STATUS_GOOD     1   // Good frames, counts up and wraps
+#define I2C_FRAME_STATUS_REJECTS  2   // Bad CRC, too long or out of range, sticks at 255
+#define I2C_FRAME_STATUS_SIZE     3
+
+// Paged registers, built in when I2C_PAGE_SIZE is defined (the most of any
+//  page the window shows).  Register indexes from I2C_PAGE_WINDOW up are a
+//  read-only window onto whichever page the application's page select
+//  register (i2c_pageSelectReg) picks.  Pages don't take any RAM of their
+//  own: each is described in flash by i2c_pages[], and the ISR reads each
+//  byte straight from the page's source as it goes out, with nothing
+//  copied.  That also means a long read of something that's changing isn't
+//  all from the same moment.  A read that runs up from the registers below
+//  picks the page up as it gets to the window.  Past the end of a page, or
+//  for a page that doesn't exist, reads give 0xFF.  An EEPROM page also
+//  reads 0xFF while the EEPROM is busy writing.  Writes to the window go
+//  nowhere.
+//
+//  A page is len bytes, taken width at a time from elements stride bytes
+//  apart, starting at addr in RAM, flash or EEPROM.  Pick one field out of
+//  an array of structs with the struct size as the stride, or take a plain
+//  array with a stride of width.
+//
+//  Built with I2C_PAGE_SIZE, register attributes come from the application's
+//  i2c_registerRanges[] in flash (sorted, anything not listed has no
+//  attributes) instead of a byte per register in RAM.
+#define I2C_PAGE_WINDOW           0x40
+
+#define I2C_PAGE_RAM              0
+#define I2C_PAGE_FLASH            1
+#define I2C_PAGE_EEPROM           2
+
+typedef struct
+{
+	uint8_t source;    // I2C_PAGE_RAM, I2C_PAGE_FLASH or I2C_PAGE_EEPROM
+	uint8_t width;
+	uint8_t stride;
+	uint8_t len;
+	const void* addr;
+} I2CPage;
+
+typedef struct
+{
+	uint8_t first;
+	uint8_t last;
+	uint8_t attributes;
+} I2CRegisterRange;
+
+// Build with I2C_SLAVE_POLLED defined to leave the TWI interrupt off and run
+//  the state machine from i2cSlaveService() instead, for code like the
+//  bootloader that can't use the interrupt vectors
+#ifdef I2C_SLAVE_POLLED
+#define I2C_TWCR_IE  0
+#else
+#define I2C_TWCR_IE  _BV(TWIE)
+#endif
+
 #define I2C_FREQ 400000
 #define I2C_TWBR ( ((F_CPU) / (2UL * (I2C_FREQ))) - 8UL)
 
@@ -74,6 +145,11 @@ typedef enum
 I2CState i2cGetState(void);
 void i2cSlaveInitialize(uint8_t i2c_address, bool i2c_all_call);
 bool i2cBusy(void);
+uint8_t i2cActivity(void);
+void i2cSlaveReset(void);
+#ifdef I2C_SLAVE_POLLED
+void i2cSlaveService(void);
+#endif
 
 #endif
 
@@ -0,0 +1,193 @@
+/*************************************************************************
+Title:    I2C-SHCP Bootloader Commands
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     bootloader.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include "bootloader.h"
+
+// Nothing in here touches the hardware, so the uploader's simulated boards
+//  (src/shcp-boot) run exactly this against an array standing in for flash
+
+static uint16_t regWord(volatile uint8_t* regs, uint8_t reg)
+{
+	return regs[reg] | ((uint16_t)regs[reg+1] << 8);
+}
+
+// Flash as the application sees it - word 0 is its reset vector, not ours
+static uint16_t appReadWord(uint16_t addr)
+{
+	return bootFlashReadWord((0 == addr)?BOOT_APP_VECTOR:addr);
+}
+
+bool bootAppValid(void)
+{
+	return (0xC000 == (bootFlashReadWord(BOOT_APP_VECTOR) & 0xF000));
+}
+
+// Word address the application's rjmp at 0x0000 would have gone to
+uint16_t bootAppEntry(void)
+{
+	return (bootFlashReadWord(BOOT_APP_VECTOR) + 1) & 0x0FFF;
+}
+
+// Skips pages that already match, so sending the same image again (or a
+//  broadcast retry) doesn't wear the flash
+static void programPage(uint16_t addr, volatile uint8_t* data)
+{
+	for (uint8_t i=0; i<BOOT_PAGE_SIZE; i+=2)
+	{
+		if (bootFlashReadWord(addr + i) != (data[i] | ((uint16_t)data[i+1] << 8)))
+		{
+			bootFlashWritePage(addr, data);
+			return;
+		}
+	}
+}
+
+// The vector shares a page with the end of the application, so read the
+//  page back into the data registers and rewrite it with the new vector
+static void setAppVector(volatile uint8_t* regs, uint16_t vector)
+{
+	volatile uint8_t* data = regs + BOOTREG_DATA;
+
+	for (uint8_t i=0; i<BOOT_PAGE_SIZE; i+=2)
+	{
+		uint16_t w = bootFlashReadWord(BOOT_LAST_APP_PAGE + i);
+		data[i] = w & 0xFF;
+		data[i+1] = w >> 8;
+	}
+	data[BOOT_PAGE_SIZE-2] = vector & 0xFF;
+	data[BOOT_PAGE_SIZE-1] = vector >> 8;
+	programPage(BOOT_LAST_APP_PAGE, data);
+}
+
+void bootInitialize(volatile uint8_t* regs, volatile uint8_t* attrs)
+{
+	for (uint8_t i=0; i<BOOT_REGISTER_MAP_SIZE; i++)
+		regs[i] = attrs[i] = 0;
+
+	attrs[BOOTREG_SIGNATURE] = I2CREG_ATTR_READONLY;
+	for (uint8_t i=BOOTREG_STATUS; i<BOOT_REGISTER_MAP_SIZE; i++)
+		attrs[i] = I2CREG_ATTR_READONLY;
+
+	regs[BOOTREG_SIGNATURE] = BOOT_SIGNATURE;
+	regs[BOOTREG_VERSION] = BOOT_VERSION;
+}
+
+// Runs whatever command was just written.  Returns true if it's time to
+//  start the application.
+bool bootCommand(volatile uint8_t* regs)
+{
+	volatile uint8_t* data = regs + BOOTREG_DATA;
+	uint8_t command = regs[BOOTREG_COMMAND];
+	uint16_t addr = regWord(regs, BOOTREG_ADDR_L);
+	uint16_t len = regWord(regs, BOOTREG_LEN_L);
+	uint16_t crc = 0xFFFF;
+	uint8_t status = BOOT_STATUS_OK;
+	bool run = false;
+	uint8_t i;
+
+	for (i=BOOTREG_COMMAND; i<BOOTREG_CRC_L; i++)
+		crc = bootCrc16(crc, regs[i]);
+	if (BOOT_CMD_WRITE_PAGE == command)
+	{
+		for (i=0; i<BOOT_PAGE_SIZE; i++)
+			crc = bootCrc16(crc, data[i]);
+	}
+
+	regs[BOOTREG_COMMAND] = BOOT_CMD_NONE;
+
+	if (crc != regWord(regs, BOOTREG_CRC_L))
+	{
+		status = BOOT_STATUS_CRC_ERROR;
+		if (regs[BOOTREG_CRC_ERRORS] < 0xFF)
+			regs[BOOTREG_CRC_ERRORS]++;
+	}
+	else switch(command)
+	{
+		case BOOT_CMD_BEGIN:
+			regs[BOOTREG_PAGES] = regs[BOOTREG_CRC_ERRORS] = 0;
+			setAppVector(regs, 0xFFFF);
+			break;
+
+		case BOOT_CMD_WRITE_PAGE:
+			if ((addr & (BOOT_PAGE_SIZE-1)) || addr > BOOT_LAST_APP_PAGE)
+			{
+				status = BOOT_STATUS_BAD_ADDRESS;
+				break;
+			}
+
+			if (0 == addr)
+			{
+				// Keep reset pointed here, and move the application's vector
+				//  under the bootloader
+				uint16_t vector = regWord(regs, BOOTREG_DATA);
+				data[0] = BOOT_RESET_RJMP & 0xFF;
+				data[1] = BOOT_RESET_RJMP >> 8;
+				programPage(0, data);
+				setAppVector(regs, vector);
+			}
+			else
+			{
+				if (BOOT_LAST_APP_PAGE == addr)
+				{
+					uint16_t vector = bootFlashReadWord(BOOT_APP_VECTOR);
+					data[BOOT_PAGE_SIZE-2] = vector & 0xFF;
+					data[BOOT_PAGE_SIZE-1] = vector >> 8;
+				}
+				programPage(addr, data);
+			}
+
+			if (regs[BOOTREG_PAGES] < 0xFF)
+				regs[BOOTREG_PAGES]++;
+			break;
+
+		case BOOT_CMD_CRC:
+			if ((uint32_t)addr + len > BOOT_APP_VECTOR)
+			{
+				status = BOOT_STATUS_BAD_ADDRESS;
+				break;
+			}
+
+			crc = 0xFFFF;
+			for (; len; addr++, len--)
+			{
+				uint16_t w = appReadWord(addr & ~1);
+				crc = bootCrc16(crc, (addr & 0x01)?(w >> 8):(w & 0xFF));
+			}
+			regs[BOOTREG_RESULT_L] = crc & 0xFF;
+			regs[BOOTREG_RESULT_H] = crc >> 8;
+			break;
+
+		case BOOT_CMD_RUN:
+			if (bootAppValid())
+				run = true;
+			else
+				status = BOOT_STATUS_NO_APP;
+			break;
+
+		default:
+			status = BOOT_STATUS_BAD_COMMAND;
+			break;
+	}
+
+	regs[BOOTREG_STATUS] = status;
+	return run;
+}
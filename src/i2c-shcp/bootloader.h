@@ -0,0 +1,129 @@
+/*************************************************************************
+Title:    I2C-SHCP Bootloader Protocol
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     bootloader.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _BOOTLOADER_H_
+#define _BOOTLOADER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The bootloader lives in the top of flash and answers at the same I2C
+   address as the application, plus the general call address so one write
+   through the mux (every channel enabled) reaches every SHCP at once.
+
+   The ATtiny88 has no boot section or vector select, so the bootloader
+   keeps the reset vector at 0x0000 pointed at itself.  Whatever the
+   application had there gets moved to the word just under the bootloader
+   (BOOT_APP_VECTOR) when page 0 is written, and that's where the
+   bootloader jumps to run the application.  Erased (0xFFFF) means there's
+   no application and the bootloader stays put.
+
+   Every command is one write starting at BOOTREG_COMMAND, checked with a
+   CRC over the command, address and length (plus the data for a page
+   write).  An update goes:
+
+     BEGIN       - drop the application vector, so a reset part way
+                   through stays in the bootloader
+     WRITE_PAGE  - once per page, highest address first so page 0 (and the
+                   vector with it) goes in last
+     CRC         - per board, CRC of the application as written to compare
+                   against the image
+     RUN         - start the application
+
+   Nothing comes back from a broadcast, so status and results are only read
+   with one board selected. */
+
+#ifndef BOOT_START
+#define BOOT_START          0x1C00
+#endif
+#define BOOT_PAGE_SIZE          64
+#define BOOT_APP_VECTOR     (BOOT_START - 2)
+#define BOOT_LAST_APP_PAGE  (BOOT_START - BOOT_PAGE_SIZE)
+
+// rjmp from 0x0000 to the bootloader
+#define BOOT_RESET_RJMP     (0xC000 | (((BOOT_START/2) - 1) & 0x0FFF))
+
+#define BOOT_SIGNATURE      0xB1
+#define BOOT_VERSION        1
+
+// The application enters the bootloader by jumping to BOOT_START with this
+//  in GPIOR0.  A real reset clears it.
+#define BOOT_ENTER_MAGIC    0xB0
+
+// Broadcasts go to the general call address, where a first byte of 0x00,
+//  0x04 or 0x06 means something to other parts, so the command register
+//  isn't register 0
+#define BOOTREG_SIGNATURE    0
+#define BOOTREG_COMMAND      1
+#define BOOTREG_ADDR_L       2
+#define BOOTREG_ADDR_H       3
+#define BOOTREG_LEN_L        4
+#define BOOTREG_LEN_H        5
+#define BOOTREG_CRC_L        6
+#define BOOTREG_CRC_H        7
+#define BOOTREG_DATA         8
+#define BOOTREG_STATUS      (BOOTREG_DATA + BOOT_PAGE_SIZE)
+#define BOOTREG_PAGES       (BOOTREG_STATUS + 1)
+#define BOOTREG_CRC_ERRORS  (BOOTREG_STATUS + 2)
+#define BOOTREG_RESULT_L    (BOOTREG_STATUS + 3)
+#define BOOTREG_RESULT_H    (BOOTREG_STATUS + 4)
+#define BOOTREG_VERSION     (BOOTREG_STATUS + 5)
+#define BOOT_REGISTER_MAP_SIZE  (BOOTREG_STATUS + 6)
+
+// Same as avr-i2c-slave.h, which the uploader can't include
+#ifndef I2CREG_ATTR_READONLY
+#define I2CREG_ATTR_READONLY  0x01
+#endif
+
+#define BOOT_CMD_NONE        0
+#define BOOT_CMD_BEGIN       1
+#define BOOT_CMD_WRITE_PAGE  2   // ADDR = page address, DATA = page
+#define BOOT_CMD_CRC         3   // ADDR, LEN = application bytes, CRC into RESULT
+#define BOOT_CMD_RUN         4
+
+#define BOOT_STATUS_IDLE         0
+#define BOOT_STATUS_OK           1
+#define BOOT_STATUS_CRC_ERROR    2
+#define BOOT_STATUS_BAD_ADDRESS  3
+#define BOOT_STATUS_BAD_COMMAND  4
+#define BOOT_STATUS_NO_APP       5
+
+// Same as avr-libc's _crc_ccitt_update(), written out so the uploader can
+//  share it.  Start from 0xFFFF.
+static inline uint16_t bootCrc16(uint16_t crc, uint8_t data)
+{
+	data ^= crc & 0xFF;
+	data ^= data << 4;
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+// Supplied by whatever's underneath - SPM on the AVR, an array in the
+//  uploader's simulated boards.  Addresses are bytes, pages page aligned.
+uint16_t bootFlashReadWord(uint16_t addr);
+void bootFlashWritePage(uint16_t addr, const volatile uint8_t* data);
+
+void bootInitialize(volatile uint8_t* regs, volatile uint8_t* attrs);
+bool bootCommand(volatile uint8_t* regs);
+bool bootAppValid(void);
+uint16_t bootAppEntry(void);
+
+#endif
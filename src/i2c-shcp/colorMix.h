@@ -0,0 +1,97 @@
+/*************************************************************************
+Title:    I2C-SHCP Aspect Color Mixes
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     colorMix.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _COLOR_MIX_H_
+#define _COLOR_MIX_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include "signalAspect.h"
+
+/* How bright each of a head's three outputs (red, yellow, green) is for
+   each aspect, 0-32 with 32 being full on.  Fades scale these by the fade
+   tables, so a mix fades in and out the same way a single lamp does, and
+   none of this touches the ISR.
+
+   Mix set 0 is the usual one lamp per color.  Set 1 is for RGB heads with
+   the red, yellow and green outputs wired to the red, green and blue LEDs.
+   Set 2 comes from EEPROM (make eeprom) for anything else.
+
+   Lunar only lights with set 1 or 2.  A three lamp head has nothing that
+   looks lunar, and red, yellow and green all on at once is a wrong-side
+   proceed waiting to be read, so set 0 leaves it dark. */
+
+#define COLOR_MIX_LAMP_PER_COLOR   0
+#define COLOR_MIX_RGB              1
+#define COLOR_MIX_EEPROM           2
+#define COLOR_MIX_SETS             3
+
+#define COLOR_MIX_FULL            32
+
+typedef struct
+{
+	uint8_t red;
+	uint8_t yellow;
+	uint8_t green;
+} ColorMix_t;
+
+const ColorMix_t colorMixes[COLOR_MIX_SETS-1][ASPECT_END] PROGMEM =
+{
+	// One lamp per color.  There's no lunar lamp, so lunar is dark.
+	{
+		{  0,  0,  0 },   // OFF
+		{  0,  0, 32 },   // GREEN
+		{  0,  0, 32 },   // FL_GREEN
+		{  0, 32,  0 },   // YELLOW
+		{  0, 32,  0 },   // FL_YELLOW
+		{ 32,  0,  0 },   // RED
+		{ 32,  0,  0 },   // FL_RED
+		{  0,  0,  0 }    // LUNAR
+	},
+	// RGB head, outputs are red / green / blue
+	{
+		{  0,  0,  0 },   // OFF
+		{  0, 32, 10 },   // GREEN
+		{  0, 32, 10 },   // FL_GREEN
+		{ 32, 14,  0 },   // YELLOW
+		{ 32, 14,  0 },   // FL_YELLOW
+		{ 32,  0,  0 },   // RED
+		{ 32,  0,  0 },   // FL_RED
+		{ 18, 22, 32 }    // LUNAR
+	}
+};
+
+// Starts out the same as RGB, program with "make eeprom" after changing
+ColorMix_t colorMixEEPROM[ASPECT_END] EEMEM =
+{
+	{  0,  0,  0 },
+	{  0, 32, 10 },
+	{  0, 32, 10 },
+	{ 32, 14,  0 },
+	{ 32, 14,  0 },
+	{ 32,  0,  0 },
+	{ 32,  0,  0 },
+	{ 18, 22, 32 }
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*************************************************************************
+Title:    I2C-SHCP Per-Head Flash Timing
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     flasher.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "flasher.h"
+
+// Period, on, phase - in 8ms frames
+static const FlashProfile_t flashProfileDefaults[FLASH_PROFILES] PROGMEM =
+{
+	{ 190, 95, 0 },   // Standard
+	{ 166, 83, 0 },   // Crossing
+	{  94, 47, 0 },   // Fast
+	{ 190, 95, 0 },   // Custom until the master sets it
+};
+
+FlashProfile_t flashProfile[FLASH_PROFILES];
+static uint8_t flashCount[FLASH_PROFILES];
+
+void flasherInitialize(void)
+{
+	for (uint8_t i=0; i<FLASH_PROFILES; i++)
+	{
+		memcpy_P(&flashProfile[i], &flashProfileDefaults[i], sizeof(FlashProfile_t));
+		flashCount[i] = 0;
+	}
+}
+
+void flasherSetProfile(uint8_t profile, uint8_t period, uint8_t on, uint8_t phase)
+{
+	FlashProfile_t* p = &flashProfile[profile & FLASH_PROFILE_MASK];
+
+	if (0 == period)
+		memcpy_P(p, &flashProfileDefaults[profile & FLASH_PROFILE_MASK], sizeof(FlashProfile_t));
+	else
+	{
+		p->period = period;
+		p->on = (on > period)?period:on;
+		p->phase = phase % period;
+	}
+
+	memset(flashCount, 0, sizeof(flashCount));
+}
+
+// frames is however many frames went by since last time, normally 1
+void flasherAdvance(uint8_t frames)
+{
+	for (uint8_t i=0; i<FLASH_PROFILES; i++)
+	{
+		uint16_t count = flashCount[i] + frames;
+		while (count >= flashProfile[i].period)
+			count -= flashProfile[i].period;
+		flashCount[i] = count;
+	}
+}
+
+bool flasherState(uint8_t config)
+{
+	const FlashProfile_t* p = &flashProfile[config & FLASH_PROFILE_MASK];
+	uint16_t count = flashCount[config & FLASH_PROFILE_MASK] + p->phase;
+
+	if (config & FLASH_ALTERNATE)
+		count += p->period / 2;
+
+	while (count >= p->period)
+		count -= p->period;
+
+	return (count < p->on);
+}
@@ -0,0 +1,71 @@
+/*************************************************************************
+Title:    I2C-SHCP Per-Head Flash Timing
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     flasher.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _FLASHER_H_
+#define _FLASHER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Each head picks a flash profile (period, on time and phase, all in 8ms
+   frames) and can ask for the alternate phase, which is half a period off.
+   Two heads on the same profile, one alternate, make a wig-wag or crossing
+   flasher pair.  Every profile has one counter, stepped once per frame from
+   the main loop, so heads on the same profile always stay in step.
+
+   All four profiles can be set over I2C, so heads that need their own
+   timing or their own phase each get a profile.  Setting one restarts
+   every counter, which keeps profiles with the same period lined up by
+   just their phases.  The first three start out as below, the last as a
+   copy of standard.
+
+   Flash config, as it sits in options register bits 5:3:
+     5   - alternate phase
+     4:3 - profile
+*/
+
+#define FLASH_PROFILE_STANDARD   0   // ~40 flashes/min, what everything used to do
+#define FLASH_PROFILE_CROSSING   1   // ~45 flashes/min, 50% duty
+#define FLASH_PROFILE_FAST       2   // ~80 flashes/min
+#define FLASH_PROFILE_CUSTOM     3   // Standard until set over I2C
+#define FLASH_PROFILES           4
+
+#define FLASH_PROFILE_MASK       0x03
+#define FLASH_ALTERNATE          0x04
+
+typedef struct
+{
+	uint8_t period;
+	uint8_t on;
+	uint8_t phase;
+} FlashProfile_t;
+
+// In RAM, read straight out of it by the I2C register pages
+extern FlashProfile_t flashProfile[FLASH_PROFILES];
+
+void flasherInitialize(void);
+// Zero period puts the profile back to how it started out
+void flasherSetProfile(uint8_t profile, uint8_t period, uint8_t on, uint8_t phase);
+void flasherAdvance(uint8_t frames);
+bool flasherState(uint8_t config);
+
+#endif
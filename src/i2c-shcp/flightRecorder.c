@@ -0,0 +1,95 @@
+/*************************************************************************
+Title:    I2C-SHCP Flight Recorder
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     flightRecorder.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <util/atomic.h>
+#include "flightRecorder.h"
+
+#if FLIGHT_RECORDER_ENTRIES
+
+// flightWrite and flightRead are free running, the ring index is the low bits
+FlightEntry_t flightRing[FLIGHT_RECORDER_ENTRIES];
+volatile uint8_t flightWrite = 0;
+volatile uint8_t flightRead = 0;
+volatile uint8_t flightDropped = 0;
+
+// Which entry is up in the window, if any
+static uint8_t flightWindowIdx = 0;
+static bool flightWindowValid = false;
+
+// Heads get logged by number, which is where they sit in this array
+static const SignalState_t* flightHeads;
+
+void flightRecorderInitialize(const SignalState_t* heads)
+{
+	flightHeads = heads;
+	flightWrite = flightRead = flightDropped = 0;
+	flightWindowValid = false;
+}
+
+void flightLog(uint8_t head, uint8_t event, uint8_t value)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		flightLogFromISR(head, event, value);
+	}
+}
+
+void flightLogHead(const SignalState_t* sig, uint8_t event, uint8_t value)
+{
+	flightLog(sig - flightHeads, event, value);
+}
+
+// Called every time around the main loop
+void flightRecorderService(volatile uint8_t* window)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint8_t count;
+
+		if (window[FLIGHT_WINDOW_NEXT])
+		{
+			// Done with the one in the window.  If it got overwritten while the
+			//  master was reading it, the ring's already moved past it.
+			if (flightWindowValid && flightRead == flightWindowIdx)
+				flightRead++;
+			flightWindowValid = false;
+		}
+
+		count = flightWrite - flightRead;
+		if (!flightWindowValid && count)
+		{
+			FlightEntry_t* entry = &flightRing[flightRead & (FLIGHT_RECORDER_ENTRIES - 1)];
+			window[FLIGHT_WINDOW_FRAME] = entry->frame;
+			window[FLIGHT_WINDOW_EVENT] = entry->event;
+			window[FLIGHT_WINDOW_VALUE] = entry->value;
+			flightWindowIdx = flightRead;
+			flightWindowValid = true;
+		}
+
+		// Entry first, so a master that sees a count has a good entry to go with it
+		window[FLIGHT_WINDOW_COUNT] = count;
+		window[FLIGHT_WINDOW_DROPPED] = flightDropped;
+		window[FLIGHT_WINDOW_NEXT] = 0;
+	}
+}
+
+#endif
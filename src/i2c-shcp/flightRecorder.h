@@ -0,0 +1,132 @@
+/*************************************************************************
+Title:    I2C-SHCP Flight Recorder
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     flightRecorder.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _FLIGHT_RECORDER_H_
+#define _FLIGHT_RECORDER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "signalHead.h"
+
+/* A ring of the last few things that happened - aspect changes, transitions
+   finishing, bus errors - each stamped with the frame counter, so when a
+   head does something odd the master can go back and see what led up to it.
+   When it fills up the oldest entries go and DROPPED counts them.
+
+   The master drains it through a window of registers that always shows the
+   oldest entry:
+
+     COUNT    - entries left, including the one in the window.  The window
+                only means something when this isn't zero.
+     DROPPED  - entries overwritten before they were read, sticks at 255
+     FRAME    - frame counter when it happened (wraps every ~2s)
+     EVENT    - event in bits 7:3, head in bits 2:0
+     VALUE    - depends on the event, see below
+     NEXT     - write non-zero once the window's been read to move on to the
+                next entry.  Reads back non-zero until the next one's up.
+
+   The size is set from the Makefile and has to be a power of two.  Each
+   entry is 3 bytes of RAM.  Zero compiles it all out for parts that can't
+   spare the RAM: logging does nothing, the window registers stay where
+   they are and COUNT is always zero. */
+
+#ifndef FLIGHT_RECORDER_ENTRIES
+#define FLIGHT_RECORDER_ENTRIES  16
+#endif
+
+#if (FLIGHT_RECORDER_ENTRIES != 0) && ((FLIGHT_RECORDER_ENTRIES < 2) || (FLIGHT_RECORDER_ENTRIES > 128) || (FLIGHT_RECORDER_ENTRIES & (FLIGHT_RECORDER_ENTRIES - 1)))
+#error "FLIGHT_RECORDER_ENTRIES has to be 0 or a power of two from 2 to 128"
+#endif
+
+#define FLIGHT_WINDOW_COUNT      0
+#define FLIGHT_WINDOW_DROPPED    1
+#define FLIGHT_WINDOW_FRAME      2
+#define FLIGHT_WINDOW_EVENT      3
+#define FLIGHT_WINDOW_VALUE      4
+#define FLIGHT_WINDOW_NEXT       5
+#define FLIGHT_WINDOW_SIZE       6
+
+#define FLIGHT_EVENT(e)          ((e)>>3)
+#define FLIGHT_HEAD(e)           ((e) & 0x07)
+
+// Events, and what goes in VALUE
+#define FLIGHT_NONE              0
+#define FLIGHT_RESET             1   // MCUSR, so a watchdog reset shows up
+#define FLIGHT_ASPECT            2   // New aspect for the head
+#define FLIGHT_RETARGET          3   // Aspect the head turned towards part way through a transition
+#define FLIGHT_DONE              4   // Aspect the head finished changing to
+#define FLIGHT_CA_SENSE          5   // 1 for common anode
+#define FLIGHT_I2C_ERROR         6   // TWI status
+#define FLIGHT_I2C_RECOVERY      7   // Recoveries so far
+
+typedef struct
+{
+	uint8_t frame;
+	uint8_t event;
+	uint8_t value;
+} FlightEntry_t;
+
+extern volatile uint8_t frameCounter;
+
+#if FLIGHT_RECORDER_ENTRIES
+
+extern FlightEntry_t flightRing[FLIGHT_RECORDER_ENTRIES];
+extern volatile uint8_t flightWrite;
+extern volatile uint8_t flightRead;
+extern volatile uint8_t flightDropped;
+
+// For the TWI interrupt, so it doesn't have to make a call.  Everywhere else
+//  use flightLog().
+static inline void flightLogFromISR(uint8_t head, uint8_t event, uint8_t value)
+{
+	FlightEntry_t* entry = &flightRing[flightWrite & (FLIGHT_RECORDER_ENTRIES - 1)];
+
+	// Full, so the oldest goes
+	if ((uint8_t)(flightWrite - flightRead) >= FLIGHT_RECORDER_ENTRIES)
+	{
+		flightRead++;
+		if (flightDropped < 0xFF)
+			flightDropped++;
+	}
+
+	entry->frame = frameCounter;
+	entry->event = (event<<3) | (head & 0x07);
+	entry->value = value;
+	flightWrite++;
+}
+
+void flightRecorderInitialize(const SignalState_t* heads);
+void flightLog(uint8_t head, uint8_t event, uint8_t value);
+void flightLogHead(const SignalState_t* sig, uint8_t event, uint8_t value);
+void flightRecorderService(volatile uint8_t* window);
+
+#else
+
+static inline void flightLogFromISR(uint8_t head, uint8_t event, uint8_t value) { }
+static inline void flightRecorderInitialize(const SignalState_t* heads) { }
+static inline void flightLog(uint8_t head, uint8_t event, uint8_t value) { }
+static inline void flightLogHead(const SignalState_t* sig, uint8_t event, uint8_t value) { }
+static inline void flightRecorderService(volatile uint8_t* window) { }
+
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+/*************************************************************************
+Title:    I2C-SHCP Bootloader
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     i2c-shcp-boot.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/boot.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "avr-i2c-slave.h"
+#include "bootloader.h"
+
+// Built with I2C_SLAVE_POLLED - the interrupt vectors at 0x0000 belong to the
+//  application, so nothing in here runs from an interrupt.  While we're busy
+//  the TWI holds SCL low, which keeps the master (and a broadcast) waiting on
+//  the slowest board.
+
+// Go back to the application after this many Timer1 overflows (~8.4s each)
+//  without any bus traffic
+#define BOOT_IDLE_OVERFLOWS  4
+
+volatile uint8_t i2c_registerMap[BOOT_REGISTER_MAP_SIZE];
+volatile uint8_t i2c_registerAttributes[BOOT_REGISTER_MAP_SIZE];
+const uint8_t i2c_registerMapSize = BOOT_REGISTER_MAP_SIZE;
+
+uint16_t bootFlashReadWord(uint16_t addr)
+{
+	return pgm_read_word(addr);
+}
+
+void bootFlashWritePage(uint16_t addr, const volatile uint8_t* data)
+{
+	boot_page_erase(addr);
+	boot_spm_busy_wait();
+	for (uint8_t i=0; i<BOOT_PAGE_SIZE; i+=2)
+		boot_page_fill(addr + i, data[i] | ((uint16_t)data[i+1] << 8));
+	boot_page_write(addr);
+	boot_spm_busy_wait();
+}
+
+static void runApplication(void)
+{
+	void (*app)(void) = (void (*)(void))bootAppEntry();
+
+	TWCR = 0;
+	TCCR1B = 0;
+	TIFR1 = 0xFF;
+	app();
+}
+
+int main(void)
+{
+	bool entered = (BOOT_ENTER_MAGIC == GPIOR0);
+	uint8_t lastActivity = 0;
+	uint8_t idleOverflows = 0;
+
+	GPIOR0 = 0;
+
+	// Straight through to the application on a normal reset
+	if (!entered && bootAppValid())
+		runApplication();
+
+	wdt_reset();
+	wdt_enable(WDTO_1S);
+
+	bootInitialize(i2c_registerMap, i2c_registerAttributes);
+
+	// The application may have left the TWI mid-transfer when it jumped here
+	TWCR = 0;
+	i2cSlaveInitialize(0x40, true);
+
+	TCCR1A = 0;
+	TCCR1B = _BV(CS12) | _BV(CS10);   // 8MHz / 1024, overflows every ~8.4s
+	TIFR1 = _BV(TOV1);
+
+	while(1)
+	{
+		wdt_reset();
+		i2cSlaveService();
+
+		if (i2cActivity() != lastActivity)
+		{
+			lastActivity = i2cActivity();
+			idleOverflows = 0;
+			TCNT1 = 0;
+		}
+		else if (TIFR1 & _BV(TOV1))
+		{
+			TIFR1 = _BV(TOV1);
+			if (++idleOverflows >= BOOT_IDLE_OVERFLOWS && bootAppValid())
+				runApplication();
+		}
+
+		// Commands run once the write that carried them is over
+		if (BOOT_CMD_NONE != i2c_registerMap[BOOTREG_COMMAND] && !i2cBusy())
+		{
+			if (bootCommand(i2c_registerMap))
+				runApplication();
+		}
+	}
+}
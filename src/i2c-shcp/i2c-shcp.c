@@ -33,6 +33,13 @@ LICENSE:
 #include "avr-i2c-slave.h"
 #include "debouncer.h"
 #include "signalHead.h"
+#include "indicationRules.h"
+#include "oscCal.h"
+#include "stackCheck.h"
+#include "flasher.h"
+#include "bootloader.h"
+#include "flightRecorder.h"
+#include "pinmap.h"
 
 #define LOOP_UPDATE_TIME_MS       50
 #define STARTUP_LOCKOUT_TIME_MS  500
@@ -41,32 +48,32 @@ LICENSE:
 #define MAX(a,b) ((a)>(b)?(a):(b))
 
 volatile uint32_t millis = 0;
+volatile uint8_t subMillis = 0;
 
 #define MAX_SIGNAL_HEADS 8
+#if PINMAP_HEADS != MAX_SIGNAL_HEADS
+#error "Pin map doesn't have the same number of heads as the register map"
+#endif
 SignalState_t signal[MAX_SIGNAL_HEADS];
 volatile uint8_t signalHeadOptions[MAX_SIGNAL_HEADS];
 
-#define I2C_REGISTER_MAP_SIZE  24
+#define I2C_REGISTER_MAP_SIZE  54
 volatile uint8_t i2c_registerMap[I2C_REGISTER_MAP_SIZE];
-volatile uint8_t i2c_registerAttributes[I2C_REGISTER_MAP_SIZE];
 const uint8_t i2c_registerMapSize= I2C_REGISTER_MAP_SIZE;
 
+#ifndef I2C_PAGE_SIZE
+#error "Build with I2C_PAGE_SIZE, the register attributes and pages need it"
+#endif
+#if I2C_REGISTER_MAP_SIZE > I2C_PAGE_WINDOW
+#error "Register map runs into the page window"
+#endif
 
-// A few hardware definitions
-// Signal Port Connections
-// These are in the order of:
-//  Red address, bitmask
-//  Yellow address, bitmask
-//  Green address, bitmask
 
-#define SIGNAL_HEAD_0_DEF   &PORTD, _BV(PD0), &PORTD, _BV(PD1), &PORTD, _BV(PD2)
-#define SIGNAL_HEAD_1_DEF   &PORTD, _BV(PD3), &PORTD, _BV(PD4), &PORTA, _BV(PA2)
-#define SIGNAL_HEAD_2_DEF   &PORTA, _BV(PA3), &PORTB, _BV(PB6), &PORTB, _BV(PB7)
-#define SIGNAL_HEAD_3_DEF   &PORTD, _BV(PD5), &PORTD, _BV(PD6), &PORTD, _BV(PD7)
-#define SIGNAL_HEAD_4_DEF   &PORTB, _BV(PB0), &PORTB, _BV(PB1), &PORTB, _BV(PB2)
-#define SIGNAL_HEAD_5_DEF   &PORTB, _BV(PB3), &PORTB, _BV(PB4), &PORTB, _BV(PB5)
-#define SIGNAL_HEAD_6_DEF   &PORTC, _BV(PC7), &PORTA, _BV(PA1), &PORTC, _BV(PC0)
-#define SIGNAL_HEAD_7_DEF   &PORTC, _BV(PC1), &PORTC, _BV(PC2), &PORTC, _BV(PC3)
+// Signal head pins and port setup come from the board's pin map
+//  (pinmaps/*.pinmap, generated into pinmap.h by the Makefile).  Bit n of
+//  pinmapInvert[] entry 0-3 is set when that pin on PORTA-D drives a common
+//  cathode head.
+volatile uint8_t pinmapInvert[4];
 
 #define SENSE_COMMON_ANODE 0x01
 
@@ -74,12 +81,160 @@ const uint8_t i2c_registerMapSize= I2C_REGISTER_MAP_SIZE;
 #define OPTION_COMMON_ANODE    0x40
 #define OPTION_CA_CC_SENSE     0x00
 
+// Options bits 5:3 pick the head's flash timing
+#define OPTION_FLASH(r)        (((r)>>3) & 0x07)
+
+// Options bits 2:0 - bit 0 searchlight, bits 2:1 color mix set (colorMix.h)
 #define OPTION_SIGNAL_THREE_LIGHT 0x00
 #define OPTION_SIGNAL_SEARCHLIGHT 0x01
+#define OPTION_MIX(r)             (((r)>>1) & 0x03)
 
 #define I2CREG_ASPECTS_BASE   0
 #define I2CREG_OPTIONS_BASE   8
 
+// Aspect latency probe
+//  The master writes PROBE_CONTROL (sequence in bits 7:3, never zero, head in
+//  bits 2:0) in the same write as an aspect change for that head, so the
+//  register poll always sees both.  We note the frame the poll picked the new
+//  aspect up and the frame the head actually started moving towards it, so
+//  the master can split up where the time went.
+#define I2CREG_PROBE_CONTROL       16
+#define I2CREG_PROBE_LATCHED       17
+#define I2CREG_PROBE_LATCH_FRAME   18
+#define I2CREG_PROBE_OUTPUT        19
+#define I2CREG_PROBE_OUTPUT_FRAME  20
+#define I2CREG_FRAME_COUNTER       21
+
+// Per-signal indication registers, A-D.  See indicationRules.h
+#define I2CREG_INDICATION_BASE     22
+
+// Number of times the TWI has been restarted after a stalled transfer,
+//  sticks at 255
+#define I2CREG_I2C_RECOVERIES      26
+
+// A transfer that hasn't moved in this long is stuck.  The master gets an
+//  interrupt per byte, so even at 100kHz this is dozens of byte times.
+#define I2C_STALL_TIMEOUT_MS        5
+
+// Oscillator calibration, see oscCal.h
+//  The master sets CAL_WINDOW (100ms units) and then writes CAL_MARK every
+//  window, counting up from 1.  Writing 0 stops.  A skipped mark just counts
+//  as more windows.  Residual is signed ppm, positive means we run fast.
+#define I2CREG_OSCCAL              27
+#define I2CREG_CAL_MARK            28
+#define I2CREG_CAL_WINDOW          29
+#define I2CREG_CAL_STATUS          30
+#define I2CREG_CAL_RESIDUAL_L      31
+#define I2CREG_CAL_RESIDUAL_H      32
+
+// Deepest the stack has been since reset and what's never been touched, in
+//  bytes, both stick at 255.  See stackCheck.h
+#define I2CREG_STACK_USED          33
+#define I2CREG_STACK_FREE          34
+
+// Flash profile timing, in 8ms frames, for I2CREG_FLASH_PROFILE to load.
+//  See flasher.h
+#define I2CREG_FLASH_PERIOD        35
+#define I2CREG_FLASH_ON            36
+#define I2CREG_FLASH_PHASE         37
+
+// Write BOOT_ENTER_MAGIC to hand over to the I2C bootloader, see bootloader.h
+#define I2CREG_BOOTLOADER          38
+
+// Flight recorder window, FLIGHT_WINDOW_SIZE registers.  See flightRecorder.h
+#define I2CREG_FLIGHT_BASE         39
+
+// Bit n set dithers head n's outputs between PWM steps for smoother fades
+//  and color mixes, see signalHead.c.  The options registers are full.
+#define I2CREG_DITHER              45
+
+// Framed write status, I2C_FRAME_STATUS_SIZE registers.  See avr-i2c-slave.h
+#define I2CREG_FRAME_STATUS_BASE   46
+const uint8_t i2c_frameStatusReg = I2CREG_FRAME_STATUS_BASE;
+
+// What this is and what it can do, for the master's bus discovery
+#define I2CREG_ID                  49
+#define I2CREG_FW_VERSION          50
+#define I2CREG_CAPABILITIES        51
+
+#define SHCP_ID                  0x5C
+#define SHCP_FW_VERSION             3
+#define CAPABILITY_FRAMED_WRITES   0x01
+#define CAPABILITY_FLIGHT_RECORDER 0x02
+#define CAPABILITY_BOOTLOADER      0x04
+#define CAPABILITY_DITHER          0x08
+#define CAPABILITY_PAGES           0x10
+
+// Picks what the page window (I2C_PAGE_WINDOW up) shows, see avr-i2c-slave.h.
+//  Nothing here is copied anywhere until a read asks for it.
+#define I2CREG_PAGE_SELECT         52
+const uint8_t i2c_pageSelectReg = I2CREG_PAGE_SELECT;
+
+// Write FLASH_PROFILE_LOAD | profile to set that profile from registers
+//  35-37.  Reads back as just the profile once it's done, with 35-37 showing
+//  what it took (on and phase get clipped to the period).
+#define I2CREG_FLASH_PROFILE       53
+#define FLASH_PROFILE_LOAD       0x80
+
+// Build constants: ID, firmware version, heads, flight recorder entries,
+//  most framed write data, biggest page, aspects, indications
+#define PAGE_BUILD                 0
+// Each head's aspect, the low byte of endAspect, after indication mode
+//  has had its say
+#define PAGE_HEAD_ASPECTS          1
+// Each head's transition phase and red, yellow and green PWM, 4 bytes a head
+#define PAGE_HEAD_OUTPUTS          2
+// The options each head is actually running with, SIGNAL_OPTION_* bits
+//  with the flash config on top
+#define PAGE_HEAD_OPTIONS          3
+// Rule set 3 from EEPROM, see indicationRules.h
+#define PAGE_INDICATION_RULES      4
+// OSCCAL saved by the last calibration, 0xFF if never
+#define PAGE_OSCCAL_SAVED          5
+// Period, on time and phase of each flash profile, 3 bytes a profile
+#define PAGE_FLASH_PROFILES        6
+
+static const uint8_t pageBuild[] PROGMEM =
+{
+	SHCP_ID, SHCP_FW_VERSION, MAX_SIGNAL_HEADS, FLIGHT_RECORDER_ENTRIES,
+#ifdef I2C_FRAME_MAX
+	I2C_FRAME_MAX,
+#else
+	0,
+#endif
+	I2C_PAGE_SIZE, ASPECT_END, INDICATION_END
+};
+
+const I2CPage i2c_pages[] PROGMEM =
+{
+	[PAGE_BUILD]            = { I2C_PAGE_FLASH,  sizeof(pageBuild), sizeof(pageBuild), sizeof(pageBuild), pageBuild },
+	[PAGE_HEAD_ASPECTS]     = { I2C_PAGE_RAM,    1, sizeof(SignalState_t), 1 * MAX_SIGNAL_HEADS, &signal[0].endAspect },
+	[PAGE_HEAD_OUTPUTS]     = { I2C_PAGE_RAM,    4, sizeof(SignalState_t), 4 * MAX_SIGNAL_HEADS, &signal[0].phase },
+	[PAGE_HEAD_OPTIONS]     = { I2C_PAGE_RAM,    1, 1, MAX_SIGNAL_HEADS, (const void*)signalHeadOptions },
+	[PAGE_INDICATION_RULES] = { I2C_PAGE_EEPROM, INDICATION_END, INDICATION_END, INDICATION_END, indicationRulesEEPROM },
+	[PAGE_OSCCAL_SAVED]     = { I2C_PAGE_EEPROM, 1, 1, 1, &oscCalEEPROM },
+	[PAGE_FLASH_PROFILES]   = { I2C_PAGE_RAM,    sizeof(FlashProfile_t), sizeof(FlashProfile_t), sizeof(flashProfile), flashProfile },
+};
+const uint8_t i2c_pageCount = sizeof(i2c_pages) / sizeof(i2c_pages[0]);
+
+// Read-only registers, in order.  Everything else is writable.
+const I2CRegisterRange i2c_registerRanges[] PROGMEM =
+{
+	{ I2CREG_PROBE_LATCHED,     I2CREG_FRAME_COUNTER,   I2CREG_ATTR_READONLY },
+	{ I2CREG_I2C_RECOVERIES,    I2CREG_OSCCAL,          I2CREG_ATTR_READONLY },
+	{ I2CREG_CAL_STATUS,        I2CREG_STACK_FREE,      I2CREG_ATTR_READONLY },
+	{ I2CREG_FLIGHT_BASE,       I2CREG_FLIGHT_BASE + FLIGHT_WINDOW_NEXT - 1, I2CREG_ATTR_READONLY },
+	{ I2CREG_FRAME_STATUS_BASE, I2CREG_FRAME_STATUS_BASE + I2C_FRAME_STATUS_SIZE - 1, I2CREG_ATTR_READONLY },
+	{ I2CREG_ID,                I2CREG_CAPABILITIES,    I2CREG_ATTR_READONLY },
+};
+const uint8_t i2c_registerRangeCount = sizeof(i2c_registerRanges) / sizeof(i2c_registerRanges[0]);
+
+#define PROBE_HEAD_MASK  0x07
+
+#define PROBE_IDLE     0
+#define PROBE_ARMED    1
+#define PROBE_LATCHED  2
+
 
 uint32_t getMillis()
 {
@@ -91,14 +246,29 @@ uint32_t getMillis()
 	return retmillis;
 }
 
-volatile uint8_t flasher = 0;
+// Time in timer counts (1us each at a nominal 8MHz), good enough to calibrate
+//  against.  Wraps every 71 minutes, so only use it for differences.
+uint32_t getTimerMicros()
+{
+	uint32_t ticks;
+	uint8_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = TCNT0;
+		ticks = millis * 4 + subMillis;
+		// Compare match happened but the ISR hasn't run yet
+		if ((TIFR0 & _BV(OCF0A)) && count < 128)
+			ticks++;
+	}
+	return ticks * (OCR0A + 1) + count;
+}
+
+volatile uint8_t frameCounter = 0;
 volatile bool updateSignals = false;
 
 ISR(TIMER0_COMPA_vect) 
 {
-	static uint8_t flasherCounter = 0;
 	static uint8_t pwmPhase = 0;
-	static uint8_t subMillisCounter = 0;
 	
 	// The ISR does two main things - updates the LED outputs since
 	//  PWM is done through software, and updates millis which is used
@@ -107,19 +277,12 @@ ISR(TIMER0_COMPA_vect)
 	
 	// First thing, output the signals so that the PWM doesn't get too much jitter
 
-	signalHeadISR_OutputPWM(&signal[0], signalHeadOptions[0], pwmPhase, SIGNAL_HEAD_0_DEF);
-	signalHeadISR_OutputPWM(&signal[1], signalHeadOptions[1], pwmPhase, SIGNAL_HEAD_1_DEF);
-	signalHeadISR_OutputPWM(&signal[2], signalHeadOptions[2], pwmPhase, SIGNAL_HEAD_2_DEF);
-	signalHeadISR_OutputPWM(&signal[3], signalHeadOptions[3], pwmPhase, SIGNAL_HEAD_3_DEF);
-	signalHeadISR_OutputPWM(&signal[4], signalHeadOptions[4], pwmPhase, SIGNAL_HEAD_4_DEF);
-	signalHeadISR_OutputPWM(&signal[5], signalHeadOptions[5], pwmPhase, SIGNAL_HEAD_5_DEF);
-	signalHeadISR_OutputPWM(&signal[6], signalHeadOptions[6], pwmPhase, SIGNAL_HEAD_6_DEF);
-	signalHeadISR_OutputPWM(&signal[7], signalHeadOptions[7], pwmPhase, SIGNAL_HEAD_7_DEF);
+	pinmapOutputPWM(signal, pinmapInvert, pwmPhase);
 
 	// Now do all the counter incrementing and such
-	if (++subMillisCounter >= 4)
+	if (++subMillis >= 4)
 	{
-		subMillisCounter = 0;
+		subMillis = 0;
 		millis++;
 	}
 
@@ -128,12 +291,7 @@ ISR(TIMER0_COMPA_vect)
 	if (0 == pwmPhase)
 	{
 		pwmPhase = 0;
-		flasherCounter++;
-		if (flasherCounter > 94)
-		{
-			flasher ^= 0x01;
-			flasherCounter = 0;
-		}
+		frameCounter++;
 
 		// We rolled over the PWM counter, calculate the next PWM widths
 		// This runs at 125 frames/second essentially
@@ -152,12 +310,45 @@ void initializeTimer()
 	TIMSK0 = _BV(OCIE0A);
 }
 
+// Blank the heads and jump to the bootloader.  Parts without one (the tiny48
+//  builds, or a chip programmed over ISP with just the application) carry on.
+void enterBootloader()
+{
+#if FLASHEND > BOOT_START
+	if (0xFFFF == pgm_read_word(BOOT_START))
+		return;
+
+	cli();
+	TIMSK0 = 0;
+	TWCR = 0;
+	PORTA = PINMAP_PORTA_INIT;
+	PORTB = PINMAP_PORTB_INIT;
+	PORTC = PINMAP_PORTC_INIT;
+	PORTD = PINMAP_PORTD_INIT;
+	GPIOR0 = BOOT_ENTER_MAGIC;
+	((void (*)(void))(BOOT_START/2))();
+#endif
+}
+
 void initializeRegisterMap()
 {
+	// Attributes are in i2c_registerRanges[]
 	for(uint8_t i=0; i<I2C_REGISTER_MAP_SIZE; i++)
-	{
-		i2c_registerMap[i] = i2c_registerAttributes[i] = 0;
-	}
+		i2c_registerMap[i] = 0;
+
+	i2c_registerMap[I2CREG_ID] = SHCP_ID;
+	i2c_registerMap[I2CREG_FW_VERSION] = SHCP_FW_VERSION;
+	i2c_registerMap[I2CREG_CAPABILITIES] = CAPABILITY_DITHER | CAPABILITY_PAGES
+#if FLIGHT_RECORDER_ENTRIES
+		| CAPABILITY_FLIGHT_RECORDER
+#endif
+#ifdef I2C_FRAME_MAX
+		| CAPABILITY_FRAMED_WRITES
+#endif
+#if FLASHEND > BOOT_START
+		| ((0xFFFF != pgm_read_word(BOOT_START))?CAPABILITY_BOOTLOADER:0)
+#endif
+		;
 }
 
 void initializeI2C()
@@ -166,6 +357,31 @@ void initializeI2C()
 	i2cSlaveInitialize(0x40, false);
 }
 
+SignalAspect_t indicationToAspect(uint8_t indicationReg, bool lowerHead)
+{
+	uint8_t ruleSet = INDICATION_RULESET(indicationReg);
+	uint8_t indication = INDICATION_VALUE(indicationReg);
+	uint8_t rule = 0xFF;
+	SignalAspect_t aspect;
+
+	// Anything we don't understand gets treated as the most restrictive
+	if (indication >= INDICATION_END)
+		indication = INDICATION_STOP;
+
+	if (INDICATION_RULES_EEPROM == ruleSet)
+		rule = eeprom_read_byte(&indicationRulesEEPROM[indication]);
+	else if (ruleSet < INDICATION_RULES_EEPROM)
+		rule = pgm_read_byte(&indicationRules[ruleSet][indication]);
+
+	aspect = lowerHead?RULE_LOWER(rule):RULE_UPPER(rule);
+	if (aspect >= ASPECT_END)
+	{
+		rule = pgm_read_byte(&indicationRules[INDICATION_RULES_SINGLE_HEAD][indication]);
+		aspect = lowerHead?RULE_LOWER(rule):RULE_UPPER(rule);
+	}
+	return aspect;
+}
+
 void initializeOptions(DebounceState8_t* optionsDebouncer)
 {
 	// Basically the only thing the debouncer cares about is the common anode / common cathode
@@ -185,70 +401,49 @@ int main(void)
 	uint32_t currentTime = 0;
 	uint8_t i=0;
 	uint8_t defaultSignalHeadOptions = SIGNAL_OPTION_COMMON_ANODE;
+	uint8_t probeControl = 0;
+	uint8_t probeState = PROBE_IDLE;
+	uint8_t lastI2CActivity = 0;
+	uint32_t lastI2CActivityTime = 0;
+	bool i2cRecovered = false;
+	OscCalState_t oscCal;
+	uint8_t calMark = 0;
+	uint32_t calMarkTime = 0;
+	uint8_t lastFrame = 0;
+	uint8_t resetCause = MCUSR;
+	bool lastCaSense = false;
 	// Deal with watchdog first thing
 	MCUSR = 0;              // Clear reset status
 	wdt_reset();            // Reset the WDT, just in case it's still enabled over reset
 	wdt_enable(WDTO_1S);    // Enable it at a 1S timeout.
 
-	// PORT A
-	//  PA7 - n/a
-	//  PA6 - n/a
-	//  PA5 - n/a
-	//  PA4 - n/a
-	//  PA3 - Input  - B1 Signal - RED
-	//  PA2 - Input  - A2 Signal - GREEN
-	//  PA1 - Output - D1 Signal - YELLOW
-	//  PA0 - Input  - Common anode / common cathode sense (1 = common anode)
-
-	// PORT B
-	//  PB7 - Output - B1 Signal - GREEN
-	//  PB6 - Output - B1 Signal - YELLOW
-	//  PB5 - Output - C2 Signal - GREEN
-	//  PB4 - Output - C2 Signal - YELLOW
-	//  PB3 - Output - C2 Signal - RED
-	//  PB2 - Output - C1 Signal - GREEN
-	//  PB1 - Output - C1 Signal - YELLOW
-	//  PB0 - Output - C1 Signal - RED
-
-	// PORT C
-	//  PC7 - Output - D1 Signal - RED
-	//  PC6 - n/a    - /RESET (not I/O pin)
-	//  PC5 - n/a    - SCL
-	//  PC4 - n/a    - SDA
-	//  PC3 - Output - D2 Signal - GREEN
-	//  PC2 - Output - D2 Signal - YELLOW
-	//  PC1 - Output - D2 Signal - RED
-	//  PC0 - Output - D1 Signal - GREEN
-
-	// PORT D
-	//  PD7 - Output - B2 Signal - GREEN
-	//  PD6 - Output - B2 Signal - YELLOW
-	//  PD5 - Output - B2 Signal - RED
-	//  PD4 - Output - A2 Signal - YELLOW
-	//  PD3 - Output - A2 Signal - RED
-	//  PD2 - Output - A1 Signal - GREEN
-	//  PD1 - Output - A1 Signal - YELLOW
-	//  PD0 - Output - A1 Signal - RED
-
-
-	PORTA = 0b00000001;
-	DDRA  = 0b00001110;
-
-	PORTB = 0b00000000;
-	DDRB  = 0b11111111;
-
-	PORTC = 0b00110000;
-	DDRC  = 0b10001111;
-
-	PORTD = 0b00000000;
-	DDRD  = 0b11111111;
+	// See pinmaps/ for what each pin does on this board
+	PORTA = PINMAP_PORTA_INIT;
+	DDRA  = PINMAP_DDRA_INIT;
+
+	PORTB = PINMAP_PORTB_INIT;
+	DDRB  = PINMAP_DDRB_INIT;
+
+	PORTC = PINMAP_PORTC_INIT;
+	DDRC  = PINMAP_DDRC_INIT;
 
+	PORTD = PINMAP_PORTD_INIT;
+	DDRD  = PINMAP_DDRD_INIT;
+
+	// Before the timer starts so everything runs at the calibrated rate
+	oscCalInitialize(&oscCal);
+
+	flasherInitialize();
+	flightRecorderInitialize(signal);
+	flightLog(0, FLIGHT_RESET, resetCause);
 	initializeTimer();
 	initializeI2C();
+	i2c_registerMap[I2CREG_OSCCAL] = OSCCAL;
 	initializeOptions(&optionsDebouncer);
 
 	if (getDebouncedState(&optionsDebouncer) & SENSE_COMMON_ANODE)
 		defaultSignalHeadOptions |= SIGNAL_OPTION_COMMON_ANODE;
+	lastCaSense = (getDebouncedState(&optionsDebouncer) & OPTION_COMMON_ANODE)?true:false;
 
 	for(i=0; i<MAX_SIGNAL_HEADS; i++)
 	{
@@ -256,6 +451,7 @@ int main(void)
 		signalHeadAspectSet(&signal[i], ASPECT_OFF);
 		signalHeadOptions[i] = defaultSignalHeadOptions;
 	}
+	pinmapInvertUpdate(signalHeadOptions, pinmapInvert);
 
 	sei();
 	wdt_reset();
@@ -266,27 +462,135 @@ int main(void)
 
 		if (updateSignals)
 		{
+			SignalState_t* probeSignal = &signal[probeControl & PROBE_HEAD_MASK];
+			SignalAspect_t probeEndAspect = probeSignal->endAspect;
+
+			// Step the flash counters by however many frames went by, in case
+			//  the loop was held up long enough to miss one
+			uint8_t frame = frameCounter;
+			flasherAdvance(frame - lastFrame);
+			lastFrame = frame;
+
 			updateSignals = false;
 			for (uint8_t i=0; i<MAX_SIGNAL_HEADS; i++)
-				signalHeadISR_AspectToNextPWM(&signal[i], flasher, signalHeadOptions[i]);
+				signalHeadISR_AspectToNextPWM(&signal[i], flasherState(SIGNAL_OPTION_FLASH_CONFIG(signalHeadOptions[i])), signalHeadOptions[i]);
+
+			// The probed head has started towards its new aspect
+			if (PROBE_LATCHED == probeState && probeSignal->endAspect != probeEndAspect)
+			{
+				i2c_registerMap[I2CREG_PROBE_OUTPUT_FRAME] = frameCounter;
+				i2c_registerMap[I2CREG_PROBE_OUTPUT] = probeControl;
+				probeState = PROBE_IDLE;
+			}
+			i2c_registerMap[I2CREG_FRAME_COUNTER] = frameCounter;
 		}
 
 		currentTime = getMillis();
 
+		// TWI stall check.  Anything short of the 1s watchdog used to leave us
+		//  stuck mid-transfer (i2cBusy never clears, or SDA held low), and the
+		//  watchdog blanks every head.  Restarting just the TWI gets the bus
+		//  back in a few ms without the lamps noticing.  An idle bus with SDA
+		//  high is healthy no matter how long it's been quiet.
+		if (i2cActivity() != lastI2CActivity || (!i2cBusy() && (PINC & _BV(PC4))))
+		{
+			lastI2CActivity = i2cActivity();
+			lastI2CActivityTime = currentTime;
+			i2cRecovered = false;
+		}
+		else if (!i2cRecovered && ((uint32_t)currentTime - lastI2CActivityTime) > I2C_STALL_TIMEOUT_MS)
+		{
+			// Only once per stall - if somebody else is holding SDA low, resetting
+			//  over and over won't help and would just run up the count
+			i2cSlaveReset();
+			i2cRecovered = true;
+			if (i2c_registerMap[I2CREG_I2C_RECOVERIES] < 0xFF)
+				i2c_registerMap[I2CREG_I2C_RECOVERIES]++;
+			flightLog(0, FLIGHT_I2C_RECOVERY, i2c_registerMap[I2CREG_I2C_RECOVERIES]);
+		}
+
+		// Here rather than the 50ms poll so draining it doesn't take forever
+		flightRecorderService(&i2c_registerMap[I2CREG_FLIGHT_BASE]);
+
+		// Calibration marks are timestamped here rather than in the 50ms poll,
+		//  the loop comes around often enough to keep the error well under 0.1%
+		if (i2c_registerMap[I2CREG_CAL_MARK] != calMark)
+		{
+			uint32_t now = getTimerMicros();
+			uint8_t mark = i2c_registerMap[I2CREG_CAL_MARK];
+			int16_t residual;
+
+			if (0 == mark)
+			{
+				// Abort, but leave a finished result up for the master to read
+				if (OSCCAL_STATUS_MEASURING == oscCal.status)
+					oscCal.status = OSCCAL_STATUS_IDLE;
+			}
+			else if (0 == calMark || OSCCAL_STATUS_MEASURING != oscCal.status)
+				oscCalStart(&oscCal);
+			else
+				oscCalUpdate(&oscCal, now - calMarkTime, (uint32_t)(uint8_t)(mark - calMark) * i2c_registerMap[I2CREG_CAL_WINDOW] * 100000UL);
+
+			calMark = mark;
+			calMarkTime = now;
+
+			residual = oscCalResidualPpm(&oscCal);
+			i2c_registerMap[I2CREG_OSCCAL] = OSCCAL;
+			i2c_registerMap[I2CREG_CAL_STATUS] = oscCal.status;
+			i2c_registerMap[I2CREG_CAL_RESIDUAL_L] = residual & 0xFF;
+			i2c_registerMap[I2CREG_CAL_RESIDUAL_H] = (residual >> 8) & 0xFF;
+		}
+
 		// Because debouncing and such is built into option reading and the MSS library, only 
 		//  run the updates every 10mS or so.
 
 		if (((uint32_t)currentTime - lastReadTime) > LOOP_UPDATE_TIME_MS && !(i2cBusy()))
 		{
 			bool caSense = false;
+			uint16_t stackBytes;
 			lastReadTime = currentTime;
 			readOptions(&optionsDebouncer);
+
+			// Each of these scans the stack, so only once apiece
+			stackBytes = stackUsedBytes();
+			i2c_registerMap[I2CREG_STACK_USED] = MIN(stackBytes, 0xFF);
+			stackBytes = stackFreeBytes();
+			i2c_registerMap[I2CREG_STACK_FREE] = MIN(stackBytes, 0xFF);
 			if (getDebouncedState(&optionsDebouncer) & OPTION_COMMON_ANODE)
 				caSense = true;
+			if (caSense != lastCaSense)
+			{
+				flightLog(0, FLIGHT_CA_SENSE, caSense);
+				lastCaSense = caSense;
+			}
+
+			if (BOOT_ENTER_MAGIC == i2c_registerMap[I2CREG_BOOTLOADER])
+			{
+				enterBootloader();
+				i2c_registerMap[I2CREG_BOOTLOADER] = 0;
+			}
+
+			if (i2c_registerMap[I2CREG_FLASH_PROFILE] & FLASH_PROFILE_LOAD)
+			{
+				uint8_t profile = i2c_registerMap[I2CREG_FLASH_PROFILE] & FLASH_PROFILE_MASK;
+				flasherSetProfile(profile, i2c_registerMap[I2CREG_FLASH_PERIOD], i2c_registerMap[I2CREG_FLASH_ON], i2c_registerMap[I2CREG_FLASH_PHASE]);
+				i2c_registerMap[I2CREG_FLASH_PERIOD] = flashProfile[profile].period;
+				i2c_registerMap[I2CREG_FLASH_ON] = flashProfile[profile].on;
+				i2c_registerMap[I2CREG_FLASH_PHASE] = flashProfile[profile].phase;
+				i2c_registerMap[I2CREG_FLASH_PROFILE] = profile;
+			}
+
+			if (i2c_registerMap[I2CREG_PROBE_CONTROL] != probeControl)
+			{
+				probeControl = i2c_registerMap[I2CREG_PROBE_CONTROL];
+				probeState = (0 != probeControl)?PROBE_ARMED:PROBE_IDLE;
+			}
 
 			for(i=0; i<MAX_SIGNAL_HEADS; i++)
 			{
 				uint8_t optionsReg = i2c_registerMap[I2CREG_OPTIONS_BASE+i];
+				uint8_t indicationReg = i2c_registerMap[I2CREG_INDICATION_BASE + (i>>1)];
+				SignalAspect_t aspect = i2c_registerMap[I2CREG_ASPECTS_BASE+i];
 				uint8_t optionsTemp = 0;
 				switch(optionsReg & 0xC0)
 				{
@@ -303,22 +607,33 @@ int main(void)
 						break;
 				}
 
-				switch (optionsReg & 0x07)
-				{
-					case OPTION_SIGNAL_THREE_LIGHT:
-						break;
+				if (optionsReg & OPTION_SIGNAL_SEARCHLIGHT)
+					optionsTemp |= SIGNAL_OPTION_SEARCHLIGHT;
 
-					case OPTION_SIGNAL_SEARCHLIGHT:
-						optionsTemp |= SIGNAL_OPTION_SEARCHLIGHT;
-						break;
+				optionsTemp |= SIGNAL_OPTION_MIX(OPTION_MIX(optionsReg));
+				optionsTemp |= SIGNAL_OPTION_FLASH(OPTION_FLASH(optionsReg));
 
-					default:
-						break;
-				}
+				if (i2c_registerMap[I2CREG_DITHER] & (1<<i))
+					optionsTemp |= SIGNAL_OPTION_DITHER;
 
 				signalHeadOptions[i] = optionsTemp;
-				signalHeadAspectSet(&signal[i], i2c_registerMap[I2CREG_ASPECTS_BASE+i]);
+
+				// Both heads of a signal get set in the same pass, so they
+				//  start moving on the same frame
+				if (indicationReg & INDICATION_MODE_ENABLE)
+					aspect = indicationToAspect(indicationReg, i & 0x01);
+
+				if (PROBE_ARMED == probeState && i == (probeControl & PROBE_HEAD_MASK)
+					&& aspect != signalHeadAspectGet(&signal[i]))
+				{
+					i2c_registerMap[I2CREG_PROBE_LATCH_FRAME] = frameCounter;
+					i2c_registerMap[I2CREG_PROBE_LATCHED] = probeControl;
+					probeState = PROBE_LATCHED;
+				}
+
+				signalHeadAspectSet(&signal[i], aspect);
 			}
+			pinmapInvertUpdate(signalHeadOptions, pinmapInvert);
 		}
 	}
 }
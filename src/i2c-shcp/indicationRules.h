@@ -0,0 +1,108 @@
+/*************************************************************************
+Title:    I2C-SHCP Indication to Aspect Rules
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     indicationRules.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _INDICATION_RULES_H_
+#define _INDICATION_RULES_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include "signalAspect.h"
+
+/* Instead of writing aspects for both heads, the master can write the MSS
+   indication for a signal and let us work out the aspects.  Each signal
+   (A-D) owns two heads, upper (x1) and lower (x2).
+
+   Indication register:
+     7    - 1 = indication mode, heads ignore their aspect registers
+     6:4  - rule set
+     3:0  - indication (STOP, APPROACH, ...)
+
+   Each rule is a byte, low nibble upper head aspect, high nibble lower head
+   aspect.  Rule sets 0-2 are fixed, 3 comes from EEPROM so it can be changed
+   without rebuilding (make eeprom).  Anything that doesn't decode to a real
+   aspect falls back to the single head rules.
+*/
+
+typedef enum
+{
+	INDICATION_STOP               = 0,
+	INDICATION_APPROACH           = 1,
+	INDICATION_ADVANCE_APPROACH   = 2,
+	INDICATION_APPROACH_DIVERGING = 3,
+	INDICATION_CLEAR              = 4,
+	INDICATION_END
+} SignalIndication_t;
+
+#define INDICATION_MODE_ENABLE     0x80
+#define INDICATION_RULESET(r)      (((r)>>4) & 0x07)
+#define INDICATION_VALUE(r)        ((r) & 0x0F)
+
+#define INDICATION_RULES_SINGLE_HEAD   0
+#define INDICATION_RULES_TWO_HEAD      1
+#define INDICATION_RULES_SEARCHLIGHT   2
+#define INDICATION_RULES_EEPROM        3
+#define INDICATION_RULESETS            4
+
+#define RULE(upper, lower)   ((((lower) & 0x0F)<<4) | ((upper) & 0x0F))
+#define RULE_UPPER(r)        ((r) & 0x0F)
+#define RULE_LOWER(r)        (((r)>>4) & 0x0F)
+
+const uint8_t indicationRules[INDICATION_RULESETS-1][INDICATION_END] PROGMEM =
+{
+	// Single head, lower head dark
+	{
+		RULE(ASPECT_RED,       ASPECT_OFF),       // STOP
+		RULE(ASPECT_YELLOW,    ASPECT_OFF),       // APPROACH
+		RULE(ASPECT_FL_YELLOW, ASPECT_OFF),       // ADVANCE_APPROACH
+		RULE(ASPECT_FL_YELLOW, ASPECT_OFF),       // APPROACH_DIVERGING
+		RULE(ASPECT_GREEN,     ASPECT_OFF)        // CLEAR
+	},
+	// Two head, upper over lower
+	{
+		RULE(ASPECT_RED,       ASPECT_RED),       // STOP
+		RULE(ASPECT_YELLOW,    ASPECT_RED),       // APPROACH
+		RULE(ASPECT_YELLOW,    ASPECT_GREEN),     // ADVANCE_APPROACH
+		RULE(ASPECT_YELLOW,    ASPECT_YELLOW),    // APPROACH_DIVERGING
+		RULE(ASPECT_GREEN,     ASPECT_RED)        // CLEAR
+	},
+	// Two head searchlight, no flashing aspects
+	{
+		RULE(ASPECT_RED,       ASPECT_RED),       // STOP
+		RULE(ASPECT_YELLOW,    ASPECT_RED),       // APPROACH
+		RULE(ASPECT_YELLOW,    ASPECT_YELLOW),    // ADVANCE_APPROACH
+		RULE(ASPECT_RED,       ASPECT_YELLOW),    // APPROACH_DIVERGING
+		RULE(ASPECT_GREEN,     ASPECT_RED)        // CLEAR
+	}
+};
+
+// Starts out the same as two head, program with "make eeprom" after changing
+uint8_t indicationRulesEEPROM[INDICATION_END] EEMEM =
+{
+	RULE(ASPECT_RED,       ASPECT_RED),
+	RULE(ASPECT_YELLOW,    ASPECT_RED),
+	RULE(ASPECT_YELLOW,    ASPECT_GREEN),
+	RULE(ASPECT_YELLOW,    ASPECT_YELLOW),
+	RULE(ASPECT_GREEN,     ASPECT_RED)
+};
+
+#endif
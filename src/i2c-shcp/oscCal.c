@@ -0,0 +1,143 @@
+/*************************************************************************
+Title:    I2C-SHCP Oscillator Calibration
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     oscCal.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "oscCal.h"
+
+// 0xFF means never calibrated, keep the factory value.  "make eeprom" writes
+//  this back to 0xFF, so recalibrate after using it.
+uint8_t oscCalEEPROM EEMEM = 0xFF;
+
+void oscCalInitialize(OscCalState_t* cal)
+{
+	uint8_t saved = eeprom_read_byte(&oscCalEEPROM);
+
+	if (0xFF != saved)
+		OSCCAL = saved;
+
+	cal->status = OSCCAL_STATUS_IDLE;
+	cal->bestOsccal = cal->lastOsccal = OSCCAL;
+	cal->bestErrorPpm = cal->lastErrorPpm = 0;
+	cal->iterations = 0;
+	cal->ppmPerStep = OSCCAL_PPM_PER_STEP;
+}
+
+void oscCalStart(OscCalState_t* cal)
+{
+	cal->status = OSCCAL_STATUS_MEASURING;
+	cal->iterations = 0;
+	cal->bestOsccal = cal->lastOsccal = OSCCAL;
+	cal->bestErrorPpm = INT32_MAX;
+}
+
+static void oscCalFinish(OscCalState_t* cal)
+{
+	OSCCAL = cal->bestOsccal;
+	eeprom_update_byte(&oscCalEEPROM, cal->bestOsccal);
+	cal->status = OSCCAL_STATUS_DONE;
+}
+
+// measuredUs is how long we think passed between two marks, expectedUs is
+//  how long the master says it was.  Positive error means we're running fast.
+void oscCalUpdate(OscCalState_t* cal, uint32_t measuredUs, uint32_t expectedUs)
+{
+	int32_t diffUs = (int32_t)(measuredUs - expectedUs);
+	int32_t errorPpm;
+	int32_t steps;
+	int16_t newOsccal;
+	uint8_t rangeBase;
+
+	if (OSCCAL_STATUS_MEASURING != cal->status)
+		return;
+
+	// Anything more than 10% out is a missed mark, not the oscillator.  Keeping
+	//  the window under 10s also keeps the math in 32 bits.
+	if (expectedUs < OSCCAL_MIN_WINDOW_US || expectedUs > OSCCAL_MAX_WINDOW_US || labs(diffUs) > (int32_t)(expectedUs / 10))
+	{
+		cal->status = OSCCAL_STATUS_FAILED;
+		return;
+	}
+
+	errorPpm = diffUs * 1000 / (int32_t)(expectedUs / 1000);
+
+	// Learn the real step size from the last move
+	if (OSCCAL != cal->lastOsccal && cal->iterations)
+	{
+		int32_t slope = labs((cal->lastErrorPpm - errorPpm) / ((int16_t)OSCCAL - (int16_t)cal->lastOsccal));
+		if (slope > 500)
+			cal->ppmPerStep = slope;
+	}
+
+	if (labs(errorPpm) < labs(cal->bestErrorPpm))
+	{
+		cal->bestErrorPpm = errorPpm;
+		cal->bestOsccal = OSCCAL;
+	}
+
+	cal->lastErrorPpm = errorPpm;
+	cal->lastOsccal = OSCCAL;
+
+	// Within half a step is as good as it gets
+	steps = (errorPpm + ((errorPpm > 0)?cal->ppmPerStep/2:-cal->ppmPerStep/2)) / cal->ppmPerStep;
+	if (0 == steps || ++cal->iterations >= OSCCAL_MAX_ITERATIONS)
+	{
+		oscCalFinish(cal);
+		return;
+	}
+
+	if (steps > OSCCAL_MAX_STEP)
+		steps = OSCCAL_MAX_STEP;
+	else if (steps < -OSCCAL_MAX_STEP)
+		steps = -OSCCAL_MAX_STEP;
+
+	// Running fast means OSCCAL comes down, but never across CAL7.  The two
+	//  halves overlap rather than carry on from each other (AVR053), so 0x7F
+	//  and 0x80 are nowhere near each other and the search stays in the half
+	//  it started in.  bestOsccal always has the starting CAL7.
+	rangeBase = cal->bestOsccal & 0x80;
+	newOsccal = (int16_t)OSCCAL - steps;
+	if (newOsccal < rangeBase)
+		newOsccal = rangeBase;
+	else if (newOsccal > rangeBase + 0x7F)
+		newOsccal = rangeBase + 0x7F;
+
+	// Already at the end of the range, nothing better to try
+	if (newOsccal == OSCCAL)
+	{
+		oscCalFinish(cal);
+		return;
+	}
+	OSCCAL = newOsccal;
+}
+
+int16_t oscCalResidualPpm(OscCalState_t* cal)
+{
+	int32_t ppm = (OSCCAL_STATUS_DONE == cal->status)?cal->bestErrorPpm:cal->lastErrorPpm;
+
+	if (ppm > INT16_MAX)
+		return INT16_MAX;
+	if (ppm < INT16_MIN)
+		return INT16_MIN;
+	return ppm;
+}
@@ -0,0 +1,74 @@
+/*************************************************************************
+Title:    I2C-SHCP Oscillator Calibration
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     oscCal.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _OSC_CAL_H_
+#define _OSC_CAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Everything on the SHCP (PWM, frames, flash rate, transitions) is timed off
+   the internal RC oscillator, which is only good to a few percent out of the
+   factory.  The master has a crystal, so it writes marks to us at a known
+   spacing and we compare that to how far our own timer moved, then nudge
+   OSCCAL until the two agree.  The result goes to EEPROM and is loaded at
+   every power up.
+
+   OSCCAL bit 7 (CAL7) picks one of two overlapping frequency ranges, so
+   the search only moves bits 6:0 and stays in whichever range it started
+   in, the same as AVR053.
+*/
+
+#define OSCCAL_STATUS_IDLE        0
+#define OSCCAL_STATUS_MEASURING   1
+#define OSCCAL_STATUS_DONE        2
+#define OSCCAL_STATUS_FAILED      3
+
+// Starting guess for how far one OSCCAL step moves the clock.  It gets
+//  replaced by what we actually see as soon as OSCCAL has moved once.
+#define OSCCAL_PPM_PER_STEP     4000
+// Never move more than this many steps at once, big jumps can upset the core
+#define OSCCAL_MAX_STEP            4
+#define OSCCAL_MAX_ITERATIONS     16
+#define OSCCAL_MIN_WINDOW_US   100000UL
+#define OSCCAL_MAX_WINDOW_US 10000000UL
+
+typedef struct
+{
+	uint8_t status;
+	uint8_t iterations;
+	uint8_t bestOsccal;
+	uint8_t lastOsccal;
+	int32_t bestErrorPpm;
+	int32_t lastErrorPpm;
+	int32_t ppmPerStep;
+} OscCalState_t;
+
+// In EEPROM, read straight out of it by the I2C register pages
+extern uint8_t oscCalEEPROM;
+
+void oscCalInitialize(OscCalState_t* cal);
+void oscCalStart(OscCalState_t* cal);
+void oscCalUpdate(OscCalState_t* cal, uint32_t measuredUs, uint32_t expectedUs);
+int16_t oscCalResidualPpm(OscCalState_t* cal);
+
+#endif
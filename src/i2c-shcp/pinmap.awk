@@ -0,0 +1,173 @@
+#*************************************************************************
+#Title:    I2C-SHCP Pin Map Generator
+#Authors:  Michael Petersen <railfan@drgw.net>
+#          Nathan Holmes <maverick@drgw.net>
+#License:  GNU General Public License v3
+#
+#LICENSE:
+#    Copyright (C) 2025 Nathan Holmes and Michael Petersen
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#*************************************************************************
+#
+# Turns a pinmaps/*.pinmap file into pinmap.h:
+#  - PINMAP_PORTx_INIT / PINMAP_DDRx_INIT for main() to load
+#  - pinmapOutputPWM(), one read-modify-write per port with every head, pin
+#    and mask folded to a constant
+#  - pinmapInvertUpdate(), which works out per port which outputs belong to
+#    common cathode heads so the ISR can flip them with an XOR
+#
+# Usage: awk -f pinmap.awk pinmaps/xcade.pinmap > pinmap.h
+
+function fail(msg)
+{
+	printf("%s:%d: %s\n", FILENAME, FNR, msg) > "/dev/stderr"
+	failed = 1
+	exit 1
+}
+
+function parsePin(pin,    port, bit)
+{
+	if (pin !~ /^P[A-D][0-7]$/)
+		fail("bad pin " pin)
+	port = substr(pin, 2, 1)
+	bit = substr(pin, 3, 1) + 0
+	if ((port, bit) in used)
+		fail(pin " used twice")
+	used[port, bit] = 1
+	pinPort = port
+	pinBit = bit
+}
+
+BEGIN {
+	ports = "ABCD"
+	heads = 0
+	split("red yellow green", colors, " ")
+	for (i=1; i<=4; i++)
+		portInit[substr(ports, i, 1)] = ddrInit[substr(ports, i, 1)] = 0
+}
+
+{ sub(/#.*/, "") }
+
+/^[ \t]*$/ { next }
+
+$1 == "head" {
+	if (NF != 5)
+		fail("head needs a number and three pins")
+	h = $2 + 0
+	if (h != heads)
+		fail("heads must be listed in order starting at 0")
+	for (c=1; c<=3; c++)
+	{
+		parsePin($(c+2))
+		headPort[h, c] = pinPort
+		headBit[h, c] = pinBit
+		ddrInit[pinPort] += 2^pinBit
+		outMask[pinPort] += 2^pinBit
+	}
+	heads++
+	next
+}
+
+$1 == "input" {
+	parsePin($2)
+	if ($3 == "pullup")
+		portInit[pinPort] += 2^pinBit
+	else if (NF > 2)
+		fail("unknown input option " $3)
+	next
+}
+
+{ fail("don't know what " $1 " is") }
+
+function bin(v,    s, i)
+{
+	s = ""
+	for (i=7; i>=0; i--)
+		s = s ((int(v / 2^i) % 2)?"1":"0")
+	return "0b" s
+}
+
+END {
+	if (failed)
+		exit 1
+	if (0 == heads)
+		fail("no heads")
+
+	name = FILENAME
+	sub(/.*\//, "", name)
+	sub(/\.pinmap$/, "", name)
+
+	printf("// Generated from %s by pinmap.awk - edit the pin map, not this\n\n", FILENAME)
+	printf("#ifndef _PINMAP_H_\n#define _PINMAP_H_\n\n")
+	printf("#include <avr/io.h>\n#include \"signalHead.h\"\n\n")
+	printf("#define PINMAP_NAME \"%s\"\n", name)
+	printf("#define PINMAP_HEADS %d\n\n", heads)
+
+	for (i=1; i<=4; i++)
+	{
+		p = substr(ports, i, 1)
+		printf("#define PINMAP_PORT%s_INIT  %s\n", p, bin(portInit[p]))
+		printf("#define PINMAP_DDR%s_INIT   %s\n", p, bin(ddrInit[p]))
+	}
+
+	printf("\n// Bit set = that output belongs to a common cathode head\n")
+	printf("static inline void pinmapInvertUpdate(const volatile uint8_t* options, volatile uint8_t* invert)\n{\n")
+	for (i=1; i<=4; i++)
+	{
+		p = substr(ports, i, 1)
+		if (!outMask[p])
+			continue
+		printf("\tuint8_t invert%s = 0;\n", p)
+	}
+	for (h=0; h<heads; h++)
+	{
+		printf("\tif (!(options[%d] & SIGNAL_OPTION_COMMON_ANODE))\n\t{\n", h)
+		for (c=1; c<=3; c++)
+			printf("\t\tinvert%s |= _BV(%d);\n", headPort[h, c], headBit[h, c])
+		printf("\t}\n")
+	}
+	for (i=1; i<=4; i++)
+	{
+		p = substr(ports, i, 1)
+		if (outMask[p])
+			printf("\tinvert[%d] = invert%s;\n", i-1, p)
+	}
+	printf("}\n\n")
+
+	printf("// An output is driven low when lit on a common anode head, so each port\n")
+	printf("//  gets ~(lit ^ invert) across its LED pins in a single write\n")
+	printf("static inline void pinmapOutputPWM(const SignalState_t* sig, const volatile uint8_t* invert, const uint8_t pwmPhase)\n{\n")
+	for (i=1; i<=4; i++)
+	{
+		p = substr(ports, i, 1)
+		if (!outMask[p])
+			continue
+		printf("\tuint8_t lit%s = 0;\n", p)
+	}
+	for (h=0; h<heads; h++)
+	{
+		for (c=1; c<=3; c++)
+		{
+			printf("\tif (sig[%d].%sPWM > pwmPhase)\n", h, colors[c])
+			printf("\t\tlit%s |= _BV(%d);\n", headPort[h, c], headBit[h, c])
+		}
+	}
+	for (i=1; i<=4; i++)
+	{
+		p = substr(ports, i, 1)
+		if (!outMask[p])
+			continue
+		printf("\tPORT%s = (PORT%s & ~%s) | (~(lit%s ^ invert[%d]) & %s);\n", p, p, bin(outMask[p]), p, i-1, bin(outMask[p]))
+	}
+	printf("}\n\n#endif\n")
+}
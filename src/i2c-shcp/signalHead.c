@@ -22,6 +22,8 @@ LICENSE:
 
 #include "signalHead.h"
 #include "signalHeadPWM.h"
+#include "colorMix.h"
+#include "flightRecorder.h"
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
 #define MAX(a,b) ((a)>(b)?(a):(b))
@@ -46,10 +48,14 @@ void signalHeadInitialize(SignalState_t* sig)
 	sig->redPWM = 0;
 	sig->yellowPWM = 0;
 	sig->greenPWM = 0;
+	sig->ditherFrame = 0;
 }
 
 void signalHeadAspectSet(SignalState_t* sig, SignalAspect_t aspect)
 {
+	// This gets called every poll whether it changed or not
+	if (aspect != sig->nextAspect)
+		flightLogHead(sig, FLIGHT_ASPECT, aspect);
 	sig->nextAspect = aspect;
 }
 
@@ -58,28 +64,20 @@ SignalAspect_t signalHeadAspectGet(SignalState_t* sig)
 	return sig->nextAspect;
 }
 
-void signalHeadISR_OutputPWM(SignalState_t* const sig, const uint8_t options, const uint8_t pwmPhase, 
-	volatile uint8_t* const redPort, const uint8_t redMask, volatile uint8_t* const yellowPort, 
-	const uint8_t yellowMask, volatile uint8_t* const greenPort, const uint8_t greenMask)
+static inline bool isFlashing(SignalAspect_t aspect)
 {
-	bool invert = (options & SIGNAL_OPTION_COMMON_ANODE)?false:true;
-	if ((sig->redPWM > pwmPhase) != invert)
-		*redPort &= ~redMask;
-	else
-		*redPort |= redMask;
-
-	if ((sig->yellowPWM > pwmPhase) != invert)
-		*yellowPort &= ~yellowMask;
-	else
-		*yellowPort |= yellowMask;
-
-	if ((sig->greenPWM > pwmPhase) != invert)
-		*greenPort &= ~greenMask;
-	else
-		*greenPort |= greenMask;
+	return (aspect == ASPECT_FL_GREEN || aspect == ASPECT_FL_YELLOW || aspect == ASPECT_FL_RED);
 }
 
-
+// Flashing heads go on and off every flash, which would just fill up the
+//  flight recorder.  The aspect being set is logged, that's enough.
+static void transitionDone(SignalState_t* sig)
+{
+	sig->phase = 0;
+	sig->startAspect = sig->endAspect;
+	if (!isFlashing(sig->nextAspect))
+		flightLogHead(sig, FLIGHT_DONE, sig->endAspect);
+}
 
 bool isGreenToYellow(SignalAspect_t startAspect, SignalAspect_t endAspect)
 {
@@ -97,14 +95,163 @@ bool isYellowToGreen(SignalAspect_t startAspect, SignalAspect_t endAspect)
 	return false;
 }
 
+static void aspectToMix(SignalAspect_t aspect, uint8_t options, ColorMix_t* mix)
+{
+	uint8_t mixSet = SIGNAL_OPTION_MIX_SET(options);
+
+	if (aspect >= ASPECT_END)
+		aspect = ASPECT_OFF;
+
+	if (COLOR_MIX_EEPROM == mixSet)
+		eeprom_read_block(mix, &colorMixEEPROM[aspect], sizeof(ColorMix_t));
+	else
+		memcpy_P(mix, &colorMixes[(mixSet < COLOR_MIX_EEPROM)?mixSet:COLOR_MIX_LAMP_PER_COLOR][aspect], sizeof(ColorMix_t));
+}
+
+// Intensities are 0-248, 8 to a PWM step.  Without dithering the 3 bits
+//  under the PWM value just get dropped, which comes out the same as working
+//  in PWM values all along.
+#define INTENSITY_FULL  (0x1F<<3)
+
+// Dithered heads show halfway between last frame's table phase and this
+//  one.  That's still on the straight line the tables draw, so the fade looks
+//  the same, but the steps in between give the dither something to do.
+static inline uint8_t phaseIntensity(uint8_t phase, uint8_t lastPhase, bool dither)
+{
+	if (dither)
+		return (phase + lastPhase) << 2;
+	return phase << 3;
+}
+
+// The first entry has nothing before it, so it's its own last phase
+static inline uint16_t lastPhaseWord(const uint16_t* table, uint8_t phase)
+{
+	return pgm_read_word(&table[(phase)?phase-1:0]);
+}
+
+// Full (32) passes the intensity straight through, so single lamps come out
+//  exactly as the fade tables have them
+static inline uint8_t mixLevel(uint8_t level, uint8_t intensity)
+{
+	return ((uint16_t)level * intensity) >> 5;
+}
+
+// First order sigma-delta: whatever got rounded off last frame is added in
+//  before rounding this one, so over a few frames the PWM values average
+//  out to the intensity.  Starting from nothing, what's been rounded off
+//  after n frames of the same intensity is n times its low 3 bits, so the
+//  frame count stands in for all three outputs' errors.  A steady 8 bit
+//  intensity never takes more than 8 frames to repeat.
+static uint8_t ditherChannel(uint8_t frame, uint8_t intensity)
+{
+	return (intensity + ((frame * (intensity & 0x07)) & 0x07)) >> 3;
+}
+
+static void intensityToPWM(SignalState_t* sig, uint8_t red, uint8_t yellow, uint8_t green, bool dither)
+{
+	if (!dither)
+	{
+		sig->ditherFrame = 0;
+		sig->redPWM = red >> 3;
+		sig->yellowPWM = yellow >> 3;
+		sig->greenPWM = green >> 3;
+		return;
+	}
+
+	sig->redPWM = ditherChannel(sig->ditherFrame, red);
+	sig->yellowPWM = ditherChannel(sig->ditherFrame, yellow);
+	sig->greenPWM = ditherChannel(sig->ditherFrame, green);
+	sig->ditherFrame = (sig->ditherFrame + 1) & 0x07;
+}
+
+// The start aspect's mix ramps down while the end aspect's ramps up, and an
+//  output both of them use gets some of each.  Mixes share outputs (RGB
+//  yellow and red both have the red LED), so neither side can be dropped.
+static uint8_t mixChannel(uint8_t startLevel, uint8_t downIntensity, uint8_t endLevel, uint8_t upIntensity)
+{
+	uint16_t level = mixLevel(startLevel, downIntensity) + mixLevel(endLevel, upIntensity);
+	return MIN(level, INTENSITY_FULL);
+}
+
+// Same again with a third mix on top, for the red a searchlight passes
+//  through between green and yellow
+static uint8_t mixChannelThrough(uint8_t startLevel, uint8_t downIntensity, uint8_t endLevel, uint8_t upIntensity, uint8_t throughLevel, uint8_t throughIntensity)
+{
+	uint16_t level = mixChannel(startLevel, downIntensity, endLevel, upIntensity) + mixLevel(throughLevel, throughIntensity);
+	return MIN(level, INTENSITY_FULL);
+}
+
+static void mixToPWM(SignalState_t* sig, const ColorMix_t* startMix, uint8_t down, const ColorMix_t* endMix, uint8_t up, bool dither)
+{
+	intensityToPWM(sig,
+		mixChannel(startMix->red, down, endMix->red, up),
+		mixChannel(startMix->yellow, down, endMix->yellow, up),
+		mixChannel(startMix->green, down, endMix->green, up),
+		dither);
+}
+
+#define FADE_PHASES  (sizeof(fadePWMs)/sizeof(fadePWMs[0]))
+
+// Changed again part way through a transition.  Rather than finish the old
+//  one and then start another, start over towards the new aspect from
+//  wherever the outputs are right now, which the aspects and phase already
+//  say.  A fade only ever has one side lit - the start aspect going down for
+//  the first half, the end aspect coming up for the second - and the table
+//  is symmetric, so coming up at phase p is as bright as going down at
+//  FADE_PHASES-1-p.  The first frame after holds where the outputs were.
+static void retarget(SignalState_t* sig, SignalAspect_t aspect, bool searchlightMode)
+{
+	// The phase has already moved on past what's showing
+	uint8_t showing = (sig->phase)?sig->phase-1:0;
+	SignalAspect_t lit;
+	uint8_t down;
+
+	if (searchlightMode && ASPECT_OFF != sig->startAspect && ASPECT_OFF != sig->endAspect)
+	{
+		// A roundel is mostly in front of one color or the other, and swings
+		//  on from there
+		uint8_t phases = (isGreenToYellow(sig->startAspect, sig->endAspect) || isYellowToGreen(sig->startAspect, sig->endAspect))
+			?sizeof(searchlightPWMsThroughRed)/sizeof(searchlightPWMsThroughRed[0])
+			:sizeof(searchlightPWMsInvolvingRed)/sizeof(searchlightPWMsInvolvingRed[0]);
+		if (showing >= phases/2)
+			sig->startAspect = sig->endAspect;
+		sig->endAspect = aspect;
+		sig->phase = 0;
+		return;
+	}
+
+	// How far down the fade out the lit aspect is
+	if (showing < FADE_PHASES/2)
+	{
+		lit = sig->startAspect;
+		down = showing;
+	} else {
+		lit = sig->endAspect;
+		down = FADE_PHASES - 1 - showing;
+	}
+
+	if (lit == aspect)
+	{
+		// Going back, so come up again from the same brightness
+		sig->startAspect = ASPECT_OFF;
+		sig->phase = FADE_PHASES - 1 - down;
+	} else {
+		sig->startAspect = lit;
+		sig->phase = down;
+	}
+	sig->endAspect = aspect;
+}
+
 void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t options)
 {
+	ColorMix_t startMix, endMix;
 	bool searchlightMode = (SIGNAL_OPTION_SEARCHLIGHT & options)?true:false;
+	bool dither = (SIGNAL_OPTION_DITHER & options)?true:false;
 	
 	SignalAspect_t signalAspect = sig->nextAspect;
 	
 	// If it's a flashing aspect, mux the flasher in with the color
-	if (signalAspect == ASPECT_FL_GREEN || signalAspect == ASPECT_FL_YELLOW || signalAspect == ASPECT_FL_RED)
+	if (isFlashing(signalAspect))
 		signalAspect = (flasher)?signalAspect:ASPECT_OFF;
 
 	// If we're not currently running a transition and the aspect changed, start the transitioning
@@ -113,6 +260,12 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 		sig->phase = 0;
 		sig->endAspect = signalAspect;
 	}
+	else if (sig->endAspect != signalAspect)
+	{
+		retarget(sig, signalAspect, searchlightMode);
+		if (!isFlashing(sig->nextAspect))
+			flightLogHead(sig, FLIGHT_RETARGET, signalAspect);
+	}
 
 	if (sig->startAspect != sig->endAspect)
 	{
@@ -143,27 +296,26 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 				//  5:9 - up channel
 				//  10:14 - down channel
 				
+				ColorMix_t redMix;
 				uint16_t pwmWord = pgm_read_word(&searchlightPWMsThroughRed[sig->phase]);
-				uint8_t upPhase = UP_PHASE(pwmWord);
-				uint8_t downPhase = DOWN_PHASE(pwmWord);
-
-				sig->redPWM = RED_PHASE(pwmWord);
-				if (isGreenToYellow(sig->startAspect, sig->endAspect))
-				{
-					sig->greenPWM = downPhase;
-					sig->yellowPWM = upPhase;
-				} else {
-					sig->greenPWM = upPhase;
-					sig->yellowPWM = downPhase;
-				}
+				uint16_t lastWord = lastPhaseWord(searchlightPWMsThroughRed, sig->phase);
+				uint8_t up = phaseIntensity(UP_PHASE(pwmWord), UP_PHASE(lastWord), dither);
+				uint8_t down = phaseIntensity(DOWN_PHASE(pwmWord), DOWN_PHASE(lastWord), dither);
+				uint8_t red = phaseIntensity(RED_PHASE(pwmWord), RED_PHASE(lastWord), dither);
+
+				// Whatever green, yellow and red are on this head
+				aspectToMix(sig->startAspect, options, &startMix);
+				aspectToMix(sig->endAspect, options, &endMix);
+				aspectToMix(ASPECT_RED, options, &redMix);
+				intensityToPWM(sig,
+					mixChannelThrough(startMix.red, down, endMix.red, up, redMix.red, red),
+					mixChannelThrough(startMix.yellow, down, endMix.yellow, up, redMix.yellow, red),
+					mixChannelThrough(startMix.green, down, endMix.green, up, redMix.green, red),
+					dither);
 				
 				sig->phase++;
 				if (sig->phase >= sizeof(searchlightPWMsThroughRed)/sizeof(searchlightPWMsThroughRed[0]))
-				{
-					// We're done
-					sig->phase = 0;
-					sig->startAspect = sig->endAspect;
-				}
+					transitionDone(sig);  // We're done
 			}
 			else
 			{
@@ -171,140 +323,56 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 				// Searchlight changing from yellow or green to red, or red to yellow or green
 				// *****************
 				uint16_t pwmWord = pgm_read_word(&searchlightPWMsInvolvingRed[sig->phase]);
+				uint16_t lastWord = lastPhaseWord(searchlightPWMsInvolvingRed, sig->phase);
 				
-				uint8_t upPhase = UP_PHASE(pwmWord);
-				uint8_t downPhase = DOWN_PHASE(pwmWord);
+				uint8_t up = phaseIntensity(UP_PHASE(pwmWord), UP_PHASE(lastWord), dither);
+				uint8_t down = phaseIntensity(DOWN_PHASE(pwmWord), DOWN_PHASE(lastWord), dither);
 
-				sig->redPWM = sig->yellowPWM = sig->greenPWM = 0;
-
-				switch(sig->startAspect)
-				{
-					case ASPECT_RED:
-					case ASPECT_FL_RED:
-						sig->redPWM = downPhase;
-						break;
-
-					case ASPECT_YELLOW:
-					case ASPECT_FL_YELLOW:
-						sig->yellowPWM = downPhase;
-						break;
-
-					case ASPECT_GREEN:
-					case ASPECT_FL_GREEN:
-						sig->greenPWM = downPhase;
-						break;
-
-					default:
-						break;
-				}
-
-				switch(sig->endAspect)
-				{
-					case ASPECT_RED:
-					case ASPECT_FL_RED:
-						sig->redPWM = upPhase;
-						break;
-
-					case ASPECT_YELLOW:
-					case ASPECT_FL_YELLOW:
-						sig->yellowPWM = upPhase;
-						break;
-
-					case ASPECT_GREEN:
-					case ASPECT_FL_GREEN:
-						sig->greenPWM = upPhase;
-						break;
-
-					default:
-						break;
-				}
+				aspectToMix(sig->startAspect, options, &startMix);
+				aspectToMix(sig->endAspect, options, &endMix);
+				mixToPWM(sig, &startMix, down, &endMix, up, dither);
 
 				sig->phase++;
 				if (sig->phase >= sizeof(searchlightPWMsInvolvingRed)/sizeof(searchlightPWMsInvolvingRed[0]))
-				{
-					// We're done
-					sig->phase = 0;
-					sig->startAspect = sig->endAspect;
-				}
+					transitionDone(sig);  // We're done
 			}
 			
 		} else {
 			uint16_t pwmWord = pgm_read_word(&fadePWMs[sig->phase]);
+			uint16_t lastWord;
 			uint8_t upPhase = UP_PHASE(pwmWord);
 			uint8_t downPhase = DOWN_PHASE(pwmWord);
 
-			sig->redPWM = sig->yellowPWM = sig->greenPWM = 0;
-			
-			switch(sig->startAspect)
+			// If we're going from off to on, go find the first entry
+			// where the upPhase is not zero and start from there
+			if (ASPECT_OFF == sig->startAspect && 0 == upPhase)
 			{
-				case ASPECT_RED:
-				case ASPECT_FL_RED:
-					sig->redPWM = downPhase;
-					break;
-
-				case ASPECT_YELLOW:
-				case ASPECT_FL_YELLOW:
-					sig->yellowPWM = downPhase;
-					break;
-
-				case ASPECT_GREEN:
-				case ASPECT_FL_GREEN:
-					sig->greenPWM = downPhase;
-					break;
-
-				case ASPECT_OFF:
-					// If we're going from off to on, go find the first entry
-					// where the upPhase is not zero and start from there
-					if (0 == upPhase)
-					{
-						do
-						{
-							pwmWord = pgm_read_word(&fadePWMs[++sig->phase]);
-							upPhase = UP_PHASE(pwmWord);
-						} while (upPhase == 0 && sig->phase < sizeof(fadePWMs)/sizeof(fadePWMs[0]));
-						sig->phase--;
-					}
-
-				default:
-					break;
+				do
+				{
+					pwmWord = pgm_read_word(&fadePWMs[++sig->phase]);
+					upPhase = UP_PHASE(pwmWord);
+				} while (upPhase == 0 && sig->phase < sizeof(fadePWMs)/sizeof(fadePWMs[0]));
+				sig->phase--;
 			}
 
-			switch(sig->endAspect)
-			{
-				case ASPECT_RED:
-				case ASPECT_FL_RED:
-					sig->redPWM = upPhase;
-					break;
-
-				case ASPECT_YELLOW:
-				case ASPECT_FL_YELLOW:
-					sig->yellowPWM = upPhase;
-					break;
-
-				case ASPECT_GREEN:
-				case ASPECT_FL_GREEN:
-					sig->greenPWM = upPhase;
-					break;
-
-				case ASPECT_OFF:
-					// If we're going from something to off, we're done when we get the 
-					//  lamp completely off
-					if (downPhase == 0)
-						sig->phase = sizeof(fadePWMs)/sizeof(fadePWMs[0]);
-
-					break;
-
-				default:
-					break;
-			}
+			// Coming on from off starts at the first lit entry, the same as
+			//  phase 0 does
+			lastWord = lastPhaseWord(fadePWMs, sig->phase);
+			if (ASPECT_OFF == sig->startAspect && 0 == UP_PHASE(lastWord))
+				lastWord = pwmWord;
+			aspectToMix(sig->startAspect, options, &startMix);
+			aspectToMix(sig->endAspect, options, &endMix);
+			mixToPWM(sig, &startMix, phaseIntensity(downPhase, DOWN_PHASE(lastWord), dither),
+				&endMix, phaseIntensity(upPhase, UP_PHASE(lastWord), dither), dither);
+
+			// If we're going from something to off, we're done when we get the 
+			//  lamp completely off
+			if (ASPECT_OFF == sig->endAspect && downPhase == 0)
+				sig->phase = sizeof(fadePWMs)/sizeof(fadePWMs[0]);
 
 			sig->phase++;
 			if (sig->phase >= sizeof(fadePWMs)/sizeof(fadePWMs[0]))
-			{
-				// We're done
-				sig->phase = 0;
-				sig->startAspect = sig->endAspect;
-			}
+				transitionDone(sig);  // We're done
 		}
 
 /*				
@@ -367,27 +435,9 @@ void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t
 	} else {
 		// We're at steady state and the signal isn't changing, so 
 		// just set the PWM based on the aspect for safety
-		sig->redPWM = sig->yellowPWM = sig->greenPWM = 0;
-		switch(sig->startAspect)
-		{
-			case ASPECT_RED:
-			case ASPECT_FL_RED:
-				sig->redPWM = 0x1F;
-				break;
-
-			case ASPECT_YELLOW:
-			case ASPECT_FL_YELLOW:
-				sig->yellowPWM = 0x1F;
-				break;
-
-			case ASPECT_GREEN:
-			case ASPECT_FL_GREEN:
-				sig->greenPWM = 0x1F;
-				break;
-
-			default:
-				break;
-		}
+		aspectToMix(sig->startAspect, options, &endMix);
+		intensityToPWM(sig, mixLevel(endMix.red, INTENSITY_FULL), mixLevel(endMix.yellow, INTENSITY_FULL),
+			mixLevel(endMix.green, INTENSITY_FULL), dither);
 	}
 }
 
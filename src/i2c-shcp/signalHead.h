@@ -36,21 +36,29 @@ typedef struct
 	uint8_t redPWM;
 	uint8_t yellowPWM;
 	uint8_t greenPWM;
+	// Dithered heads carry what got rounded off each frame into the next,
+	//  which only takes counting frames, see ditherChannel()
+	uint8_t ditherFrame;
 } SignalState_t;
 
 #define SIGNAL_OPTION_COMMON_ANODE         0x01
 #define SIGNAL_OPTION_SEARCHLIGHT          0x02
+// Which colorMix.h table the head's aspects come from
+#define SIGNAL_OPTION_MIX(m)               (((m) & 0x03)<<2)
+#define SIGNAL_OPTION_MIX_SET(o)           (((o)>>2) & 0x03)
+// Sigma-delta dither between adjacent PWM values for 8 bit intensities
+#define SIGNAL_OPTION_DITHER               0x10
+// The head's flash config (flasher.h) rides along in the top three bits,
+//  which saves the tiny48 a byte a head
+#define SIGNAL_OPTION_FLASH(f)             (((f) & 0x07)<<5)
+#define SIGNAL_OPTION_FLASH_CONFIG(o)      (((o)>>5) & 0x07)
 
-#define SIGNAL_HEAD_INIT_STATE {ASPECT_OFF, ASPECT_OFF, 0, 0, 0, 0}
+#define SIGNAL_HEAD_INIT_STATE {ASPECT_OFF, ASPECT_OFF, ASPECT_OFF, 0, 0, 0, 0, 0}
 
 void signalHeadInitialize(SignalState_t* sig);
 void signalHeadAspectSet(SignalState_t* sig, SignalAspect_t aspect);
 SignalAspect_t signalHeadAspectGet(SignalState_t* sig);
 
-void signalHeadISR_OutputPWM(SignalState_t* const sig, const uint8_t options, const uint8_t pwmPhase, 
-	volatile uint8_t* const redPort, const uint8_t redMask, volatile uint8_t* const yellowPort, 
-	const uint8_t yellowMask, volatile uint8_t* const greenPort, const uint8_t greenMask);
-
 void signalHeadISR_AspectToNextPWM(SignalState_t* sig, uint8_t flasher, uint8_t options);
 
 #endif
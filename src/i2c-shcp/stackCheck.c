@@ -0,0 +1,62 @@
+/*************************************************************************
+Title:    I2C-SHCP Stack High-Water Mark
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     stackCheck.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <avr/io.h>
+#include "stackCheck.h"
+
+// Provided by the linker - first byte after .bss/.noinit, and the top of RAM
+extern uint8_t _end;
+extern uint8_t __stack;
+
+// Runs from .init1, before the stack pointer and r1 are set up, so it has to
+//  be plain assembly that touches nothing but its own registers
+void stackPaint(void) __attribute__ ((naked, used, section (".init1")));
+void stackPaint(void)
+{
+	__asm volatile (
+		"    ldi r30, lo8(_end)     \n"
+		"    ldi r31, hi8(_end)     \n"
+		"    ldi r24, %0            \n"
+		"    ldi r25, hi8(__stack)  \n"
+		"    rjmp 2f                \n"
+		"1:  st Z+, r24             \n"
+		"2:  cpi r30, lo8(__stack)  \n"
+		"    cpc r31, r25           \n"
+		"    brlo 1b                \n"
+		"    breq 1b                \n"
+		:: "M" (STACK_CANARY));
+}
+
+uint16_t stackFreeBytes(void)
+{
+	const uint8_t* p = &_end;
+
+	while (p <= &__stack && STACK_CANARY == *p)
+		p++;
+
+	return p - &_end;
+}
+
+uint16_t stackUsedBytes(void)
+{
+	return (&__stack - &_end + 1) - stackFreeBytes();
+}
@@ -0,0 +1,39 @@
+/*************************************************************************
+Title:    I2C-SHCP Stack High-Water Mark
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     stackCheck.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _STACK_CHECK_H_
+#define _STACK_CHECK_H_
+
+#include <stdint.h>
+
+/* Everything between the end of .bss and the top of RAM gets filled with
+   STACK_CANARY before main() runs.  The stack only ever grows down into that
+   space, so however much of it still holds the canary has never been used.
+   Not exact - a pushed byte that happens to equal the canary looks unused -
+   but close enough to know how much room is left. */
+
+#define STACK_CANARY 0xC5
+
+uint16_t stackFreeBytes(void);
+uint16_t stackUsedBytes(void);
+
+#endif
@@ -0,0 +1,510 @@
+/*************************************************************************
+Title:    MSS Cascade Simulator
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     mss-cascade-sim.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "mssPort.h"
+
+#define LOOP_UPDATE_TIME_MS   50
+#define MAX_CYCLES         10000
+#define MAX_OCCUPIED          64
+
+#define PORT_A  0
+#define PORT_B  1
+#define PORT_C  2
+#define PORT_D  3
+#define PORTS_PER_BOARD 4
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+typedef enum
+{
+	TOPOLOGY_LINE,
+	TOPOLOGY_DOUBLE,
+	TOPOLOGY_LOOP,
+	TOPOLOGY_FILE
+} Topology_t;
+
+// Every board is a virtual XCade with ports A-D.  Ports are kept in one flat
+//  array (board * PORTS_PER_BOARD + port) so cable peers are just indices.
+uint32_t numBoards = 0;
+uint32_t numLinks = 0;
+MSSPort_t* ports = NULL;
+bool* occupied = NULL;
+
+// Per-port bookkeeping for propagation measurements
+MSSPortIndication_t* lastIndication = NULL;
+uint32_t* changedCycle = NULL;
+
+uint32_t loopPeriodMs = LOOP_UPDATE_TIME_MS;
+uint32_t maxCycles = MAX_CYCLES;
+uint32_t verboseLimit = 0;
+
+static const char portNames[PORTS_PER_BOARD] = {'A', 'B', 'C', 'D'};
+
+void usage(const char* progName)
+{
+	printf("Usage: %s [options]\n", progName);
+	printf("  -t <type>    topology: line, double, loop or file (default line)\n");
+	printf("  -n <boards>  number of boards for generated topologies (default 1000)\n");
+	printf("  -f <file>    topology file, one \"<board>.<port> <board>.<port>\" link per line\n");
+	printf("  -o <board>   occupy this board (repeatable, default is the last board)\n");
+	printf("  -p <ms>      loop period in ms (default %d)\n", LOOP_UPDATE_TIME_MS);
+	printf("  -c <cycles>  give up settling after this many cycles (default %d)\n", MAX_CYCLES);
+	printf("  -b <cycles>  run a throughput benchmark for this many cycles\n");
+	printf("  -v <ports>   list up to this many changed ports in propagation order\n");
+}
+
+bool allocateBoards(uint32_t boards)
+{
+	numBoards = boards;
+	ports = calloc(numBoards * PORTS_PER_BOARD, sizeof(MSSPort_t));
+	occupied = calloc(numBoards, sizeof(bool));
+	lastIndication = calloc(numBoards * PORTS_PER_BOARD, sizeof(MSSPortIndication_t));
+	changedCycle = calloc(numBoards * PORTS_PER_BOARD, sizeof(uint32_t));
+
+	if (NULL == ports || NULL == occupied || NULL == lastIndication || NULL == changedCycle)
+		return false;
+
+	for(uint32_t i=0; i<numBoards * PORTS_PER_BOARD; i++)
+	{
+		mssPortInitialize(&ports[i]);
+		lastIndication[i] = INDICATION_CLEAR;
+	}
+	return true;
+}
+
+bool connectPorts(uint32_t boardA, uint8_t portA, uint32_t boardB, uint8_t portB)
+{
+	uint32_t a = boardA * PORTS_PER_BOARD + portA;
+	uint32_t b = boardB * PORTS_PER_BOARD + portB;
+
+	if (boardA >= numBoards || boardB >= numBoards || a == b)
+		return false;
+	if (ports[a].peer >= 0 || ports[b].peer >= 0)
+		return false;
+
+	ports[a].peer = b;
+	ports[b].peer = a;
+	numLinks++;
+	return true;
+}
+
+bool buildGenerated(Topology_t topology, uint32_t boards)
+{
+	if (!allocateBoards(boards))
+		return false;
+
+	// Blocks are chained B -> A, so traffic "eastbound" moves up in board number
+	//  The double track case runs a second, independent main on C -> D
+	for(uint32_t i=0; i+1<numBoards; i++)
+	{
+		connectPorts(i, PORT_B, i+1, PORT_A);
+		if (TOPOLOGY_DOUBLE == topology)
+			connectPorts(i, PORT_D, i+1, PORT_C);
+	}
+
+	if (TOPOLOGY_LOOP == topology && numBoards > 2)
+		connectPorts(numBoards-1, PORT_B, 0, PORT_A);
+
+	return true;
+}
+
+int8_t parsePort(char c)
+{
+	switch(c)
+	{
+		case 'A': case 'a': return PORT_A;
+		case 'B': case 'b': return PORT_B;
+		case 'C': case 'c': return PORT_C;
+		case 'D': case 'd': return PORT_D;
+		default:            return -1;
+	}
+}
+
+bool buildFromFile(const char* filename)
+{
+	FILE* f = fopen(filename, "r");
+	char line[128];
+	uint32_t maxBoard = 0;
+	uint32_t lineNum;
+
+	if (NULL == f)
+	{
+		perror(filename);
+		return false;
+	}
+
+	// Two passes - first to size the layout, second to wire it
+	for(int pass=0; pass<2; pass++)
+	{
+		rewind(f);
+		lineNum = 0;
+		while(fgets(line, sizeof(line), f))
+		{
+			uint32_t boardA, boardB;
+			char portA, portB;
+			lineNum++;
+
+			if ('#' == line[0] || '\n' == line[0] || '\r' == line[0])
+				continue;
+
+			if (4 != sscanf(line, "%u.%c %u.%c", &boardA, &portA, &boardB, &portB)
+				|| parsePort(portA) < 0 || parsePort(portB) < 0)
+			{
+				fprintf(stderr, "%s:%u: can't parse link\n", filename, lineNum);
+				fclose(f);
+				return false;
+			}
+
+			if (0 == pass)
+				maxBoard = MAX(maxBoard, MAX(boardA, boardB));
+			else if (!connectPorts(boardA, parsePort(portA), boardB, parsePort(portB)))
+			{
+				fprintf(stderr, "%s:%u: port already connected\n", filename, lineNum);
+				fclose(f);
+				return false;
+			}
+		}
+
+		if (0 == pass && !allocateBoards(maxBoard + 1))
+		{
+			fclose(f);
+			return false;
+		}
+	}
+
+	fclose(f);
+	return true;
+}
+
+void boardLogic(uint32_t board)
+{
+	MSSPort_t* p = &ports[board * PORTS_PER_BOARD];
+	bool occ = occupied[board];
+
+	// Same thing a sketch does for a simple cascade - each through route
+	//  (A-B and C-D) passes what it hears on one end back out the other
+	MSSPortIndication_t indA = mssPortIndicationReceivedGet(&p[PORT_A]);
+	MSSPortIndication_t indB = mssPortIndicationReceivedGet(&p[PORT_B]);
+	MSSPortIndication_t indC = mssPortIndicationReceivedGet(&p[PORT_C]);
+	MSSPortIndication_t indD = mssPortIndicationReceivedGet(&p[PORT_D]);
+
+	for(uint8_t i=0; i<PORTS_PER_BOARD; i++)
+		mssPortSetLocalOccupancy(&p[i], occ);
+
+	mssPortCascadeFromIndication(&p[PORT_A], indB, false);
+	mssPortCascadeFromIndication(&p[PORT_B], indA, false);
+	mssPortCascadeFromIndication(&p[PORT_C], indD, false);
+	mssPortCascadeFromIndication(&p[PORT_D], indC, false);
+}
+
+// Runs one loop period on every board.  Returns true if nothing is still
+//  in motion, meaning every following cycle would be identical.
+bool simulateCycle(uint32_t cycle)
+{
+	uint32_t totalPorts = numBoards * PORTS_PER_BOARD;
+	bool stable = true;
+
+	// updateInputs() - everybody samples the cable before anybody updates outputs
+	for(uint32_t i=0; i<totalPorts; i++)
+	{
+		uint8_t raw = ports[i].outputs & MSS_LINE_S;
+		if (ports[i].peer >= 0)
+			raw |= ports[ports[i].peer].outputs;
+		ports[i].rawInputs = raw;
+	}
+
+	for(uint32_t i=0; i<totalPorts; i++)
+	{
+		MSSPortIndication_t indication;
+
+		mssPortUpdateInputs(&ports[i]);
+		if (ports[i].rawInputs != getDebouncedState(&ports[i].inputs))
+			stable = false;
+
+		indication = mssPortIndicationReceivedGet(&ports[i]);
+		if (indication != lastIndication[i])
+		{
+			lastIndication[i] = indication;
+			changedCycle[i] = cycle;
+			stable = false;
+		}
+	}
+
+	// Cascade logic and updateOutputs()
+	for(uint32_t b=0; b<numBoards; b++)
+	{
+		MSSPort_t* p = &ports[b * PORTS_PER_BOARD];
+		uint8_t before[PORTS_PER_BOARD];
+
+		for(uint8_t i=0; i<PORTS_PER_BOARD; i++)
+			before[i] = p[i].outputs;
+
+		boardLogic(b);
+
+		for(uint8_t i=0; i<PORTS_PER_BOARD; i++)
+		{
+			if (before[i] != p[i].outputs)
+				stable = false;
+		}
+	}
+
+	return stable;
+}
+
+int compareChangedCycle(const void* a, const void* b)
+{
+	uint32_t ca = changedCycle[*(const uint32_t*)a];
+	uint32_t cb = changedCycle[*(const uint32_t*)b];
+	return (ca > cb) - (ca < cb);
+}
+
+void runToSettle(const char* label)
+{
+	uint32_t totalPorts = numBoards * PORTS_PER_BOARD;
+	uint32_t firstCycle[INDICATION_END], lastCycle[INDICATION_END], count[INDICATION_END];
+	uint32_t changed = 0;
+	uint32_t cycle;
+	bool stable = false;
+
+	for(uint32_t i=0; i<totalPorts; i++)
+		changedCycle[i] = 0;
+
+	for(cycle=1; cycle<=maxCycles && !stable; cycle++)
+		stable = simulateCycle(cycle);
+	cycle--;
+
+	printf("\n%s\n", label);
+	if (!stable)
+		printf("  Did not settle within %u cycles\n", maxCycles);
+	else
+		printf("  Settled after %u cycles (%u ms)\n", cycle, cycle * loopPeriodMs);
+
+	for(uint8_t ind=0; ind<INDICATION_END; ind++)
+	{
+		firstCycle[ind] = UINT32_MAX;
+		lastCycle[ind] = count[ind] = 0;
+	}
+
+	for(uint32_t i=0; i<totalPorts; i++)
+	{
+		if (0 == changedCycle[i])
+			continue;
+		changed++;
+		count[lastIndication[i]]++;
+		firstCycle[lastIndication[i]] = MIN(firstCycle[lastIndication[i]], changedCycle[i]);
+		lastCycle[lastIndication[i]] = MAX(lastCycle[lastIndication[i]], changedCycle[i]);
+	}
+
+	printf("  %-20s %8s %10s %10s %10s %10s\n", "Now receiving", "Ports", "First cyc", "First ms", "Last cyc", "Last ms");
+	for(uint8_t ind=0; ind<INDICATION_END; ind++)
+	{
+		if (0 == count[ind])
+			continue;
+		printf("  %-20s %8u %10u %10u %10u %10u\n", mssPortIndicationName(ind), count[ind],
+			firstCycle[ind], firstCycle[ind] * loopPeriodMs, lastCycle[ind], lastCycle[ind] * loopPeriodMs);
+	}
+
+	if (verboseLimit && changed)
+	{
+		uint32_t* order = malloc(changed * sizeof(uint32_t));
+		uint32_t n = 0;
+
+		if (NULL == order)
+			return;
+
+		for(uint32_t i=0; i<totalPorts; i++)
+			if (changedCycle[i])
+				order[n++] = i;
+		qsort(order, n, sizeof(uint32_t), compareChangedCycle);
+
+		for(uint32_t i=0; i<MIN(n, verboseLimit); i++)
+			printf("    %6u.%c  %-20s cycle %5u  %6u ms\n", order[i] / PORTS_PER_BOARD, portNames[order[i] % PORTS_PER_BOARD],
+				mssPortIndicationName(lastIndication[order[i]]), changedCycle[order[i]], changedCycle[order[i]] * loopPeriodMs);
+		free(order);
+	}
+}
+
+double monotonicSeconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void runBenchmark(uint32_t cycles)
+{
+	uint32_t rng = 0x2545F491;
+	uint32_t togglesPerCycle = numBoards / 100 + 1;
+	double start, elapsed;
+
+	start = monotonicSeconds();
+	for(uint32_t cycle=1; cycle<=cycles; cycle++)
+	{
+		// Keep trains moving around so the cascade never goes quiet
+		for(uint32_t i=0; i<togglesPerCycle; i++)
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 17;
+			rng ^= rng << 5;
+			occupied[rng % numBoards] ^= true;
+		}
+		simulateCycle(cycle);
+	}
+	elapsed = monotonicSeconds() - start;
+
+	printf("\nThroughput (%u cycles, %u occupancy changes/cycle)\n", cycles, togglesPerCycle);
+	printf("  Wall time          %10.3f s\n", elapsed);
+	printf("  Cycles/s           %10.0f\n", cycles / elapsed);
+	printf("  Board updates/s    %10.0f\n", (double)cycles * numBoards / elapsed);
+	printf("  ns/board update    %10.1f\n", elapsed * 1e9 / ((double)cycles * numBoards));
+	printf("  Realtime factor    %10.1fx at %u ms/cycle\n", (cycles * loopPeriodMs / 1000.0) / elapsed, loopPeriodMs);
+}
+
+int main(int argc, char** argv)
+{
+	Topology_t topology = TOPOLOGY_LINE;
+	const char* topologyName = "line";
+	const char* topologyFile = NULL;
+	uint32_t boards = 1000;
+	uint32_t occupiedList[MAX_OCCUPIED];
+	uint32_t numOccupied = 0;
+	uint32_t benchCycles = 0;
+	char label[64];
+	int opt;
+
+	while(-1 != (opt = getopt(argc, argv, "t:n:f:o:p:c:b:v:h")))
+	{
+		switch(opt)
+		{
+			case 't':
+				topologyName = optarg;
+				if (0 == strcmp(optarg, "line"))
+					topology = TOPOLOGY_LINE;
+				else if (0 == strcmp(optarg, "double"))
+					topology = TOPOLOGY_DOUBLE;
+				else if (0 == strcmp(optarg, "loop"))
+					topology = TOPOLOGY_LOOP;
+				else if (0 == strcmp(optarg, "file"))
+					topology = TOPOLOGY_FILE;
+				else
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'n':
+				boards = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'f':
+				topologyFile = optarg;
+				topology = TOPOLOGY_FILE;
+				topologyName = "file";
+				break;
+
+			case 'o':
+				if (numOccupied < MAX_OCCUPIED)
+					occupiedList[numOccupied++] = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'p':
+				loopPeriodMs = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'c':
+				maxCycles = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'b':
+				benchCycles = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'v':
+				verboseLimit = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'h':
+			default:
+				usage(argv[0]);
+				return ('h' == opt)?0:1;
+		}
+	}
+
+	if (TOPOLOGY_FILE == topology)
+	{
+		if (NULL == topologyFile)
+		{
+			fprintf(stderr, "File topology needs -f <file>\n");
+			return 1;
+		}
+		if (!buildFromFile(topologyFile))
+			return 1;
+	}
+	else if (boards < 1 || !buildGenerated(topology, boards))
+	{
+		fprintf(stderr, "Can't build %u boards\n", boards);
+		return 1;
+	}
+
+	if (0 == numOccupied)
+		occupiedList[numOccupied++] = numBoards - 1;
+
+	printf("Topology: %s, %u boards, %u links, %u ms loop\n", topologyName, numBoards, numLinks, loopPeriodMs);
+
+	runToSettle("Power-up");
+
+	for(uint32_t i=0; i<numOccupied; i++)
+	{
+		if (occupiedList[i] >= numBoards)
+		{
+			fprintf(stderr, "Board %u doesn't exist\n", occupiedList[i]);
+			return 1;
+		}
+		occupied[occupiedList[i]] = true;
+	}
+	snprintf(label, sizeof(label), "Occupy %u board%s", numOccupied, (1 == numOccupied)?"":"s");
+	runToSettle(label);
+
+	for(uint32_t i=0; i<numOccupied; i++)
+		occupied[occupiedList[i]] = false;
+	snprintf(label, sizeof(label), "Clear %u board%s", numOccupied, (1 == numOccupied)?"":"s");
+	runToSettle(label);
+
+	if (benchCycles)
+		runBenchmark(benchCycles);
+
+	free(ports);
+	free(occupied);
+	free(lastIndication);
+	free(changedCycle);
+	return 0;
+}
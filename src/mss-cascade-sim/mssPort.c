@@ -0,0 +1,104 @@
+/*************************************************************************
+Title:    MSS Port Model (host simulation)
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     mssPort.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include "mssPort.h"
+
+void mssPortInitialize(MSSPort_t* port)
+{
+	port->outputs = 0;
+	port->rawInputs = 0;
+	port->peer = -1;
+	initDebounceState8(&port->inputs, 0);
+}
+
+void mssPortSetLocalOccupancy(MSSPort_t* port, bool occupied)
+{
+	if (occupied)
+		port->outputs |= MSS_LINE_S;
+	else
+		port->outputs &= ~MSS_LINE_S;
+}
+
+void mssPortCascadeFromIndication(MSSPort_t* port, MSSPortIndication_t indication, bool diverging)
+{
+	// What we tell the block behind us is one step less restrictive than
+	//  what we're being told by the block ahead of us
+	uint8_t outputs = port->outputs & MSS_LINE_S;
+
+	switch(indication)
+	{
+		case INDICATION_STOP:
+			outputs |= MSS_LINE_A;
+			break;
+
+		case INDICATION_APPROACH:
+			outputs |= MSS_LINE_AA;
+			break;
+
+		default:
+			break;
+	}
+
+	if (diverging)
+		outputs |= MSS_LINE_DA;
+
+	port->outputs = outputs;
+}
+
+void mssPortUpdateInputs(MSSPort_t* port)
+{
+	debounce8(port->rawInputs, &port->inputs);
+}
+
+MSSPortIndication_t mssPortIndicationReceivedGet(MSSPort_t* port)
+{
+	uint8_t lines = getDebouncedState(&port->inputs);
+
+	if (lines & MSS_LINE_S)
+		return INDICATION_STOP;
+	if (lines & MSS_LINE_A)
+		return INDICATION_APPROACH;
+	if (lines & MSS_LINE_AA)
+		return INDICATION_ADVANCE_APPROACH;
+	if (lines & MSS_LINE_DA)
+		return INDICATION_APPROACH_DIVERGING;
+	return INDICATION_CLEAR;
+}
+
+const char* mssPortIndicationName(MSSPortIndication_t indication)
+{
+	switch(indication)
+	{
+		case INDICATION_STOP:
+			return "STOP";
+		case INDICATION_APPROACH:
+			return "APPROACH";
+		case INDICATION_ADVANCE_APPROACH:
+			return "ADVANCE_APPROACH";
+		case INDICATION_APPROACH_DIVERGING:
+			return "APPROACH_DIVERGING";
+		case INDICATION_CLEAR:
+			return "CLEAR";
+		default:
+			return "???";
+	}
+}
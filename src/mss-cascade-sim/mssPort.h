@@ -0,0 +1,63 @@
+/*************************************************************************
+Title:    MSS Port Model (host simulation)
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     mssPort.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _MSSPORT_H_
+#define _MSSPORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "debouncer.h"
+
+// Lines on an MSS cable, as seen from one port
+//  S is shared by both ends (either end being occupied pulls it)
+//  A, AA and DA are driven by one end and received by the other
+#define MSS_LINE_S    0x01
+#define MSS_LINE_A    0x02
+#define MSS_LINE_AA   0x04
+#define MSS_LINE_DA   0x08
+
+typedef enum
+{
+	INDICATION_STOP               = 0,
+	INDICATION_APPROACH           = 1,
+	INDICATION_ADVANCE_APPROACH   = 2,
+	INDICATION_APPROACH_DIVERGING = 3,
+	INDICATION_CLEAR              = 4,
+	INDICATION_END
+} MSSPortIndication_t;
+
+typedef struct
+{
+	uint8_t outputs;           // MSS_LINE_* bits this port is driving
+	uint8_t rawInputs;         // MSS_LINE_* bits sampled off the cable this cycle
+	DebounceState8_t inputs;   // Same debounce the hardware uses, one sample per loop
+	int32_t peer;              // Global index of the port on the other end, -1 if unconnected
+} MSSPort_t;
+
+void mssPortInitialize(MSSPort_t* port);
+void mssPortSetLocalOccupancy(MSSPort_t* port, bool occupied);
+void mssPortCascadeFromIndication(MSSPort_t* port, MSSPortIndication_t indication, bool diverging);
+void mssPortUpdateInputs(MSSPort_t* port);
+MSSPortIndication_t mssPortIndicationReceivedGet(MSSPort_t* port);
+const char* mssPortIndicationName(MSSPortIndication_t indication);
+
+#endif
@@ -0,0 +1,190 @@
+/*************************************************************************
+Title:    Aspect Latency Probe
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     latencyProbe.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "latencyProbe.h"
+
+static LatencyStat_t latencyStats[SHCP_NUM_HEADS][LATENCY_STAGE_END];
+static const char* const stageNames[LATENCY_STAGE_END] = { "loop", "poll", "frame", "total" };
+
+static XCadeLink* probeLink = NULL;
+static bool probeActive = false;
+static bool probePending = false;
+static uint8_t probeControl = 0;
+static uint8_t probeAspect = 0;
+static uint8_t probeSeq = 0;
+static uint32_t probeSetUs = 0;
+static uint32_t probeWrittenUs = 0;
+static uint32_t probeTimeouts = 0;
+static uint32_t probeBusErrors = 0;
+
+static void latencyRecord(LatencyStat_t* stat, int32_t us)
+{
+	// Frame quantization can push a stage a hair negative
+	uint32_t v = (us < 0)?0:us;
+	stat->count++;
+	stat->totalUs += v;
+	stat->minUs = min(stat->minUs, v);
+	stat->maxUs = max(stat->maxUs, v);
+}
+
+void latencyProbeBegin(XCadeLink* link)
+{
+	probeLink = link;
+	memset(latencyStats, 0, sizeof(latencyStats));
+	for (uint8_t h=0; h<SHCP_NUM_HEADS; h++)
+		for (uint8_t s=0; s<LATENCY_STAGE_END; s++)
+			latencyStats[h][s].minUs = UINT32_MAX;
+	probeActive = probePending = false;
+	probeTimeouts = probeBusErrors = 0;
+}
+
+// Call right after setAspect() on the head being probed.  Only one probe is
+//  in flight at a time, so this returns false if one is still outstanding.
+bool latencyProbeAspectSet(uint8_t head, uint8_t aspect, uint32_t nowUs)
+{
+	if (probeActive)
+		return false;
+
+	// Sequence runs 1-31 so the control byte is never zero
+	probeSeq = (probeSeq % 31) + 1;
+	probeControl = (probeSeq << SHCP_PROBE_SEQ_SHIFT) | (head & SHCP_PROBE_HEAD_MASK);
+	probeAspect = aspect;
+
+	probeSetUs = nowUs;
+	probeWrittenUs = 0;
+	probeActive = probePending = true;
+	return true;
+}
+
+// Call right before updateOutputs().  The tag has to reach the SHCP in the
+//  same write as the aspect, or its register poll can pick up one without
+//  the other.  The head's aspect register and PROBE_CONTROL aren't next to
+//  each other, so everything in between is read and written back as it is,
+//  and then read again to check it landed.  The library writes the same
+//  aspect again right after, which changes nothing.
+void latencyProbeSend()
+{
+	uint8_t head = probeControl & SHCP_PROBE_HEAD_MASK;
+	uint8_t regs[SHCP_REG_PROBE_CONTROL - SHCP_REG_ASPECTS_BASE + 1];
+	uint8_t check[sizeof(regs)];
+	uint8_t len = SHCP_REG_PROBE_CONTROL - (SHCP_REG_ASPECTS_BASE + head) + 1;
+
+	if (!probePending)
+		return;
+	probePending = false;
+
+	// One session, so the mux only moves once
+	if (XCADE_LINK_OK != probeLink->open())
+	{
+		probeBusErrors++;
+		probeActive = false;
+		return;
+	}
+	if (XCADE_LINK_OK == probeLink->read(SHCP_REG_ASPECTS_BASE + head, regs, len))
+	{
+		regs[0] = probeAspect;
+		regs[len - 1] = probeControl;
+		if (XCADE_LINK_OK == probeLink->write(SHCP_REG_ASPECTS_BASE + head, regs, len))
+		{
+			probeWrittenUs = micros();
+			if (XCADE_LINK_OK != probeLink->read(SHCP_REG_ASPECTS_BASE + head, check, len)
+				|| 0 != memcmp(regs, check, len))
+				probeWrittenUs = 0;
+		}
+	}
+	probeLink->close();
+
+	if (0 == probeWrittenUs)
+	{
+		probeBusErrors++;
+		probeActive = false;
+	}
+}
+
+void latencyProbePoll(uint32_t nowUs)
+{
+	uint8_t regs[SHCP_REG_FRAME_COUNTER - SHCP_REG_PROBE_LATCHED + 1];
+	uint32_t readUs;
+	uint32_t latchUs, outputUs;
+	LatencyStat_t* stats;
+
+	if (!probeActive || 0 == probeWrittenUs)
+		return;
+
+	if (((uint32_t)nowUs - probeSetUs) > LATENCY_PROBE_TIMEOUT_US)
+	{
+		probeTimeouts++;
+		probeActive = false;
+		return;
+	}
+
+	if (XCADE_LINK_OK != probeLink->read(SHCP_REG_PROBE_LATCHED, regs, sizeof(regs)))
+	{
+		probeBusErrors++;
+		return;
+	}
+	readUs = micros();
+
+	if (regs[SHCP_REG_PROBE_OUTPUT - SHCP_REG_PROBE_LATCHED] != probeControl
+		|| regs[0] != probeControl)
+		return;
+
+	// Walk back from the SHCP's current frame to when each event happened
+	latchUs = readUs - (uint8_t)(regs[SHCP_REG_FRAME_COUNTER - SHCP_REG_PROBE_LATCHED]
+		- regs[SHCP_REG_PROBE_LATCH_FRAME - SHCP_REG_PROBE_LATCHED]) * SHCP_FRAME_US;
+	outputUs = readUs - (uint8_t)(regs[SHCP_REG_FRAME_COUNTER - SHCP_REG_PROBE_LATCHED]
+		- regs[SHCP_REG_PROBE_OUTPUT_FRAME - SHCP_REG_PROBE_LATCHED]) * SHCP_FRAME_US;
+
+	stats = latencyStats[probeControl & SHCP_PROBE_HEAD_MASK];
+	latencyRecord(&stats[LATENCY_STAGE_LOOP], probeWrittenUs - probeSetUs);
+	latencyRecord(&stats[LATENCY_STAGE_POLL], (int32_t)(latchUs - probeWrittenUs));
+	latencyRecord(&stats[LATENCY_STAGE_FRAME], (int32_t)(outputUs - latchUs));
+	latencyRecord(&stats[LATENCY_STAGE_TOTAL], (int32_t)(outputUs - probeSetUs));
+	probeActive = false;
+}
+
+void latencyProbePrint()
+{
+	Serial.printf("\nAspect latency, setAspect() to lamp (ms, min/avg/max), %" PRIu32 " timeouts, %" PRIu32 " bus errors\n",
+		probeTimeouts, probeBusErrors);
+	Serial.printf("Head  Count");
+	for (uint8_t s=0; s<LATENCY_STAGE_END; s++)
+		Serial.printf("  %17s", stageNames[s]);
+	Serial.printf("\n");
+
+	for (uint8_t h=0; h<SHCP_NUM_HEADS; h++)
+	{
+		Serial.printf("%4u  %5" PRIu32, h, latencyStats[h][LATENCY_STAGE_TOTAL].count);
+		for (uint8_t s=0; s<LATENCY_STAGE_END; s++)
+		{
+			const LatencyStat_t* stat = &latencyStats[h][s];
+			if (0 == stat->count)
+				Serial.printf("  %17s", "-");
+			else
+				Serial.printf("  %5" PRIu32 "/%5" PRIu32 "/%5" PRIu32, stat->minUs / 1000, (uint32_t)(stat->totalUs / stat->count / 1000), stat->maxUs / 1000);
+		}
+		Serial.printf("\n");
+	}
+}
@@ -0,0 +1,60 @@
+/*************************************************************************
+Title:    Aspect Latency Probe
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     latencyProbe.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _LATENCY_PROBE_H_
+#define _LATENCY_PROBE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shcpRegisters.h"
+#include "xcadeLink.h"
+
+// The SHCP frame counter is 8 bits, so anything slower than ~2s can't be
+//  placed in time and is thrown out
+#define LATENCY_PROBE_TIMEOUT_US 2000000
+
+typedef enum
+{
+	LATENCY_STAGE_LOOP   = 0,  // setAspect() until it went out with the tag
+	LATENCY_STAGE_POLL   = 1,  // Bus write until the SHCP register poll picked it up
+	LATENCY_STAGE_FRAME  = 2,  // Register poll until the head started moving
+	LATENCY_STAGE_TOTAL  = 3,
+	LATENCY_STAGE_END
+} LatencyStage_t;
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t minUs;
+	uint32_t maxUs;
+	uint64_t totalUs;
+} LatencyStat_t;
+
+// link is how to get to the SHCP
+void latencyProbeBegin(XCadeLink* link);
+bool latencyProbeAspectSet(uint8_t head, uint8_t aspect, uint32_t nowUs);
+void latencyProbeSend();
+void latencyProbePoll(uint32_t nowUs);
+void latencyProbePrint();
+
+#endif
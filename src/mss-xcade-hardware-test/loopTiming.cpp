@@ -0,0 +1,149 @@
+/*************************************************************************
+Title:    Loop Timing Instrumentation
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     loopTiming.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include "loopTiming.h"
+
+LoopTiming_t loopTiming;
+
+static const char* const phaseNames[LOOP_PHASE_END] = { "inputs", "logic", "outputs", "total" };
+
+static uint8_t loopTimingBucket(uint32_t us)
+{
+	uint8_t octave;
+	uint8_t idx;
+
+	if (us < LOOP_TIMING_STEPS_PER_OCTAVE)
+		return us;
+
+	octave = 31 - __builtin_clz(us);
+	idx = LOOP_TIMING_STEPS_PER_OCTAVE * (octave - 1) + ((us >> (octave - 2)) & 0x03);
+	return min(idx, (uint8_t)(LOOP_TIMING_BUCKETS - 1));
+}
+
+// Largest value that lands in a bucket
+static uint32_t loopTimingBucketTop(uint8_t idx)
+{
+	uint8_t octave;
+
+	if (idx < LOOP_TIMING_STEPS_PER_OCTAVE - 1)
+		return idx;
+
+	idx++;
+	octave = idx / LOOP_TIMING_STEPS_PER_OCTAVE + 1;
+	return ((uint32_t)(LOOP_TIMING_STEPS_PER_OCTAVE + (idx % LOOP_TIMING_STEPS_PER_OCTAVE)) << (octave - 2)) - 1;
+}
+
+static void loopTimingRecord(LoopPhaseStats_t* stats, uint32_t us)
+{
+	stats->count++;
+	stats->totalUs += us;
+	stats->minUs = min(stats->minUs, us);
+	stats->maxUs = max(stats->maxUs, us);
+	stats->bucket[loopTimingBucket(us)]++;
+}
+
+void loopTimingReset()
+{
+	uint32_t periodUs = loopTiming.periodUs;
+
+	memset(&loopTiming, 0, sizeof(loopTiming));
+	loopTiming.periodUs = periodUs;
+	for (uint8_t i=0; i<LOOP_PHASE_END; i++)
+		loopTiming.phase[i].minUs = UINT32_MAX;
+}
+
+void loopTimingBegin(uint32_t periodMs)
+{
+	loopTiming.periodUs = periodMs * 1000;
+	loopTimingReset();
+}
+
+void loopTimingStart()
+{
+	loopTiming.loopStartUs = loopTiming.phaseStartUs = micros();
+}
+
+void loopTimingPhaseEnd(LoopPhase_t phase)
+{
+	uint32_t now = micros();
+	loopTimingRecord(&loopTiming.phase[phase], now - loopTiming.phaseStartUs);
+	loopTiming.phaseStartUs = now;
+}
+
+void loopTimingEnd()
+{
+	uint32_t total = micros() - loopTiming.loopStartUs;
+
+	loopTimingRecord(&loopTiming.phase[LOOP_PHASE_TOTAL], total);
+	if (total > loopTiming.periodUs)
+	{
+		loopTiming.overruns++;
+		loopTiming.worstOverrunUs = max(loopTiming.worstOverrunUs, total - loopTiming.periodUs);
+	}
+}
+
+uint32_t loopTimingPercentile(LoopPhase_t phase, uint16_t permille)
+{
+	const LoopPhaseStats_t* stats = &loopTiming.phase[phase];
+	uint64_t target = ((uint64_t)stats->count * permille + 999) / 1000;
+	uint64_t seen = 0;
+
+	if (0 == stats->count)
+		return 0;
+
+	for (uint8_t i=0; i<LOOP_TIMING_BUCKETS; i++)
+	{
+		seen += stats->bucket[i];
+		if (seen >= target)
+			return min(loopTimingBucketTop(i), stats->maxUs);
+	}
+	return stats->maxUs;
+}
+
+void loopTimingPrint()
+{
+	const LoopPhaseStats_t* total = &loopTiming.phase[LOOP_PHASE_TOTAL];
+
+	Serial.printf("\nLoop timing: %" PRIu32 " loops, %" PRIu32 " us period, %" PRIu32 " overruns (%" PRIu32 " ppm), worst overrun %" PRIu32 " us\n",
+		total->count, loopTiming.periodUs, loopTiming.overruns,
+		(uint32_t)((uint64_t)loopTiming.overruns * 1000000 / max(total->count, (uint32_t)1)),
+		loopTiming.worstOverrunUs);
+	Serial.printf("Phase        min      avg      p50      p90      p99    p99.9      max  (us)\n");
+
+	for (uint8_t i=0; i<LOOP_PHASE_END; i++)
+	{
+		const LoopPhaseStats_t* stats = &loopTiming.phase[i];
+		if (0 == stats->count)
+		{
+			Serial.printf("%-8s         -\n", phaseNames[i]);
+			continue;
+		}
+		Serial.printf("%-8s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "\n", phaseNames[i],
+			stats->minUs, (uint32_t)(stats->totalUs / stats->count),
+			loopTimingPercentile((LoopPhase_t)i, 500), loopTimingPercentile((LoopPhase_t)i, 900),
+			loopTimingPercentile((LoopPhase_t)i, 990), loopTimingPercentile((LoopPhase_t)i, 999),
+			stats->maxUs);
+	}
+}
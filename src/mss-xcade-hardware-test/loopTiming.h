@@ -0,0 +1,85 @@
+/*************************************************************************
+Title:    Loop Timing Instrumentation
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     loopTiming.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _LOOP_TIMING_H_
+#define _LOOP_TIMING_H_
+
+#include <stdint.h>
+
+// Set to 0 to compile all of the timing hooks out of the loop
+#ifndef LOOP_TIMING_ENABLED
+#define LOOP_TIMING_ENABLED 1
+#endif
+
+typedef enum
+{
+	LOOP_PHASE_INPUTS  = 0,
+	LOOP_PHASE_LOGIC   = 1,
+	LOOP_PHASE_OUTPUTS = 2,
+	LOOP_PHASE_TOTAL   = 3,
+	LOOP_PHASE_END
+} LoopPhase_t;
+
+// Histogram buckets are log2 with 4 steps per octave, so any percentile
+//  is good to within about 20% from 1us out to ~16s
+#define LOOP_TIMING_STEPS_PER_OCTAVE  4
+#define LOOP_TIMING_BUCKETS           (24 * LOOP_TIMING_STEPS_PER_OCTAVE)
+
+typedef struct
+{
+	uint32_t count;
+	uint32_t minUs;
+	uint32_t maxUs;
+	uint64_t totalUs;
+	uint32_t bucket[LOOP_TIMING_BUCKETS];
+} LoopPhaseStats_t;
+
+typedef struct
+{
+	uint32_t periodUs;
+	uint32_t overruns;
+	uint32_t worstOverrunUs;
+	uint32_t loopStartUs;
+	uint32_t phaseStartUs;
+	LoopPhaseStats_t phase[LOOP_PHASE_END];
+} LoopTiming_t;
+
+void loopTimingBegin(uint32_t periodMs);
+void loopTimingReset();
+void loopTimingStart();
+void loopTimingPhaseEnd(LoopPhase_t phase);
+void loopTimingEnd();
+uint32_t loopTimingPercentile(LoopPhase_t phase, uint16_t permille);
+void loopTimingPrint();
+
+#if LOOP_TIMING_ENABLED
+#define LOOP_TIMING_START()        loopTimingStart()
+#define LOOP_TIMING_PHASE_END(p)   loopTimingPhaseEnd(p)
+#define LOOP_TIMING_END()          loopTimingEnd()
+#else
+#define LOOP_TIMING_START()
+#define LOOP_TIMING_PHASE_END(p)
+#define LOOP_TIMING_END()
+#endif
+
+#endif
@@ -21,7 +21,17 @@ LICENSE:
 
 *************************************************************************/
 #include "Wire.h"
+#include <inttypes.h>
+#include <Preferences.h>
 #include "mss-xcade.h"
+#include "loopTiming.h"
+#include "latencyProbe.h"
+#include "shcpRegisters.h"
+#include "xcadeBusWire.h"
+#include "xcadeCanTwai.h"
+#include "xcadeDebounce.h"
+#include "xcadeDiscovery.h"
+#include "xcadeLink.h"
 
 WireMux wireMux;
 XCade xcade;
@@ -29,23 +39,1103 @@ XCade xcadeExpander1;
 
 
 #define LOOP_UPDATE_TIME_MS 50
+
+// Tag aspect changes and time them all the way out to the lamps.  The probe
+//  writes the probed head's aspect itself, along with the tag, so it adds a
+//  read, a write and a read back to the bus every DEBUG_UPDATE_TIME_MS.
+//  Needs SHCP firmware with the probe registers
+#define LATENCY_PROBE_ENABLED false
 #define DEBUG_UPDATE_TIME_MS 250
+
+// Set to true to soak the bus instead of running the normal tests.  Every
+//  head's aspect and options registers on the SHCP are rewritten and read
+//  back as fast as the bus allows, interleaved with full expander refreshes,
+//  and a summary is printed every STRESS_REPORT_MS.  Everything goes to the
+//  devices wherever discovery found them, mux channel and all.
+#define STRESS_TEST_MODE false
+#define STRESS_I2C_CLOCK 400000
+#define STRESS_REPORT_MS 10000
+#define STRESS_MAX_RETRIES 3
+#define STRESS_EXPANDER_INTERVAL 4
+// Send framed writes and check them with one status read every
+//  STRESS_FRAME_BATCH writes, instead of reading every write back.  Needs
+//  an SHCP built with I2C_FRAME_MAX of 16 or more.
+#define STRESS_FRAMED_WRITES false
+#define STRESS_FRAME_BATCH 4
+
+typedef struct
+{
+  uint32_t transactions;
+  uint32_t addrNacks;
+  uint32_t dataNacks;
+  uint32_t busErrors;
+  uint32_t shortReads;
+  uint32_t mismatches;
+  uint32_t retries;
+  uint32_t failures;
+  uint32_t cycles;
+  uint32_t worstCycleUs;
+  uint32_t expanderUpdates;
+  uint32_t worstExpanderUs;
+} StressStats;
+
+// Second I2C controller.  XCade v1.x has a single SDA/SCL net, so boards
+//  moved to Wire1 need their own mux and wiring to these pins.  With the pins
+//  set, the input ports of the first four expanders discovery finds on Wire1
+//  are read by the scheduler's worker while the library reads its own on Wire,
+//  so they cost the loop next to nothing.  They're debounced like the rest
+//  and shown in the sensor test.  With XCADE_INPUT_INT_PIN set they're read
+//  whenever the Wire inputs are, so wire their /INT in with the others.
+#define XCADE_WIRE1_SDA -1
+#define XCADE_WIRE1_SCL -1
+
+XCadeBusWire wireBus0(&Wire, STRESS_TEST_MODE?STRESS_I2C_CLOCK:100000);
+XCadeBusWire wireBus1(&Wire1, STRESS_TEST_MODE?STRESS_I2C_CLOCK:100000);
+XCadeBusScheduler busScheduler;
+
+// Filled in from the topology by dualBusPlan().  Boards still on Wire belong
+//  to the library, and a job there would move the mux behind WireMux's back,
+//  so only Wire1 expanders go in.  Up to four, 16 bits each in the debounced
+//  word.
+#define DUAL_BUS_MAX_DEVICES 4
+#define DUAL_BUS_SAMPLES 4
+
+uint8_t dualBusData[DUAL_BUS_MAX_DEVICES][2];
+XCadeBusJob dualBusDevices[DUAL_BUS_MAX_DEVICES];
+uint8_t dualBusNumDevices = 0;
+
+XCadeDebouncer<uint64_t> dualBusDebounce;
+uint32_t dualBusErrors = 0;
+
+bool dualBusEnabled()
+{
+  return (XCADE_WIRE1_SDA >= 0 && XCADE_WIRE1_SCL >= 0);
+}
+
+void dualBusBegin()
+{
+  if (!dualBusEnabled())
+    return;
+
+  Wire1.setPins(XCADE_WIRE1_SDA, XCADE_WIRE1_SCL);
+  Wire1.setClock(wireBus1.clockHz());
+  Wire1.begin();
+
+  busScheduler.begin(&wireBus0, &wireBus1);
+}
+
+// Sets the Wire1 reads going, do the Wire work and then dualBusFinish()
+void dualBusStart()
+{
+  if (!dualBusEnabled())
+    return;
+
+  busScheduler.clear();
+  for (uint8_t i=0; i<dualBusNumDevices; i++)
+    busScheduler.add(&dualBusDevices[i]);
+  busScheduler.start();
+}
+
+uint64_t dualBusSample()
+{
+  uint64_t raw = 0;
+
+  for (uint8_t i=0; i<dualBusNumDevices; i++)
+    raw |= (uint64_t)(dualBusData[i][0] | (dualBusData[i][1] << 8)) << (16 * i);
+  return raw;
+}
+
+// Returns false if any of the reads failed.  Failed ones keep their last
+//  data, so the debouncer just sees the same sample again.
+bool dualBusFinish()
+{
+  bool ok;
+
+  if (!dualBusEnabled())
+    return true;
+
+  ok = busScheduler.finish();
+  if (!ok)
+    dualBusErrors++;
+  dualBusDebounce.update(dualBusSample());
+  return ok;
+}
+
+// Call before the loop starts, it starts out at whatever the inputs are now
+void dualBusDebounceBegin()
+{
+  if (!dualBusEnabled())
+    return;
+
+  dualBusStart();
+  dualBusFinish();
+  dualBusDebounce.begin(dualBusSample(), DUAL_BUS_SAMPLES);
+}
+
+// What's on the buses, see xcadeDiscovery.h.  The first boot looks for
+//  everything and keeps the result in NVS, later boots just check it's all
+//  still there and answering the same.  'd' looks again from scratch.
+//  Everything the sketch talks to outside the library goes by it: the SHCP
+//  and expander links and the Wire1 boards, none of which probe on their
+//  own.  xcade.begin() still finds its boards the way it always has, so the
+//  cache doesn't make booting any quicker than that, it only saves a full
+//  discovery on every boot.
+#define DISCOVERY_NVS_NAMESPACE "xcade"
+#define DISCOVERY_NVS_KEY       "topology"
+
+XCadeDiscovery discovery;
+XCadeTopology topology;
+
+// Wire1 expanders, in the order discovery found them
+void dualBusPlan()
+{
+  dualBusNumDevices = 0;
+  for (uint8_t d=0; d<topology.numDevices && dualBusNumDevices<DUAL_BUS_MAX_DEVICES; d++)
+  {
+    const XCadeDevice* dev = &topology.devices[d];
+    XCadeBusJob* job = &dualBusDevices[dualBusNumDevices];
+
+    if (1 != dev->bus || XCADE_DEVICE_PCA9555 != dev->type)
+      continue;
+    job->channel = dev->channel;
+    job->addr = dev->addr;
+    job->reg = 0x00;
+    job->len = 2;
+    job->data = dualBusData[dualBusNumDevices];
+    job->read = true;
+    job->bus = 1;
+    job->ok = false;
+    memset(job->data, 0, 2);
+    dualBusNumDevices++;
+  }
+}
+
+void discoveryRun(bool useCache)
+{
+  Preferences nvs;
+  uint32_t start = micros();
+  bool cached = false;
+
+  nvs.begin(DISCOVERY_NVS_NAMESPACE, false);
+  if (useCache && sizeof(topology) == nvs.getBytes(DISCOVERY_NVS_KEY, &topology, sizeof(topology)))
+    cached = discovery.validate(&topology);
+  if (!cached)
+  {
+    discovery.discover(&topology);
+    nvs.putBytes(DISCOVERY_NVS_KEY, &topology, sizeof(topology));
+  }
+  nvs.end();
+
+  Serial.printf("%s %u devices in %" PRIu32 " us, %u transactions\n", cached?"Checked":"Found",
+    topology.numDevices, micros() - start, discovery.lastJobs);
+
+  if (dualBusEnabled())
+  {
+    dualBusPlan();
+    Serial.printf("Dual bus, %u Wire1 expanders\n", dualBusNumDevices);
+  }
+}
+
+void discoveryPrint()
+{
+  for (uint8_t i=0; i<topology.numDevices; i++)
+  {
+    const XCadeDevice* dev = &topology.devices[i];
+
+    Serial.printf("  bus %u  ", dev->bus);
+    if (XCADE_MUX_NONE == dev->channel)
+      Serial.printf("       ");
+    else
+      Serial.printf("ch %u   ", dev->channel);
+    switch(dev->type)
+    {
+      case XCADE_DEVICE_PCA9555:
+        Serial.printf("0x%02X  PCA9555\n", dev->addr);
+        break;
+      case XCADE_DEVICE_SHCP:
+        Serial.printf("0x%02X  SHCP v%u, capabilities 0x%02X\n", dev->addr, dev->id[1], dev->id[2]);
+        break;
+      default:
+        Serial.printf("0x%02X  unknown\n", dev->addr);
+        break;
+    }
+  }
+}
+
+// The mux gets moved behind wireMux's back, so call before xcade.begin()
+void discoveryBegin()
+{
+  if (!dualBusEnabled())
+    busScheduler.begin(&wireBus0);
+  discovery.begin(&busScheduler, dualBusEnabled()?2:1);
+  discoveryRun(true);
+}
+
+// Direct access to the SHCP and the expanders, outside the library, for the
+//  stress test and the SHCP tools.  See xcadeLink.h.
+XCadeLink shcpLink;
+XCadeLink expanderLink;
+
+void linkBegin()
+{
+  shcpLink.begin(&Wire, dualBusEnabled()?&Wire1:NULL, &topology, XCADE_DEVICE_SHCP, SHCP_I2C_ADDR);
+  expanderLink.begin(&Wire, dualBusEnabled()?&Wire1:NULL, &topology, XCADE_DEVICE_PCA9555, 0x20);
+}
+
+// Every input the loop acts on.  The sensors and GPIO are debounced together
+//  in one word, see xcadeDebounce.h, each group with its own number of loop
+//  samples, so a noisy sensor can take longer without holding up anything
+//  else.  Bits 9:0 are sensors 1-10 and bits 15:10 GPIO 1-6.
+#define INPUT_SENSOR_MASK      0x000003FFUL
+#define INPUT_GPIO_MASK        0x0000FC00UL
+#define INPUT_GPIO_SHIFT       10
+#define INPUT_SENSOR_SAMPLES   4
+#define INPUT_GPIO_SAMPLES     4
+// The indication received on each MSS port is a code, not a set of bits, so
+//  it's debounced whole.  The library debounces the port lines but not the
+//  decoded indication, so a change that lands across two line samples can
+//  decode wrong for one loop.  Two samples rules that out and adds one loop
+//  to the cascade.  src/xcade-debounce-bench prints the timing.
+#define INPUT_MSS_PORTS        4
+#define INPUT_MSS_SAMPLES      2
+
+XCadeDebouncer<uint32_t> inputDebounce;
+XCadeValueDebouncer<INPUT_MSS_PORTS> indicationDebounce;
+
+uint32_t inputSample()
+{
+  static const uint8_t sensorPins[] = { SENSOR_1_PIN, SENSOR_2_PIN, SENSOR_3_PIN, SENSOR_4_PIN, SENSOR_5_PIN,
+    SENSOR_6_PIN, SENSOR_7_PIN, SENSOR_8_PIN, SENSOR_9_PIN, SENSOR_10_PIN };
+  uint32_t raw = 0;
+
+  for (uint8_t i=0; i<sizeof(sensorPins); i++)
+    raw |= (xcade.gpio.digitalRead(sensorPins[i])?1UL:0) << i;
+  for (uint8_t i=0; i<6; i++)
+    raw |= (xcade.gpio.digitalRead(i+1)?1UL:0) << (INPUT_GPIO_SHIFT + i);
+  return raw;
+}
+
+void indicationSample(uint8_t* raw)
+{
+  raw[0] = xcade.mssPortA.indicationReceivedGet();
+  raw[1] = xcade.mssPortB.indicationReceivedGet();
+  raw[2] = xcade.mssPortC.indicationReceivedGet();
+  raw[3] = xcade.mssPortD.indicationReceivedGet();
+}
+
+// Call after xcade.begin(), it starts out at whatever the inputs are now
+void inputDebounceBegin()
+{
+  uint8_t indications[INPUT_MSS_PORTS];
+
+  xcade.updateInputs();
+  inputDebounce.begin(inputSample(), INPUT_SENSOR_SAMPLES);
+  inputDebounce.setDepth(INPUT_GPIO_MASK, INPUT_GPIO_SAMPLES);
+  indicationSample(indications);
+  indicationDebounce.begin(indications, INPUT_MSS_SAMPLES);
+}
+
+// Call after every xcade.updateInputs()
+void inputDebounceUpdate()
+{
+  uint8_t indications[INPUT_MSS_PORTS];
+
+  inputDebounce.update(inputSample());
+  indicationSample(indications);
+  for (uint8_t i=0; i<INPUT_MSS_PORTS; i++)
+    indicationDebounce.update(i, indications[i]);
+}
+
+bool inputSensor(uint8_t sensor)
+{
+  return (inputDebounce.debounced() >> (sensor - 1)) & 0x01;
+}
+
+bool inputGpio(uint8_t gpio)
+{
+  return (inputDebounce.debounced() >> (INPUT_GPIO_SHIFT + gpio - 1)) & 0x01;
+}
+
+uint8_t inputIndication(uint8_t port)
+{
+  return indicationDebounce.debounced(port);
+}
+
+// CAN transport for the XCade-CAN board (kicad/mss-xcade-can), see
+//  xcadeCan.h.  Set the pins to wherever its CAN_TX and CAN_RX end up and
+//  give every board on the segment its own node number (1-127).  Occupancy,
+//  port indications and sensor inputs go out whenever they change, and
+//  'n' lists every other board heard from.
+#define CAN_TX_PIN -1
+#define CAN_RX_PIN -1
+#define CAN_BITRATE 250000
+#define CAN_NODE_ID 1
+
+XCadeCanTwai canPort;
+XCadeCanNode canNode;
+XCadeCanListener canListener;
+bool canRunning = false;
+// The library doesn't hand back local occupancy, so keep track of what we set
+uint8_t canOccupancy = 0;
+
+void canBegin()
+{
+  if (CAN_TX_PIN < 0 || CAN_RX_PIN < 0)
+    return;
+
+  canRunning = canPort.begin(CAN_TX_PIN, CAN_RX_PIN, CAN_BITRATE);
+  if (!canRunning)
+  {
+    Serial.println("CAN start failed");
+    return;
+  }
+  canNode.begin(&canPort, CAN_NODE_ID);
+  canListener.begin(&canPort);
+  Serial.printf("CAN node %u at %u bit/s\n", CAN_NODE_ID, (unsigned int)CAN_BITRATE);
+}
+
+// Call every loop, after the inputs have been read
+void canUpdate(uint32_t currentTime)
+{
+  XCadeCanState state;
+
+  if (!canRunning)
+    return;
+
+  state.occupancy = canOccupancy;
+  for (uint8_t i=0; i<XCADE_CAN_PORTS; i++)
+    state.indication[i] = inputIndication(i);
+  state.sensors = inputDebounce.debounced() & INPUT_SENSOR_MASK;
+
+  canNode.update(&state, currentTime);
+  canListener.poll(currentTime);
+}
+
+void canPrint(uint32_t currentTime)
+{
+  if (!canRunning)
+  {
+    Serial.println("CAN not running");
+    return;
+  }
+
+  Serial.printf("\nCAN node %u: %" PRIu32 " frames sent, %" PRIu32 " waits for the bus, %" PRIu32 " received, %" PRIu32 " bad\n",
+    CAN_NODE_ID, canNode.framesSent, canNode.sendBusy, canListener.framesReceived, canListener.badFrames);
+  Serial.printf("Node  Occ   Indications  Sensors  Missed  Age ms\n");
+  for (uint8_t n=1; n<XCADE_CAN_MAX_NODES; n++)
+  {
+    const XCadeCanRemote* r = canListener.remote(n);
+    if (!canListener.online(n, currentTime))
+      continue;
+    Serial.printf("%4u  0x%X   %u %u %u %u      0x%04X   %5u  %6" PRIu32 "%s\n", n, r->state.occupancy,
+      r->state.indication[0], r->state.indication[1], r->state.indication[2], r->state.indication[3],
+      r->state.sensors, r->missed, currentTime - r->lastSeenMs, (XCADE_CAN_HAVE_ALL == r->have)?"":" (partial)");
+  }
+}
+
+StressStats stressInterval;
+StressStats stressTotal;
+uint32_t stressStartTime = 0;
+uint32_t stressReportTime = 0;
+uint32_t stressSeed = 0x2545F491;
+
+// Counts whatever went wrong, returns true if nothing did
+bool stressCount(StressStats* stats, uint8_t err)
+{
+  switch(err)
+  {
+    case XCADE_LINK_OK:
+      return true;
+    case XCADE_LINK_ADDR_NACK:
+      stats->addrNacks++;
+      break;
+    case XCADE_LINK_DATA_NACK:
+      stats->dataNacks++;
+      break;
+    case XCADE_LINK_SHORT_READ:
+      stats->shortReads++;
+      break;
+    case XCADE_LINK_MISMATCH:
+      stats->mismatches++;
+      break;
+    default:
+      stats->busErrors++;
+      break;
+  }
+  return false;
+}
+
+// Returns true if the write was ACKed all the way through
+bool stressWrite(StressStats* stats, uint8_t reg, const uint8_t* data, uint8_t len)
+{
+  stats->transactions++;
+  return stressCount(stats, shcpLink.write(reg, data, len));
+}
+
+bool stressRead(StressStats* stats, uint8_t reg, uint8_t* data, uint8_t len)
+{
+  stats->transactions += 2;
+  return stressCount(stats, shcpLink.read(reg, data, len));
+}
+
+uint8_t shcpCrc8(const uint8_t* data, uint8_t len)
+{
+  uint8_t crc = 0;
+
+  for (uint8_t i=0; i<len; i++)
+  {
+    crc ^= data[i];
+    for (uint8_t b=0; b<8; b++)
+      crc = (crc & 0x80)?((crc << 1) ^ 0x07):(crc << 1);
+  }
+  return crc;
+}
+
+// Write, read back and compare, until it matches
+bool stressReadBackWrite(const uint8_t* data, uint8_t len)
+{
+  uint8_t readback[SHCP_NUM_HEADS * 2];
+  uint8_t attempt;
+
+  for (attempt=0; attempt<=STRESS_MAX_RETRIES; attempt++)
+  {
+    if (attempt)
+      stressInterval.retries++;
+
+    if (!stressWrite(&stressInterval, SHCP_REG_ASPECTS_BASE, data, len))
+      continue;
+    if (!stressRead(&stressInterval, SHCP_REG_ASPECTS_BASE, readback, len))
+      continue;
+    if (0 != memcmp(data, readback, len))
+    {
+      stressInterval.mismatches++;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+uint8_t stressFrameSeq = 0;
+uint8_t stressFrameGood = 0;
+uint8_t stressFramesUnchecked = 0;
+
+// Every frame carries all the heads, so only the newest one has to land.
+//  Anything lost in between is covered by the ones after it, and a retry is
+//  just the same registers again under a new sequence number.  Each check
+//  still accounts for every frame since the last one: the SHCP's good frame
+//  count has to have gone up by exactly that many.
+bool stressFramedWrite(const uint8_t* data, uint8_t len)
+{
+  uint8_t frame[SHCP_NUM_HEADS * 2 + 3];
+  uint8_t status[SHCP_REG_FRAME_GOOD - SHCP_REG_FRAME_SEQ + 1];
+  uint8_t landed;
+  uint8_t attempt;
+
+  for (attempt=0; attempt<=STRESS_MAX_RETRIES; attempt++)
+  {
+    if (attempt)
+      stressInterval.retries++;
+
+    frame[0] = SHCP_REG_ASPECTS_BASE | SHCP_FRAME_FLAG;
+    memcpy(&frame[1], data, len);
+    frame[len + 1] = ++stressFrameSeq;
+    frame[len + 2] = shcpCrc8(frame, len + 2);
+    stressWrite(&stressInterval, frame[0], &frame[1], len + 2);
+    if (++stressFramesUnchecked < STRESS_FRAME_BATCH && 0 == attempt)
+      return true;
+
+    if (!stressRead(&stressInterval, SHCP_REG_FRAME_SEQ, status, sizeof(status)))
+      continue;
+    landed = status[SHCP_REG_FRAME_GOOD - SHCP_REG_FRAME_SEQ] - stressFrameGood;
+    stressFrameGood = status[SHCP_REG_FRAME_GOOD - SHCP_REG_FRAME_SEQ];
+    if (landed < stressFramesUnchecked)
+      stressInterval.mismatches += stressFramesUnchecked - landed;
+    stressFramesUnchecked = 0;
+    if (stressFrameSeq == status[0])
+      return true;
+  }
+  return false;
+}
+
+// The library doesn't check its expander writes, so go through every
+//  expander, read its output ports and write them back the same with a
+//  read back to check.  Nothing changes, so the library's outputs stay put.
+void stressExpanderVerify()
+{
+  uint8_t outputs[2];
+
+  for (uint8_t d=0; d<topology.numDevices; d++)
+  {
+    if (XCADE_DEVICE_PCA9555 != topology.devices[d].type)
+      continue;
+
+    expanderLink.retarget(&topology.devices[d]);
+    if (!stressCount(&stressInterval, expanderLink.open()))
+      continue;
+    stressInterval.transactions += 2;
+    if (stressCount(&stressInterval, expanderLink.read(0x02, outputs, sizeof(outputs))))
+    {
+      stressInterval.transactions += 3;
+      stressCount(&stressInterval, expanderLink.writeVerified(0x02, outputs, sizeof(outputs)));
+    }
+    expanderLink.close();
+  }
+}
+
+void stressAccumulate(StressStats* total, const StressStats* interval)
+{
+  total->transactions += interval->transactions;
+  total->addrNacks += interval->addrNacks;
+  total->dataNacks += interval->dataNacks;
+  total->busErrors += interval->busErrors;
+  total->shortReads += interval->shortReads;
+  total->mismatches += interval->mismatches;
+  total->retries += interval->retries;
+  total->failures += interval->failures;
+  total->cycles += interval->cycles;
+  total->worstCycleUs = max(total->worstCycleUs, interval->worstCycleUs);
+  total->expanderUpdates += interval->expanderUpdates;
+  total->worstExpanderUs = max(total->worstExpanderUs, interval->worstExpanderUs);
+}
+
+void stressPrint(const char* label, const StressStats* stats, uint32_t elapsedMs)
+{
+  uint32_t errors = stats->addrNacks + stats->dataNacks + stats->busErrors + stats->shortReads + stats->mismatches;
+
+  Serial.printf("%-8s %7" PRIu32 "s  %6" PRIu32 " tx/s  %5" PRIu32 " cyc/s  worst %6" PRIu32 " us  exp worst %6" PRIu32 " us  "
+    "nack %" PRIu32 "/%" PRIu32 "  bus %" PRIu32 "  short %" PRIu32 "  mismatch %" PRIu32 "  retry %" PRIu32 "  fail %" PRIu32 "  (%" PRIu32 " ppm)\n",
+    label, elapsedMs / 1000,
+    (uint32_t)((uint64_t)stats->transactions * 1000 / max(elapsedMs, (uint32_t)1)),
+    (uint32_t)((uint64_t)stats->cycles * 1000 / max(elapsedMs, (uint32_t)1)),
+    stats->worstCycleUs, stats->worstExpanderUs,
+    stats->addrNacks, stats->dataNacks, stats->busErrors, stats->shortReads, stats->mismatches,
+    stats->retries, stats->failures,
+    (uint32_t)((uint64_t)errors * 1000000 / max(stats->transactions, (uint32_t)1)));
+}
+
+void stressTestStart()
+{
+  memset(&stressInterval, 0, sizeof(stressInterval));
+  memset(&stressTotal, 0, sizeof(stressTotal));
+  stressStartTime = stressReportTime = millis();
+  if (STRESS_FRAMED_WRITES)
+    stressRead(&stressInterval, SHCP_REG_FRAME_GOOD, &stressFrameGood, 1);
+  shcpLink.open();
+  Serial.printf("Stress test, SHCP at 0x%02X bus %u", SHCP_I2C_ADDR, shcpLink.bus);
+  if (XCADE_MUX_NONE != shcpLink.channel)
+    Serial.printf(" ch %u", shcpLink.channel);
+  Serial.printf(", %u Hz\n", STRESS_I2C_CLOCK);
+  shcpLink.close();
+}
+
+void stressTestRun()
+{
+  uint8_t regs[SHCP_NUM_HEADS * 2];
+  uint32_t start = micros();
+  uint32_t currentTime;
+
+  // New aspect for every head (OFF through FL_RED) and flip between three
+  //  light and searchlight, leaving the CA/CC bits on sense
+  for (uint8_t i=0; i<SHCP_NUM_HEADS; i++)
+  {
+    stressSeed ^= stressSeed << 13;
+    stressSeed ^= stressSeed >> 17;
+    stressSeed ^= stressSeed << 5;
+    regs[SHCP_REG_ASPECTS_BASE + i] = stressSeed % ASPECT_LUNAR;
+    regs[SHCP_REG_OPTIONS_BASE + i] = (stressSeed >> 8) & 0x01;
+  }
+
+  // One session for the lot, so the mux only moves once
+  if (!stressCount(&stressInterval, shcpLink.open()))
+    stressInterval.failures++;
+  else
+  {
+    if (!(STRESS_FRAMED_WRITES?stressFramedWrite(regs, sizeof(regs)):stressReadBackWrite(regs, sizeof(regs))))
+      stressInterval.failures++;
+    shcpLink.close();
+  }
+
+  stressInterval.cycles++;
+  stressInterval.worstCycleUs = max(stressInterval.worstCycleUs, micros() - start);
+
+  // Keep the I/O expanders busy too, but through the library so they see
+  //  the same traffic they do in normal operation
+  if (0 == (stressInterval.cycles % STRESS_EXPANDER_INTERVAL))
+  {
+    start = micros();
+    dualBusStart();
+    xcade.updateInputs();
+    xcade.updateOutputs();
+    stressExpanderVerify();
+    if (!dualBusFinish())
+      stressInterval.busErrors++;
+    stressInterval.expanderUpdates++;
+    stressInterval.worstExpanderUs = max(stressInterval.worstExpanderUs, micros() - start);
+  }
+
+  currentTime = millis();
+  if (((uint32_t)currentTime - stressReportTime) >= STRESS_REPORT_MS)
+  {
+    stressAccumulate(&stressTotal, &stressInterval);
+    stressPrint("Interval", &stressInterval, currentTime - stressReportTime);
+    stressPrint("Total", &stressTotal, currentTime - stressStartTime);
+    uint8_t recoveries;
+    if (stressRead(&stressInterval, SHCP_REG_I2C_RECOVERIES, &recoveries, 1))
+      Serial.printf("SHCP TWI recoveries %u\n", recoveries);
+    uint8_t stack[2];
+    if (stressRead(&stressInterval, SHCP_REG_STACK_USED, stack, sizeof(stack)))
+      Serial.printf("SHCP stack %u bytes deepest, %u never used\n", stack[0], stack[1]);
+    uint8_t frameStatus[3];
+    if (STRESS_FRAMED_WRITES && stressRead(&stressInterval, SHCP_REG_FRAME_SEQ, frameStatus, sizeof(frameStatus)))
+      Serial.printf("SHCP frames %u good (mod 256), %u rejected\n", frameStatus[1], frameStatus[2]);
+    memset(&stressInterval, 0, sizeof(stressInterval));
+    stressReportTime = currentTime;
+  }
+}
+
+// Input change wake-up.  The PCA9555 expanders pull /INT low when any input
+//  changes and release it once the input port is read, so with /INT wired to
+//  the ESP32 we only need to read inputs when something actually changed.
+//  XCade v1.x leaves /INT unconnected (U8, U11, U13 pin 1), so this needs the
+//  /INT pins wire-ORed to a spare GPIO.  Leave at -1 to read every loop.
+#define XCADE_INPUT_INT_PIN -1
+// After a change, keep sampling at the loop rate long enough for the
+//  debouncer to see a full run of samples, for the slowest group
+#define INPUT_DEBOUNCE_SAMPLES max(INPUT_SENSOR_SAMPLES, max(INPUT_GPIO_SAMPLES, INPUT_MSS_SAMPLES))
+// Even with the interrupt, read everything once in a while in case an edge
+//  was missed
+#define INPUT_SAFETY_POLL_MS 1000
+
+volatile bool inputChanged = false;
+uint8_t inputSamplesPending = 0;
+uint32_t lastInputReadTime = 0;
+
+void IRAM_ATTR inputChangeISR()
+{
+  inputChanged = true;
+}
+
+void inputWakeBegin()
+{
+  if (XCADE_INPUT_INT_PIN < 0)
+    return;
+  pinMode(XCADE_INPUT_INT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(XCADE_INPUT_INT_PIN), inputChangeISR, FALLING);
+}
+
+// True if a change should cut the loop wait short.  Once debounce sampling
+//  has started it stays on the regular loop schedule so the debounce time
+//  doesn't shrink when an input is chattering.
+bool inputWakePending()
+{
+  return (XCADE_INPUT_INT_PIN >= 0) && inputChanged && (0 == inputSamplesPending);
+}
+
+// True if this loop needs to read the inputs
+bool inputReadNeeded(uint32_t currentTime)
+{
+  if (XCADE_INPUT_INT_PIN < 0)
+    return true;
+
+  // /INT is level, so also catch a change that's still being held
+  if (inputChanged || !digitalRead(XCADE_INPUT_INT_PIN))
+  {
+    inputChanged = false;
+    inputSamplesPending = INPUT_DEBOUNCE_SAMPLES;
+    return true;
+  }
+
+  if (inputSamplesPending)
+  {
+    inputSamplesPending--;
+    return true;
+  }
+
+  return (((uint32_t)currentTime - lastInputReadTime) > INPUT_SAFETY_POLL_MS);
+}
+
+// Oscillator calibration.  The SHCP runs off its internal RC oscillator, so
+//  we write it marks spaced by our crystal and it trims itself to match,
+//  saving the result in its EEPROM.  Each mark is a full window so a few ms
+//  of loop jitter is well under the step size.
+#define CAL_WINDOW_MS 1000
+#define CAL_MAX_MARKS 20
+
+// Both go through shcpLink, so they find the SHCP wherever it is on the
+//  buses.  Writes are read back, so only for registers the SHCP doesn't
+//  change itself.
+bool shcpWriteReg(uint8_t reg, uint8_t data)
+{
+  return (XCADE_LINK_OK == shcpLink.writeVerified(reg, &data, 1));
+}
+
+bool shcpReadRegs(uint8_t reg, uint8_t* data, uint8_t len)
+{
+  return (XCADE_LINK_OK == shcpLink.read(reg, data, len));
+}
+
+void shcpCalibrate()
+{
+  uint8_t regs[SHCP_REG_CAL_RESIDUAL_H - SHCP_REG_OSCCAL + 1];
+  uint32_t markTime;
+  uint8_t mark;
+
+  Serial.printf("\nCalibrating SHCP oscillator, %u ms windows\n", CAL_WINDOW_MS);
+
+  // Nothing else runs until it's done, so hold the mux on the SHCP throughout
+  if (XCADE_LINK_OK != shcpLink.open())
+  {
+    Serial.println("SHCP not reachable");
+    return;
+  }
+  if (!shcpWriteReg(SHCP_REG_CAL_WINDOW, CAL_WINDOW_MS / 100) || !shcpWriteReg(SHCP_REG_CAL_MARK, 0))
+  {
+    Serial.println("SHCP not responding");
+    shcpLink.close();
+    return;
+  }
+
+  markTime = millis();
+  for (mark=1; mark<=CAL_MAX_MARKS; mark++)
+  {
+    while((uint32_t)(millis() - markTime) < CAL_WINDOW_MS);
+    markTime += CAL_WINDOW_MS;
+    // The SHCP goes by how far the mark moved, so one that didn't land just
+    //  makes the next window longer
+    if (!shcpWriteReg(SHCP_REG_CAL_MARK, mark))
+    {
+      Serial.printf("  mark %2u  not taken\n", mark);
+      continue;
+    }
+
+    // Give the SHCP a moment to act on the mark before asking how it went
+    delay(5);
+    if (!shcpReadRegs(SHCP_REG_OSCCAL, regs, sizeof(regs)))
+      continue;
+    Serial.printf("  mark %2u  OSCCAL 0x%02X  error %d ppm\n", mark, regs[0],
+      (int16_t)(regs[SHCP_REG_CAL_RESIDUAL_L - SHCP_REG_OSCCAL] | (regs[SHCP_REG_CAL_RESIDUAL_H - SHCP_REG_OSCCAL] << 8)));
+    if (SHCP_CAL_MEASURING != regs[SHCP_REG_CAL_STATUS - SHCP_REG_OSCCAL] && mark > 1)
+      break;
+  }
+  shcpWriteReg(SHCP_REG_CAL_MARK, 0);
+
+  if (shcpReadRegs(SHCP_REG_OSCCAL, regs, sizeof(regs)))
+  {
+    Serial.printf("%s, OSCCAL 0x%02X, residual %d ppm\n",
+      (SHCP_CAL_DONE == regs[SHCP_REG_CAL_STATUS - SHCP_REG_OSCCAL])?"Calibrated":"Calibration failed", regs[0],
+      (int16_t)(regs[SHCP_REG_CAL_RESIDUAL_L - SHCP_REG_OSCCAL] | (regs[SHCP_REG_CAL_RESIDUAL_H - SHCP_REG_OSCCAL] << 8)));
+  }
+  shcpLink.close();
+}
+
+// Drain the SHCP's flight recorder, oldest first
+void shcpFlightDump()
+{
+  static const char* const eventNames[] = { "none", "reset", "aspect", "retarget", "done", "ca sense", "i2c error", "i2c recovery" };
+  uint8_t regs[SHCP_REG_FLIGHT_NEXT - SHCP_REG_FLIGHT_COUNT + 1];
+  uint8_t last[sizeof(regs)];
+  uint8_t entries = 0;
+  uint8_t waits = 0;
+  uint8_t resends = 0;
+  uint8_t next = 1;
+  bool advanced = false;
+  uint8_t caps;
+
+  Serial.println("\nSHCP flight recorder:");
+  // One session for the whole drain, so the mux only moves once
+  if (XCADE_LINK_OK != shcpLink.open())
+  {
+    Serial.println("SHCP not reachable");
+    return;
+  }
+  // Compiled out of the tiny48 build
+  if (shcpReadRegs(SHCP_REG_CAPABILITIES, &caps, 1) && !(caps & SHCP_CAP_FLIGHT_RECORDER))
+  {
+    Serial.println("Not in this build");
+    shcpLink.close();
+    return;
+  }
+  while(shcpReadRegs(SHCP_REG_FLIGHT_COUNT, regs, sizeof(regs)))
+  {
+    uint8_t event = regs[SHCP_REG_FLIGHT_EVENT - SHCP_REG_FLIGHT_COUNT];
+
+    // NEXT not cleared yet, the SHCP hasn't put the next one up
+    if (regs[SHCP_REG_FLIGHT_NEXT - SHCP_REG_FLIGHT_COUNT])
+    {
+      if (++waits > 100)
+        break;
+      delay(1);
+      continue;
+    }
+    waits = 0;
+
+    // The SHCP clears NEXT itself, so it can't be read back.  Instead, the
+    //  same entry still up with the same count means it never got there.
+    if (advanced && 0 == memcmp(regs, last, sizeof(regs)))
+    {
+      if (++resends > 3 || XCADE_LINK_OK != shcpLink.write(SHCP_REG_FLIGHT_NEXT, &next, 1))
+        break;
+      continue;
+    }
+    advanced = false;
+    resends = 0;
+
+    if (0 == regs[0])
+    {
+      Serial.printf("%u entries, %u dropped\n", entries, regs[SHCP_REG_FLIGHT_DROPPED - SHCP_REG_FLIGHT_COUNT]);
+      shcpLink.close();
+      return;
+    }
+
+    Serial.printf("  frame %3u  head %u  %-12s 0x%02X\n", regs[SHCP_REG_FLIGHT_FRAME - SHCP_REG_FLIGHT_COUNT], SHCP_FLIGHT_HEAD(event),
+      (SHCP_FLIGHT_EVENT(event) < sizeof(eventNames)/sizeof(eventNames[0]))?eventNames[SHCP_FLIGHT_EVENT(event)]:"?",
+      regs[SHCP_REG_FLIGHT_VALUE - SHCP_REG_FLIGHT_COUNT]);
+    entries++;
+    memcpy(last, regs, sizeof(regs));
+    if (XCADE_LINK_OK != shcpLink.write(SHCP_REG_FLIGHT_NEXT, &next, 1))
+      break;
+    advanced = true;
+  }
+  shcpLink.close();
+  Serial.println("SHCP not responding");
+}
+
+// Every SHCP register page, one line each, 0xFF past the end of the page.
+//  Each page is read starting at PAGE_SELECT and running on into the window,
+//  so the same read that returns the page says which one it is.
+void shcpPageDump()
+{
+  static const char* const pageNames[SHCP_PAGES] = { "build", "aspects", "outputs", "options", "rules", "osccal", "flash" };
+  uint8_t regs[SHCP_PAGE_WINDOW - SHCP_REG_PAGE_SELECT + SHCP_PAGE_MAX];
+  const uint8_t* page = &regs[SHCP_PAGE_WINDOW - SHCP_REG_PAGE_SELECT];
+
+  Serial.println("\nSHCP register pages:");
+  if (XCADE_LINK_OK != shcpLink.open())
+  {
+    Serial.println("SHCP not reachable");
+    return;
+  }
+  for (uint8_t p=0; p<SHCP_PAGES; p++)
+  {
+    if (XCADE_LINK_OK != shcpLink.write(SHCP_REG_PAGE_SELECT, &p, 1) || !shcpReadRegs(SHCP_REG_PAGE_SELECT, regs, sizeof(regs)))
+    {
+      Serial.println("SHCP not responding");
+      break;
+    }
+    Serial.printf("  %-8s", pageNames[p]);
+    if (p != regs[0])
+    {
+      Serial.printf(" page select didn't take\n");
+      continue;
+    }
+    for (uint8_t i=0; i<SHCP_PAGE_MAX; i++)
+      Serial.printf(" %02X", page[i]);
+    Serial.printf("\n");
+  }
+  shcpLink.close();
+}
+
 void setup() 
 {
   Serial.begin(115200);
   Serial.println("Startup");
 
   Wire.setPins(XCADE_I2C_SDA, XCADE_I2C_SCL);
-  Wire.setClock(100000);
+  Wire.setClock(STRESS_TEST_MODE?STRESS_I2C_CLOCK:100000);
   Wire.begin();
 
   wireMux.begin(&Wire);
 
+  dualBusBegin();
+  discoveryBegin();
+  linkBegin();
+
   xcade.begin(&wireMux);
+
+  inputDebounceBegin();
+  dualBusDebounceBegin();
+  inputWakeBegin();
+  canBegin();
+  loopTimingBegin(LOOP_UPDATE_TIME_MS);
+  latencyProbeBegin(&shcpLink);
+
+  if (STRESS_TEST_MODE)
+    stressTestStart();
+}
+
+// Set to true to skip the operator-driven sensor, GPIO and DIP switch
+//  tests and go straight to the automated port tests
+#define PORT_TEST_ONLY false
+#define PORT_TEST_REPEATS 1
+#define PORT_TEST_TIMEOUT_MS 2000
+
+#define PORT_A 0
+#define PORT_B 1
+#define PORT_C 2
+#define PORT_D 3
+
+typedef decltype(xcade.mssPortA) XCadeMSSPort;
+typedef decltype(xcade.mssPortA.indicationReceivedGet()) XCadeIndication;
+
+// One record per test step.  The stimulus is applied to fromPort, then we
+//  poll every loop until both ports show what we expect or we time out.
+typedef struct
+{
+  const char* direction;
+  const char* name;
+  uint8_t fromPort;
+  uint8_t toPort;
+  bool resetPair;
+  bool occupied;
+  XCadeIndication cascade;
+  bool diverging;
+  XCadeIndication expectFrom;
+  XCadeIndication expectTo;
+} PortTestStep;
+
+#define PORT_TEST_DIRECTION(dir, from, to) \
+  { dir, "CLEAR",              from, to, true,  false, INDICATION_CLEAR,    false, INDICATION_CLEAR, INDICATION_CLEAR }, \
+  { dir, "APPROACH",           from, to, false, false, INDICATION_STOP,     false, INDICATION_CLEAR, INDICATION_APPROACH }, \
+  { dir, "ADVANCE_APPROACH",   from, to, false, false, INDICATION_APPROACH, false, INDICATION_CLEAR, INDICATION_ADVANCE_APPROACH }, \
+  { dir, "APPROACH_DIVERGING", from, to, false, false, INDICATION_CLEAR,    true,  INDICATION_CLEAR, INDICATION_APPROACH_DIVERGING }, \
+  { dir, "STOP",               from, to, false, true,  INDICATION_CLEAR,    false, INDICATION_STOP,  INDICATION_STOP }
+
+const PortTestStep portTestSteps[] =
+{
+  PORT_TEST_DIRECTION("A->B", PORT_A, PORT_B),
+  PORT_TEST_DIRECTION("B->A", PORT_B, PORT_A),
+  PORT_TEST_DIRECTION("C->D", PORT_C, PORT_D),
+  PORT_TEST_DIRECTION("D->C", PORT_D, PORT_C)
+};
+
+#define PORT_TEST_NUM_STEPS (sizeof(portTestSteps)/sizeof(portTestSteps[0]))
+
+typedef struct
+{
+  uint32_t minMs;
+  uint32_t maxMs;
+  uint32_t totalMs;
+  uint16_t passes;
+  uint16_t failures;
+} PortTestResult;
+
+PortTestResult portTestResults[PORT_TEST_NUM_STEPS];
+uint32_t portTestStep = 0;
+uint32_t portTestRepeat = 0;
+uint32_t portTestStepStart = 0;
+uint32_t portTestLoops = 0;
+uint32_t portTestFailures = 0;
+
+XCadeMSSPort* portTestPort(uint8_t port)
+{
+  switch(port)
+  {
+    case PORT_A: return &xcade.mssPortA;
+    case PORT_B: return &xcade.mssPortB;
+    case PORT_C: return &xcade.mssPortC;
+    case PORT_D: 
+    default:     return &xcade.mssPortD;
+  }
+}
+
+void portTestApply(const PortTestStep* step, uint32_t currentTime)
+{
+  XCadeMSSPort* from = portTestPort(step->fromPort);
+
+  if (step->resetPair)
+  {
+    XCadeMSSPort* to = portTestPort(step->toPort);
+    to->setLocalOccupancy(false);
+    canOccupancy &= ~(1 << step->toPort);
+    to->cascadeFromIndication(INDICATION_CLEAR, false);
+  }
+
+  from->setLocalOccupancy(step->occupied);
+  canOccupancy = (canOccupancy & ~(1 << step->fromPort)) | ((step->occupied?1:0) << step->fromPort);
+  from->cascadeFromIndication(step->cascade, step->diverging);
+  portTestStepStart = currentTime;
+  portTestLoops = 0;
+}
+
+void portTestStart(uint32_t currentTime)
+{
+  for (uint32_t i=0; i<PORT_TEST_NUM_STEPS; i++)
+  {
+    portTestResults[i].minMs = UINT32_MAX;
+    portTestResults[i].maxMs = portTestResults[i].totalMs = 0;
+    portTestResults[i].passes = portTestResults[i].failures = 0;
+  }
+  portTestStep = portTestRepeat = portTestFailures = 0;
+  portTestApply(&portTestSteps[0], currentTime);
+}
+
+void portTestReport()
+{
+  Serial.printf("\nPort test latency (%d run%s, %d ms loop)\n", PORT_TEST_REPEATS, (1 == PORT_TEST_REPEATS)?"":"s", LOOP_UPDATE_TIME_MS);
+  Serial.printf("Dir   Indication          Pass Fail  Min ms  Max ms  Avg ms\n");
+  for (uint32_t i=0; i<PORT_TEST_NUM_STEPS; i++)
+  {
+    const PortTestResult* r = &portTestResults[i];
+    Serial.printf("%-5s %-19s %4d %4d", portTestSteps[i].direction, portTestSteps[i].name, r->passes, r->failures);
+    if (r->passes)
+      Serial.printf("  %6" PRIu32 "  %6" PRIu32 "  %6" PRIu32 "\n", r->minMs, r->maxMs, r->totalMs / r->passes);
+    else
+      Serial.printf("       -       -       -\n");
+  }
+}
+
+// Call every loop, after updateInputs() and before updateOutputs()
+// Returns true once every step has run PORT_TEST_REPEATS times
+bool portTestRun(uint32_t currentTime)
+{
+  const PortTestStep* step = &portTestSteps[portTestStep];
+  PortTestResult* result = &portTestResults[portTestStep];
+  XCadeMSSPort* from = portTestPort(step->fromPort);
+  XCadeMSSPort* to = portTestPort(step->toPort);
+  uint32_t elapsed = currentTime - portTestStepStart;
+
+  portTestLoops++;
+
+  if (inputIndication(step->fromPort) == step->expectFrom && inputIndication(step->toPort) == step->expectTo)
+  {
+    result->passes++;
+    result->totalMs += elapsed;
+    result->minMs = min(result->minMs, elapsed);
+    result->maxMs = max(result->maxMs, elapsed);
+    Serial.printf("%s %s passed in %" PRIu32 " ms (%" PRIu32 " loops)\n", step->direction, step->name, elapsed, portTestLoops);
+  }
+  else if (elapsed > PORT_TEST_TIMEOUT_MS)
+  {
+    result->failures++;
+    portTestFailures++;
+    Serial.printf("%s %s failed after %" PRIu32 " ms\n", step->direction, step->name, elapsed);
+    Serial.printf("From: ");
+    from->printDebugStr();
+    Serial.printf("\nTo:   ");
+    to->printDebugStr();
+    Serial.printf("\n");
+  }
+  else
+    return false;
+
+  if (++portTestStep >= PORT_TEST_NUM_STEPS)
+  {
+    portTestStep = 0;
+    if (++portTestRepeat >= PORT_TEST_REPEATS)
+    {
+      portTestReport();
+      return true;
+    }
+  }
+
+  portTestApply(&portTestSteps[portTestStep], currentTime);
+  return false;
 }
 
 uint8_t aspect = 0;
-uint32_t testState = 0;
+uint8_t probeHead = 0;
+uint32_t testState = PORT_TEST_ONLY?20:0;
 uint32_t mask = 0;
 void loop() 
 {
@@ -53,23 +1143,85 @@ void loop()
   static uint32_t lastReadTime = 0;
   static uint32_t debugPrintfTime = 0;
 
+  if (STRESS_TEST_MODE)
+  {
+    stressTestRun();
+    return;
+  }
+
 	// Because debouncing needs some time between samples, don't go for a hideous update rate
   // 50mS or so between samples does nicely.  That gives a 200mS buffer for changes, which is more
-  // than enough for propagation delay
-	if (!(((uint32_t)currentTime - lastReadTime) > LOOP_UPDATE_TIME_MS))
+  // than enough for propagation delay.  An input change interrupt gets us in early.
+	if (!inputWakePending() && !(((uint32_t)currentTime - lastReadTime) > LOOP_UPDATE_TIME_MS))
     return;
 
 
   // Update the last time we ran through the loop to the current time
   lastReadTime = currentTime;
+  LOOP_TIMING_START();
 
 
   // Just blink the RGB LED once a second in a nice dim of blue, so that we know the board is alive
   rgbLedWrite(XCADE_RGB_LED, 0, ((currentTime % 1000) > 500)?16:0, 0);
 
-  // First, read the input state from the hardware
-  xcade.updateInputs();
+  // First, read the input state from the hardware, if anything could have changed.
+  //  Anything on Wire1 gets read at the same time.
+  if (inputReadNeeded(currentTime))
+  {
+    dualBusStart();
+    xcade.updateInputs();
+    dualBusFinish();
+    inputDebounceUpdate();
+    lastInputReadTime = currentTime;
+  }
   //xcadeExpander1.updateInputs();
+  LOOP_TIMING_PHASE_END(LOOP_PHASE_INPUTS);
+
+  if (LATENCY_PROBE_ENABLED)
+    latencyProbePoll(micros());
+
+  canUpdate(currentTime);
+
+  // 't' dumps the loop timing statistics, 'l' the aspect latencies, 'r' clears both,
+  //  'c' calibrates the SHCP oscillator, 'f' dumps the SHCP flight recorder,
+  //  'n' lists the CAN nodes, 'd' rediscovers what's on the buses, 'p' dumps
+  //  the SHCP register pages
+  if (Serial.available())
+  {
+    switch(Serial.read())
+    {
+      case 't':
+        loopTimingPrint();
+        break;
+      case 'l':
+        latencyProbePrint();
+        break;
+      case 'r':
+        loopTimingReset();
+        latencyProbeBegin(&shcpLink);
+        break;
+      case 'c':
+        shcpCalibrate();
+        break;
+      case 'f':
+        shcpFlightDump();
+        break;
+      case 'n':
+        canPrint(currentTime);
+        break;
+      case 'd':
+        discoveryRun(false);
+        dualBusDebounceBegin();
+        discoveryPrint();
+        break;
+      case 'p':
+        shcpPageDump();
+        break;
+    }
+  }
+
+  if (21 == testState && portTestRun(currentTime))
+    testState = 22;
 
 
   if ((((uint32_t)currentTime - debugPrintfTime) > DEBUG_UPDATE_TIME_MS))
@@ -87,6 +1239,10 @@ void loop()
     xcade.signals.C2.setAspect((SignalAspect_t)aspect);
     xcade.signals.D2.setAspect((SignalAspect_t)aspect);
 
+    // Every head just changed, so take turns probing them
+    if (LATENCY_PROBE_ENABLED && latencyProbeAspectSet(probeHead, aspect, micros()))
+      probeHead = (probeHead + 1) % SHCP_NUM_HEADS;
+
 
 /*    Serial.printf("\n\nPort 1.A - ");
     xcade.mssPortA.printDebugStr();
@@ -107,18 +1263,25 @@ void loop()
 
       case 1:
         Serial.printf("S1=[%c] S2=[%c] S3=[%c] S4=[%c] S5=[%c] S6=[%c] S7=[%c] S8=[%c] S9=[%c] S10=[%c]\n",
-          xcade.gpio.digitalRead(SENSOR_1_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_2_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_3_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_4_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_5_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_6_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_7_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_8_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_9_PIN)?'*':' ',
-          xcade.gpio.digitalRead(SENSOR_10_PIN)?'*':' ');
-
-        if (xcade.gpio.digitalRead(SENSOR_10_PIN))
+          inputSensor(1)?'*':' ',
+          inputSensor(2)?'*':' ',
+          inputSensor(3)?'*':' ',
+          inputSensor(4)?'*':' ',
+          inputSensor(5)?'*':' ',
+          inputSensor(6)?'*':' ',
+          inputSensor(7)?'*':' ',
+          inputSensor(8)?'*':' ',
+          inputSensor(9)?'*':' ',
+          inputSensor(10)?'*':' ');
+        if (dualBusEnabled())
+        {
+          Serial.printf("  Wire1");
+          for (uint8_t i=0; i<dualBusNumDevices; i++)
+            Serial.printf(" E%u=[%04X]", i + 1, (unsigned int)((dualBusDebounce.debounced() >> (16 * i)) & 0xFFFF));
+          Serial.printf("  %" PRIu32 " errors\n", dualBusErrors);
+        }
+
+        if (inputSensor(10))
           testState = 10;
         break;
 
@@ -129,14 +1292,14 @@ void loop()
 
       case 11:
         Serial.printf("G1=[%d] G2=[%d] G3=[%d] G4=[%d] G5=[%d] G6=[%d]\n",
-          xcade.gpio.digitalRead(1),
-          xcade.gpio.digitalRead(2),
-          xcade.gpio.digitalRead(3),
-          xcade.gpio.digitalRead(4),
-          xcade.gpio.digitalRead(5),
-          xcade.gpio.digitalRead(6));
-
-        if (!xcade.gpio.digitalRead(6))
+          inputGpio(1),
+          inputGpio(2),
+          inputGpio(3),
+          inputGpio(4),
+          inputGpio(5),
+          inputGpio(6));
+
+        if (!inputGpio(6))
           testState = 15;
 
         break;
@@ -165,641 +1328,36 @@ void loop()
 
 
       case 20:
-        Serial.printf("Port A/B Test\nPress Enter When Ready\n");
-        if (!Serial.available())
-          break;
-
-        while(Serial.available())
-          Serial.read();
+        // The port tests are table driven and run every loop from portTestRun()
+        //  Both loopback cables (A to B, C to D) must be fitted
+        Serial.printf("Port A/B/C/D Test\n");
+        portTestStart(currentTime);
         testState = 21;
-        mask = 4;
-        Serial.printf("Testing A->B Cleared\n");
-        xcade.mssPortA.setLocalOccupancy(false);
-        xcade.mssPortA.cascadeFromIndication(INDICATION_CLEAR, false);
-        xcade.mssPortB.setLocalOccupancy(false);
-        xcade.mssPortB.cascadeFromIndication(INDICATION_CLEAR, false);
         break;
 
       case 21:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        mask = 4;
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port A not clear, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port B not clear, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
         break;
 
       case 22:
-        Serial.printf("Testing A->B A\n");
-        xcade.mssPortA.cascadeFromIndication(INDICATION_STOP, false);
+        Serial.printf("Testing %s\n", portTestFailures?"failed":"passed");
         testState = 23;
-        mask = 4;
-        break;
-      
-      case 23:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        mask = 4;
-
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port A not clear, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_APPROACH)
-        {
-          Serial.printf("Port B not receiving approach, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 24:
-        Serial.printf("Testing A->B AA\n");
-        xcade.mssPortA.cascadeFromIndication(INDICATION_APPROACH, false);
-        testState = 25;
-        mask = 4;
-        break;
-      
-      case 25:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        mask = 4;
-
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port A not clear, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_ADVANCE_APPROACH)
-        {
-          Serial.printf("Port B not receiving adv approach, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-
-        break;
-
-      case 26:
-        Serial.printf("Testing A->B DA\n");
-        xcade.mssPortA.cascadeFromIndication(INDICATION_CLEAR, true);
-        testState = 27;
-        mask = 4;
-        break;
-      
-      case 27:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        mask = 4;
-
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port A not clear, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_APPROACH_DIVERGING)
-        {
-          Serial.printf("Port B not receiving div approach, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
         break;
 
-      case 28:
-        Serial.printf("Testing A->B S\n");
-        xcade.mssPortA.setLocalOccupancy(true);
-        xcade.mssPortA.cascadeFromIndication(INDICATION_CLEAR, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 29:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        mask = 4;
-
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port A not receiving stop, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port B not receiving stop, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 30:
-        testState++;
-        mask = 4;
-        Serial.printf("Testing B->A Cleared\n");
-        xcade.mssPortA.setLocalOccupancy(false);
-        xcade.mssPortA.cascadeFromIndication(INDICATION_CLEAR, false);
-        xcade.mssPortB.setLocalOccupancy(false);
-        xcade.mssPortB.cascadeFromIndication(INDICATION_CLEAR, false);
-        break;
-
-      case 31:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        mask = 4;
-
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port A not clear, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port B not clear, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 32:
-        Serial.printf("Testing B->A A\n");
-        xcade.mssPortB.cascadeFromIndication(INDICATION_STOP, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 33:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortB.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port B not clear, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortA.indicationReceivedGet() != INDICATION_APPROACH)
-        {
-          Serial.printf("Port A not receiving approach, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 34:
-        Serial.printf("Testing B->A AA\n");
-        xcade.mssPortB.cascadeFromIndication(INDICATION_APPROACH, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 35:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortB.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port B not clear, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortA.indicationReceivedGet() != INDICATION_ADVANCE_APPROACH)
-        {
-          Serial.printf("Port A not receiving adv approach, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 36:
-        Serial.printf("Testing B->A DA\n");
-        xcade.mssPortB.cascadeFromIndication(INDICATION_CLEAR, true);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 37:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortB.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port B not clear, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortA.indicationReceivedGet() != INDICATION_APPROACH_DIVERGING)
-        {
-          Serial.printf("Port A not receiving div approach, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 38:
-        Serial.printf("Testing B->A S\n");
-        xcade.mssPortB.setLocalOccupancy(true);
-        xcade.mssPortB.cascadeFromIndication(INDICATION_CLEAR, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 39:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortA.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port A not receiving stop, fail\n");
-          xcade.mssPortA.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortB.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port B not receiving stop, fail\n");
-          xcade.mssPortB.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      // Switch to C/D ports
-      case 40:
-        Serial.printf("Port C/D Test\nPress Enter When Ready\n");
-        if (!Serial.available())
-          break;
-
-        while(Serial.available())
-          Serial.read();
-        testState++;
-        mask = 4;
-        Serial.printf("Testing C->D Cleared\n");
-
-        xcade.mssPortC.setLocalOccupancy(false);
-        xcade.mssPortC.cascadeFromIndication(INDICATION_CLEAR, false);
-        xcade.mssPortD.setLocalOccupancy(false);
-        xcade.mssPortD.cascadeFromIndication(INDICATION_CLEAR, false);
-        break;
-
-      case 41:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port C not clear, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port D not clear, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 42:
-        Serial.printf("Testing C->D A\n");
-        xcade.mssPortC.cascadeFromIndication(INDICATION_STOP, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 43:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port C not clear, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_APPROACH)
-        {
-          Serial.printf("Port D not receiving approach, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 44:
-        Serial.printf("Testing C->D AA\n");
-        xcade.mssPortC.cascadeFromIndication(INDICATION_APPROACH, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 45:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port C not clear, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_ADVANCE_APPROACH)
-        {
-          Serial.printf("Port D not receiving adv approach, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 46:
-        Serial.printf("Testing C->D DA\n");
-        xcade.mssPortC.cascadeFromIndication(INDICATION_CLEAR, true);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 47:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port C not clear, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_APPROACH_DIVERGING)
-        {
-          Serial.printf("Port D not receiving div approach, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 48:
-        Serial.printf("Testing C->D S\n");
-        xcade.mssPortC.setLocalOccupancy(true);
-        xcade.mssPortC.cascadeFromIndication(INDICATION_CLEAR, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 49:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port C not receiving stop, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port D not receiving stop, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 50:
-        testState++;
-        mask = 4;
-        Serial.printf("Testing D->C Cleared\n");
-
-        xcade.mssPortC.setLocalOccupancy(false);
-        xcade.mssPortC.cascadeFromIndication(INDICATION_CLEAR, false);
-        xcade.mssPortD.setLocalOccupancy(false);
-        xcade.mssPortD.cascadeFromIndication(INDICATION_CLEAR, false);
-        break;
-
-      case 51:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-        
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port C not clear, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port D not clear, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 52:
-        Serial.printf("Testing D->C A\n");
-        xcade.mssPortD.cascadeFromIndication(INDICATION_STOP, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 53:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortD.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port D not clear, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortC.indicationReceivedGet() != INDICATION_APPROACH)
-        {
-          Serial.printf("Port C not receiving approach, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 54:
-        Serial.printf("Testing D->C AA\n");
-        xcade.mssPortD.cascadeFromIndication(INDICATION_APPROACH, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 55:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortD.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port D not clear, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortC.indicationReceivedGet() != INDICATION_ADVANCE_APPROACH)
-        {
-          Serial.printf("Port C not receiving adv approach, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 56:
-        Serial.printf("Testing D->C DA\n");
-        xcade.mssPortD.cascadeFromIndication(INDICATION_CLEAR, true);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 57:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortD.indicationReceivedGet() != INDICATION_CLEAR)
-        {
-          Serial.printf("Port D not clear, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortC.indicationReceivedGet() != INDICATION_APPROACH_DIVERGING)
-        {
-          Serial.printf("Port C not receiving div approach, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 58:
-        Serial.printf("Testing D->C S\n");
-        xcade.mssPortD.setLocalOccupancy(true);
-        xcade.mssPortD.cascadeFromIndication(INDICATION_CLEAR, false);
-        testState++;
-        mask = 4;
-        break;
-      
-      case 59:
-        // Wait 4 cycles;
-        if (mask-- > 0)
-          break;
-
-        mask = 4;
-
-        if (xcade.mssPortC.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port C not receiving stop, fail\n");
-          xcade.mssPortC.printDebugStr();
-          Serial.printf("\n");
-        } else if (xcade.mssPortD.indicationReceivedGet() != INDICATION_STOP)
-        {
-          Serial.printf("Port D not receiving stop, fail\n");
-          xcade.mssPortD.printDebugStr();
-          Serial.printf("\n");
-        } else {
-          Serial.printf("Passed\n");
-          testState++;
-        }
-        break;
-
-      case 60:
-        Serial.printf("Testing passed\n");
+      case 23:
         break;
 
-
     }
 
   }
 
 
+  LOOP_TIMING_PHASE_END(LOOP_PHASE_LOGIC);
+
   // Now that all state is computed, send the outputs to the hardware
+  if (LATENCY_PROBE_ENABLED)
+    latencyProbeSend();
   xcade.updateOutputs();
 //  xcadeExpander1.updateOutputs();
+  LOOP_TIMING_PHASE_END(LOOP_PHASE_OUTPUTS);
+  LOOP_TIMING_END();
 }
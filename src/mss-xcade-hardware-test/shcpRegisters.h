@@ -0,0 +1,157 @@
+/*************************************************************************
+Title:    I2C-SHCP Register Map (master side)
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     shcpRegisters.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _SHCP_REGISTERS_H_
+#define _SHCP_REGISTERS_H_
+
+// Must match the I2CREG_* definitions in src/i2c-shcp/i2c-shcp.c
+
+#define SHCP_I2C_ADDR 0x40
+#define SHCP_NUM_HEADS 8
+
+// Frames are 32 PWM steps of the 4kHz timer
+#define SHCP_FRAME_US 8000
+
+#define SHCP_REG_ASPECTS_BASE       0
+#define SHCP_REG_OPTIONS_BASE       8
+#define SHCP_REG_PROBE_CONTROL     16
+#define SHCP_REG_PROBE_LATCHED     17
+#define SHCP_REG_PROBE_LATCH_FRAME 18
+#define SHCP_REG_PROBE_OUTPUT      19
+#define SHCP_REG_PROBE_OUTPUT_FRAME 20
+#define SHCP_REG_FRAME_COUNTER     21
+#define SHCP_REG_INDICATION_BASE   22
+#define SHCP_REG_I2C_RECOVERIES    26
+#define SHCP_REG_OSCCAL            27
+#define SHCP_REG_CAL_MARK          28
+#define SHCP_REG_CAL_WINDOW        29
+#define SHCP_REG_CAL_STATUS        30
+#define SHCP_REG_CAL_RESIDUAL_L    31
+#define SHCP_REG_CAL_RESIDUAL_H    32
+#define SHCP_REG_STACK_USED        33
+#define SHCP_REG_STACK_FREE        34
+#define SHCP_REG_FLASH_PERIOD      35
+#define SHCP_REG_FLASH_ON          36
+#define SHCP_REG_FLASH_PHASE       37
+#define SHCP_REG_BOOTLOADER        38
+#define SHCP_REG_FLIGHT_COUNT      39
+#define SHCP_REG_FLIGHT_DROPPED    40
+#define SHCP_REG_FLIGHT_FRAME      41
+#define SHCP_REG_FLIGHT_EVENT      42
+#define SHCP_REG_FLIGHT_VALUE      43
+#define SHCP_REG_FLIGHT_NEXT       44
+// Bit n set dithers head n
+#define SHCP_REG_DITHER            45
+#define SHCP_REG_FRAME_SEQ         46
+#define SHCP_REG_FRAME_GOOD        47
+#define SHCP_REG_FRAME_REJECTS     48
+#define SHCP_REG_ID                49
+#define SHCP_REG_FW_VERSION        50
+#define SHCP_REG_CAPABILITIES      51
+#define SHCP_REG_PAGE_SELECT       52
+#define SHCP_REG_FLASH_PROFILE     53
+
+// Write to SHCP_REG_BOOTLOADER to start the I2C bootloader, see
+//  src/i2c-shcp/bootloader.h and src/shcp-boot
+#define SHCP_BOOTLOADER_ENTER  0xB0
+
+// SHCP_REG_ID always reads this, the capabilities are bits
+#define SHCP_ID                      0x5C
+#define SHCP_CAP_FRAMED_WRITES       0x01
+#define SHCP_CAP_FLIGHT_RECORDER     0x02
+#define SHCP_CAP_BOOTLOADER          0x04
+#define SHCP_CAP_DITHER              0x08
+#define SHCP_CAP_PAGES               0x10
+
+// Register pages, see src/i2c-shcp/avr-i2c-slave.h.  Write the page number to
+//  SHCP_REG_PAGE_SELECT, then read from SHCP_PAGE_WINDOW.  Past the end of a
+//  page reads 0xFF.
+#define SHCP_PAGE_WINDOW          0x40
+#define SHCP_PAGE_MAX               32
+#define SHCP_PAGE_BUILD              0   // ID, version, heads, flight entries, frame max, page max, aspects, indications
+#define SHCP_PAGE_HEAD_ASPECTS       1   // One byte a head
+#define SHCP_PAGE_HEAD_OUTPUTS       2   // Phase, red, yellow, green PWM, 4 bytes a head
+#define SHCP_PAGE_HEAD_OPTIONS       3   // One byte a head
+#define SHCP_PAGE_INDICATION_RULES   4   // EEPROM rule set
+#define SHCP_PAGE_OSCCAL_SAVED       5   // EEPROM
+#define SHCP_PAGE_FLASH_PROFILES     6   // Period, on, phase, 3 bytes a profile
+#define SHCP_PAGES                   7
+
+// Framed writes, see src/i2c-shcp/avr-i2c-slave.h.  OR into the register
+//  byte and follow the data with a sequence number and the CRC-8 (polynomial
+//  0x07) of everything before it.
+#define SHCP_FRAME_FLAG           0x80
+
+// Flight recorder, see src/i2c-shcp/flightRecorder.h
+#define SHCP_FLIGHT_EVENT(e)      ((e)>>3)
+#define SHCP_FLIGHT_HEAD(e)       ((e) & 0x07)
+#define SHCP_FLIGHT_RESET         1
+#define SHCP_FLIGHT_ASPECT        2
+#define SHCP_FLIGHT_RETARGET      3
+#define SHCP_FLIGHT_DONE          4
+#define SHCP_FLIGHT_CA_SENSE      5
+#define SHCP_FLIGHT_I2C_ERROR     6
+#define SHCP_FLIGHT_I2C_RECOVERY  7
+
+#define SHCP_CAL_IDLE       0
+#define SHCP_CAL_MEASURING  1
+#define SHCP_CAL_DONE       2
+#define SHCP_CAL_FAILED     3
+
+// Head type, OR into a head's options register.  See src/i2c-shcp/colorMix.h
+#define SHCP_OPTION_SEARCHLIGHT   0x01
+#define SHCP_MIX_LAMP_PER_COLOR   0
+#define SHCP_MIX_RGB              1
+#define SHCP_MIX_EEPROM           2
+#define SHCP_OPTION_MIX(set)      (((set) & 0x03)<<1)
+
+// Flash timing, OR into a head's options register.  See src/i2c-shcp/flasher.h
+#define SHCP_FLASH_STANDARD   0
+#define SHCP_FLASH_CROSSING   1
+#define SHCP_FLASH_FAST       2
+#define SHCP_FLASH_CUSTOM     3
+#define SHCP_OPTION_FLASH(profile, alternate)  ((((profile) & 0x03) | ((alternate)?0x04:0))<<3)
+// Any of the four can be retimed: write period, on and phase (8ms frames) to
+//  SHCP_REG_FLASH_PERIOD-PHASE, then SHCP_FLASH_PROFILE_LOAD | profile to
+//  SHCP_REG_FLASH_PROFILE.  A zero period puts the profile back as it was.
+#define SHCP_FLASH_PROFILE_LOAD  0x80
+
+#define SHCP_PROBE_HEAD_MASK  0x07
+#define SHCP_PROBE_SEQ_SHIFT  3
+
+// Indication registers, one per signal (A-D), see src/i2c-shcp/indicationRules.h
+#define SHCP_INDICATION_STOP                0
+#define SHCP_INDICATION_APPROACH            1
+#define SHCP_INDICATION_ADVANCE_APPROACH    2
+#define SHCP_INDICATION_APPROACH_DIVERGING  3
+#define SHCP_INDICATION_CLEAR               4
+
+#define SHCP_RULES_SINGLE_HEAD  0
+#define SHCP_RULES_TWO_HEAD     1
+#define SHCP_RULES_SEARCHLIGHT  2
+#define SHCP_RULES_EEPROM       3
+
+#define SHCP_INDICATION(rules, indication)  (0x80 | (((rules) & 0x07)<<4) | ((indication) & 0x0F))
+#define SHCP_INDICATION_OFF  0x00
+
+#endif
@@ -0,0 +1,222 @@
+/*************************************************************************
+Title:    XCade Dual I2C Bus Scheduler
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeBus.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include "xcadeBus.h"
+
+#define CHANNEL_UNKNOWN 0xFE
+
+XCadeBusScheduler::XCadeBusScheduler()
+{
+	for (uint8_t b=0; b<XCADE_BUS_MAX; b++)
+	{
+		buses[b] = NULL;
+		queueLen[b] = 0;
+		muxSwitches[b] = errors[b] = 0;
+	}
+	workerPending = workerQuit = workerStarted = false;
+}
+
+XCadeBusScheduler::~XCadeBusScheduler()
+{
+	if (workerThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			workerQuit = true;
+		}
+		wake.notify_all();
+		workerThread.join();
+	}
+}
+
+void XCadeBusScheduler::begin(XCadeBus* bus0, XCadeBus* bus1)
+{
+	buses[0] = bus0;
+	buses[1] = bus1;
+	clear();
+
+	if (NULL != bus1 && !workerThread.joinable())
+		workerThread = std::thread(&XCadeBusScheduler::worker, this);
+}
+
+void XCadeBusScheduler::clear()
+{
+	for (uint8_t b=0; b<XCADE_BUS_MAX; b++)
+		queueLen[b] = 0;
+}
+
+bool XCadeBusScheduler::add(XCadeBusJob* job)
+{
+	uint8_t bus = (job->bus > 0 && NULL != buses[1])?1:0;
+
+	if (queueLen[bus] >= XCADE_BUS_MAX_JOBS)
+		return false;
+
+	// Keep each queue grouped by mux channel so a channel only gets
+	//  selected once per pass.  Insertion keeps the order within a channel.
+	uint8_t i = queueLen[bus]++;
+	while (i > 0 && queue[bus][i-1]->channel > job->channel)
+	{
+		queue[bus][i] = queue[bus][i-1];
+		i--;
+	}
+	queue[bus][i] = job;
+	return true;
+}
+
+void XCadeBusScheduler::runQueue(uint8_t bus)
+{
+	XCadeBus* b = buses[bus];
+	bool ok = true;
+
+	// Somebody else may have moved the mux since last time
+	selectedChannel[bus] = CHANNEL_UNKNOWN;
+
+	for (uint8_t i=0; i<queueLen[bus]; i++)
+	{
+		XCadeBusJob* job = queue[bus][i];
+
+		if (XCADE_MUX_NONE != job->channel && job->channel != selectedChannel[bus])
+		{
+			muxSwitches[bus]++;
+			if (!b->muxSelect(job->channel))
+			{
+				selectedChannel[bus] = CHANNEL_UNKNOWN;
+				job->ok = ok = false;
+				errors[bus]++;
+				continue;
+			}
+			selectedChannel[bus] = job->channel;
+		}
+
+		if (job->read)
+			job->ok = b->read(job->addr, job->reg, job->data, job->len);
+		else
+			job->ok = b->write(job->addr, job->reg, job->data, job->len);
+
+		if (!job->ok)
+		{
+			ok = false;
+			errors[bus]++;
+		}
+	}
+	queueOk[bus] = ok;
+}
+
+void XCadeBusScheduler::worker()
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	while(1)
+	{
+		wake.wait(guard, [this]{ return workerPending || workerQuit; });
+		if (workerQuit)
+			return;
+
+		guard.unlock();
+		runQueue(1);
+		guard.lock();
+
+		workerPending = false;
+		wake.notify_all();
+	}
+}
+
+// Returns false if there was nothing on bus 1 to start
+bool XCadeBusScheduler::start()
+{
+	workerStarted = (NULL != buses[1] && queueLen[1] > 0);
+
+	if (workerStarted)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		workerPending = true;
+		wake.notify_all();
+	}
+	return workerStarted;
+}
+
+// Returns true if everything start() set going went through
+bool XCadeBusScheduler::finish()
+{
+	if (!workerStarted)
+		return true;
+
+	std::unique_lock<std::mutex> guard(lock);
+	wake.wait(guard, [this]{ return !workerPending; });
+	workerStarted = false;
+	return queueOk[1];
+}
+
+// Runs everything queued on both buses at once, returns when both are done
+bool XCadeBusScheduler::run()
+{
+	start();
+	runQueue(0);
+	return finish() && queueOk[0];
+}
+
+uint32_t XCadeBusScheduler::estimateUs(const XCadeBusJob* job, uint8_t bus)
+{
+	// 9 clocks per byte including the ACK, plus a couple for start/stop
+	uint32_t clocks = 9 * (2 + job->len) + 2;
+	uint32_t hz = (NULL != buses[bus])?buses[bus]->clockHz():100000;
+
+	if (job->read)
+		clocks += 9 + 2;   // Repeated start and address for the read half
+
+	return (uint32_t)(((uint64_t)clocks * 1000000 + hz - 1) / hz);
+}
+
+void XCadeBusScheduler::plan(XCadeBusJob* jobs, uint8_t numJobs)
+{
+	uint32_t load[XCADE_BUS_MAX] = {0, 0};
+	bool placed[XCADE_BUS_MAX_JOBS];
+
+	for (uint8_t i=0; i<numJobs && i<XCADE_BUS_MAX_JOBS; i++)
+	{
+		placed[i] = (XCADE_BUS_AUTO != jobs[i].bus);
+		if (placed[i])
+			load[(jobs[i].bus > 0)?1:0] += estimateUs(&jobs[i], (jobs[i].bus > 0)?1:0);
+	}
+
+	// Biggest first, each onto whichever bus is lighter at the time
+	while(1)
+	{
+		int16_t biggest = -1;
+		uint8_t bus;
+
+		for (uint8_t i=0; i<numJobs && i<XCADE_BUS_MAX_JOBS; i++)
+		{
+			if (!placed[i] && (biggest < 0 || estimateUs(&jobs[i], 0) > estimateUs(&jobs[biggest], 0)))
+				biggest = i;
+		}
+		if (biggest < 0)
+			break;
+
+		bus = (NULL != buses[1] && load[1] < load[0])?1:0;
+		jobs[biggest].bus = bus;
+		load[bus] += estimateUs(&jobs[biggest], bus);
+		placed[biggest] = true;
+	}
+}
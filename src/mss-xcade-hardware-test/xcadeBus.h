@@ -0,0 +1,114 @@
+/*************************************************************************
+Title:    XCade Dual I2C Bus Scheduler
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeBus.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_BUS_H_
+#define _XCADE_BUS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Nothing in here touches Arduino, so the same scheduler runs against
+//  TwoWire on the ESP32 (xcadeBusWire.h) and stub buses on Linux
+//  (src/xcade-bus-bench)
+
+#define XCADE_BUS_MAX         2
+#define XCADE_BUS_AUTO       -1
+#define XCADE_MUX_NONE     0xFF
+#define XCADE_BUS_MAX_JOBS  128
+
+// PCA9546 mux, one bit per downstream channel in its control register
+#define XCADE_BUS_MUX_ADDR 0x70
+#define XCADE_BUS_MUX_CHANNELS 4
+
+class XCadeBus
+{
+	public:
+		virtual ~XCadeBus() {}
+		virtual bool muxSelect(uint8_t channel) = 0;
+		virtual bool write(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t len) = 0;
+		virtual bool read(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len) = 0;
+		virtual uint32_t clockHz() = 0;
+};
+
+typedef struct
+{
+	uint8_t channel;   // Mux channel, XCADE_MUX_NONE if not behind the mux
+	uint8_t addr;
+	uint8_t reg;
+	uint8_t len;
+	uint8_t* data;
+	bool read;
+	int8_t bus;        // Which controller the device is wired to
+	bool ok;
+} XCadeBusJob;
+
+class XCadeBusScheduler
+{
+	public:
+		XCadeBusScheduler();
+		~XCadeBusScheduler();
+
+		void begin(XCadeBus* bus0, XCadeBus* bus1 = NULL);
+		void clear();
+		bool add(XCadeBusJob* job);
+		bool run();
+
+		// run() in two halves, for keeping the second bus busy while the
+		//  caller does something else on the first (the library's own
+		//  updates, say).  start() sets the bus 1 queue going and finish()
+		//  waits for it.  The bus 0 queue isn't run.
+		bool start();
+		bool finish();
+
+		// Suggest which bus each XCADE_BUS_AUTO job should be wired to so
+		//  both buses carry about the same traffic
+		void plan(XCadeBusJob* jobs, uint8_t numJobs);
+		uint32_t estimateUs(const XCadeBusJob* job, uint8_t bus);
+
+		uint32_t muxSwitches[XCADE_BUS_MAX];
+		uint32_t errors[XCADE_BUS_MAX];
+
+	private:
+		void runQueue(uint8_t bus);
+		void worker();
+
+		XCadeBus* buses[XCADE_BUS_MAX];
+		XCadeBusJob* queue[XCADE_BUS_MAX][XCADE_BUS_MAX_JOBS];
+		uint8_t queueLen[XCADE_BUS_MAX];
+		uint8_t selectedChannel[XCADE_BUS_MAX];
+		bool queueOk[XCADE_BUS_MAX];
+
+		// The second bus runs on its own thread so both controllers are
+		//  clocking bytes at the same time
+		std::thread workerThread;
+		std::mutex lock;
+		std::condition_variable wake;
+		bool workerPending;
+		bool workerQuit;
+		bool workerStarted;
+};
+
+#endif
@@ -0,0 +1,76 @@
+/*************************************************************************
+Title:    XCade Dual I2C Bus Scheduler - TwoWire Adapter
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeBusWire.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_BUS_WIRE_H_
+#define _XCADE_BUS_WIRE_H_
+
+#include <Wire.h>
+#include "xcadeBus.h"
+
+class XCadeBusWire : public XCadeBus
+{
+	public:
+		XCadeBusWire(TwoWire* wire, uint32_t hz, uint8_t muxAddr = XCADE_BUS_MUX_ADDR)
+			: wire(wire), hz(hz), muxAddr(muxAddr) {}
+
+		bool muxSelect(uint8_t channel)
+		{
+			wire->beginTransmission(muxAddr);
+			wire->write((uint8_t)(1 << channel));
+			return (0 == wire->endTransmission());
+		}
+
+		bool write(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t len)
+		{
+			wire->beginTransmission(addr);
+			wire->write(reg);
+			wire->write(data, len);
+			return (0 == wire->endTransmission());
+		}
+
+		bool read(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len)
+		{
+			wire->beginTransmission(addr);
+			wire->write(reg);
+			if (0 != wire->endTransmission(false))
+				return false;
+			if (wire->requestFrom(addr, len) != len)
+			{
+				while(wire->available())
+					wire->read();
+				return false;
+			}
+			for (uint8_t i=0; i<len; i++)
+				data[i] = wire->read();
+			return true;
+		}
+
+		uint32_t clockHz() { return hz; }
+
+	private:
+		TwoWire* wire;
+		uint32_t hz;
+		uint8_t muxAddr;
+};
+
+#endif
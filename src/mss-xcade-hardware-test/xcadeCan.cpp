@@ -0,0 +1,251 @@
+/*************************************************************************
+Title:    XCade CAN Transport
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeCan.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <string.h>
+#include "xcadeCan.h"
+
+uint16_t xcadeCanFrameBits(uint8_t len)
+{
+	// SOF, ID, RTR, IDE, r0, DLC, data and CRC can all pick up stuff bits,
+	//  one per four after the first.  CRC delimiter, ACK, EOF and the
+	//  interframe space are fixed form.
+	uint16_t stuffable = 34 + 8 * len;
+	return stuffable + (stuffable - 1) / 4 + 13;
+}
+
+bool xcadeCanStateEqual(const XCadeCanState* a, const XCadeCanState* b)
+{
+	return (a->occupancy == b->occupancy && a->sensors == b->sensors
+		&& 0 == memcmp(a->indication, b->indication, sizeof(a->indication)));
+}
+
+static void packIndications(const XCadeCanState* state, uint8_t* data)
+{
+	data[0] = (state->indication[0] & 0x0F) | (state->indication[1] << 4);
+	data[1] = (state->indication[2] & 0x0F) | (state->indication[3] << 4);
+}
+
+static void unpackIndications(XCadeCanState* state, const uint8_t* data)
+{
+	state->indication[0] = data[0] & 0x0F;
+	state->indication[1] = data[0] >> 4;
+	state->indication[2] = data[1] & 0x0F;
+	state->indication[3] = data[1] >> 4;
+}
+
+
+XCadeCanNode::XCadeCanNode()
+{
+	port = NULL;
+	node = XCADE_CAN_NODE_NONE;
+	framesSent = sendBusy = 0;
+}
+
+void XCadeCanNode::begin(XCadeCanPort* port, uint8_t node, uint32_t refreshMs)
+{
+	this->port = port;
+	this->node = node & 0x7F;
+	this->refreshMs = refreshMs;
+	memset(&sent, 0, sizeof(sent));
+	seq = 0;
+	// Nodes that power up together spread their refreshes out over the
+	//  period by node number, rather than all going at once.  Anything
+	//  that isn't all zeros goes out on the first update as events.
+	lastRefreshMs = 0;
+	framesSent = sendBusy = 0;
+}
+
+bool XCadeCanNode::send(uint8_t cls, const uint8_t* data, uint8_t len)
+{
+	XCadeCanFrame frame;
+
+	frame.id = XCADE_CAN_ID(cls, node);
+	frame.len = len + 1;
+	frame.data[0] = seq;
+	memcpy(&frame.data[1], data, len);
+
+	if (!port->send(&frame))
+	{
+		sendBusy++;
+		return false;
+	}
+	seq++;
+	framesSent++;
+	return true;
+}
+
+void XCadeCanNode::update(const XCadeCanState* state, uint32_t nowMs)
+{
+	uint8_t data[5];
+
+	if (NULL == port || XCADE_CAN_NODE_NONE == node)
+		return;
+
+	if (state->occupancy != sent.occupancy)
+	{
+		data[0] = state->occupancy;
+		if (send(XCADE_CAN_OCCUPANCY, data, 1))
+			sent.occupancy = state->occupancy;
+	}
+
+	if (0 != memcmp(state->indication, sent.indication, sizeof(sent.indication)))
+	{
+		packIndications(state, data);
+		if (send(XCADE_CAN_INDICATION, data, 2))
+			memcpy(sent.indication, state->indication, sizeof(sent.indication));
+	}
+
+	if (state->sensors != sent.sensors)
+	{
+		data[0] = state->sensors & 0xFF;
+		data[1] = state->sensors >> 8;
+		if (send(XCADE_CAN_SENSORS, data, 2))
+			sent.sensors = state->sensors;
+	}
+
+	if ((uint32_t)(nowMs - lastRefreshMs) >= refreshMs + (uint32_t)node * refreshMs / XCADE_CAN_MAX_NODES)
+	{
+		data[0] = state->occupancy;
+		packIndications(state, &data[1]);
+		data[3] = state->sensors & 0xFF;
+		data[4] = state->sensors >> 8;
+		if (send(XCADE_CAN_STATE, data, 5))
+		{
+			// Only the first one's offset, after that it's every refreshMs
+			lastRefreshMs = nowMs - (uint32_t)node * refreshMs / XCADE_CAN_MAX_NODES;
+			sent = *state;
+		}
+	}
+}
+
+
+XCadeCanListener::XCadeCanListener()
+{
+	port = NULL;
+	clear();
+}
+
+void XCadeCanListener::begin(XCadeCanPort* port)
+{
+	this->port = port;
+	clear();
+}
+
+void XCadeCanListener::clear()
+{
+	memset(remotes, 0, sizeof(remotes));
+	framesReceived = badFrames = 0;
+}
+
+uint16_t XCadeCanListener::poll(uint32_t nowMs)
+{
+	XCadeCanFrame frame;
+	uint16_t frames = 0;
+
+	if (NULL == port)
+		return 0;
+
+	while (port->receive(&frame))
+	{
+		handle(&frame, nowMs);
+		frames++;
+	}
+	return frames;
+}
+
+bool XCadeCanListener::handle(const XCadeCanFrame* frame, uint32_t nowMs)
+{
+	uint8_t node = XCADE_CAN_NODE(frame->id);
+	XCadeCanRemote* r = &remotes[node];
+	const uint8_t* data = &frame->data[1];
+	uint8_t have = 0;
+
+	if (frame->id > 0x7FF || XCADE_CAN_NODE_NONE == node || frame->len < 1)
+	{
+		badFrames++;
+		return false;
+	}
+
+	// have stays zero for anything unknown or short
+	switch(XCADE_CAN_CLASS(frame->id))
+	{
+		case XCADE_CAN_OCCUPANCY:
+			if (frame->len < 2)
+				break;
+			r->state.occupancy = data[0];
+			have = XCADE_CAN_HAVE_OCCUPANCY;
+			break;
+
+		case XCADE_CAN_INDICATION:
+			if (frame->len < 3)
+				break;
+			unpackIndications(&r->state, data);
+			have = XCADE_CAN_HAVE_INDICATION;
+			break;
+
+		case XCADE_CAN_SENSORS:
+			if (frame->len < 3)
+				break;
+			r->state.sensors = data[0] | ((uint16_t)data[1] << 8);
+			have = XCADE_CAN_HAVE_SENSORS;
+			break;
+
+		case XCADE_CAN_STATE:
+			if (frame->len < 6)
+				break;
+			r->state.occupancy = data[0];
+			unpackIndications(&r->state, &data[1]);
+			r->state.sensors = data[3] | ((uint16_t)data[4] << 8);
+			have = XCADE_CAN_HAVE_ALL;
+			break;
+
+		default:
+			break;
+	}
+
+	if (0 == have)
+	{
+		badFrames++;
+		return false;
+	}
+
+	// Anything between the last sequence number and this one went missing
+	if (r->have)
+		r->missed += (uint8_t)(frame->data[0] - r->seq - 1);
+	r->seq = frame->data[0];
+	r->have |= have;
+	r->lastSeenMs = nowMs;
+	framesReceived++;
+	return true;
+}
+
+const XCadeCanRemote* XCadeCanListener::remote(uint8_t node)
+{
+	return &remotes[node & 0x7F];
+}
+
+bool XCadeCanListener::online(uint8_t node, uint32_t nowMs, uint32_t refreshMs)
+{
+	const XCadeCanRemote* r = &remotes[node & 0x7F];
+	return (0 != r->have && (uint32_t)(nowMs - r->lastSeenMs) <= XCADE_CAN_OFFLINE_REFRESHES * refreshMs);
+}
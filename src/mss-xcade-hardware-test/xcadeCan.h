@@ -0,0 +1,159 @@
+/*************************************************************************
+Title:    XCade CAN Transport
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeCan.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_CAN_H_
+#define _XCADE_CAN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Nothing in here touches Arduino, so the same code runs against the
+//  ESP32's TWAI controller (xcadeCanTwai.h) and SocketCAN or a simulated
+//  bus on Linux (src/xcade-can-bench)
+
+/* Each XCade board is a node (1-127) and sends a frame whenever its
+   occupancy, port indications or sensor inputs change, plus its whole state
+   every refresh period so anything that starts listening late catches up.
+
+   Standard 11 bit IDs, class in bits 10:7 and node in bits 6:0.  Lower IDs
+   win arbitration, so occupancy beats indications beats sensors, and the
+   refreshes only go when nothing else wants the bus.
+
+   Every frame starts with the node's sequence number, one count per frame,
+   so a listener can tell it missed something.  The refresh fixes it up
+   either way.
+
+     OCCUPANCY   seq, occupancy (port A-D in bits 3:0)
+     INDICATION  seq, port A | B<<4, port C | D<<4
+     SENSORS     seq, sensors 7:0, sensors 15:8
+     STATE       seq, occupancy, indications (2), sensors (2) */
+
+#define XCADE_CAN_PORTS             4
+#define XCADE_CAN_MAX_NODES       128
+#define XCADE_CAN_NODE_NONE         0   // Listen only, never sends
+#define XCADE_CAN_REFRESH_MS     1000
+// A node not heard from in this many refresh periods has gone away
+#define XCADE_CAN_OFFLINE_REFRESHES 3
+
+#define XCADE_CAN_OCCUPANCY      0x1
+#define XCADE_CAN_INDICATION     0x2
+#define XCADE_CAN_SENSORS        0x3
+#define XCADE_CAN_STATE          0x8
+
+#define XCADE_CAN_ID(cls, node)  ((((uint16_t)(cls)) << 7) | ((node) & 0x7F))
+#define XCADE_CAN_CLASS(id)      (((id) >> 7) & 0x0F)
+#define XCADE_CAN_NODE(id)       ((id) & 0x7F)
+
+// Which parts of a remote node's state have been heard
+#define XCADE_CAN_HAVE_OCCUPANCY   0x01
+#define XCADE_CAN_HAVE_INDICATION  0x02
+#define XCADE_CAN_HAVE_SENSORS     0x04
+#define XCADE_CAN_HAVE_ALL         0x07
+
+typedef struct
+{
+	uint16_t id;
+	uint8_t len;
+	uint8_t data[8];
+} XCadeCanFrame;
+
+typedef struct
+{
+	uint8_t occupancy;                     // Bit n set for local occupancy on port n (A-D)
+	uint8_t indication[XCADE_CAN_PORTS];   // MSS indication received on each port, 0-15
+	uint16_t sensors;                      // Bit n for sensor input n+1
+} XCadeCanState;
+
+typedef struct
+{
+	XCadeCanState state;
+	uint32_t lastSeenMs;
+	uint16_t missed;
+	uint8_t seq;
+	uint8_t have;
+} XCadeCanRemote;
+
+class XCadeCanPort
+{
+	public:
+		virtual ~XCadeCanPort() {}
+		// Neither blocks.  send() is false when the controller's transmit
+		//  queue is full, receive() when there's nothing waiting.
+		virtual bool send(const XCadeCanFrame* frame) = 0;
+		virtual bool receive(XCadeCanFrame* frame) = 0;
+};
+
+// Bits on the wire for a standard data frame, worst case bit stuffing and
+//  the interframe space included
+uint16_t xcadeCanFrameBits(uint8_t len);
+
+bool xcadeCanStateEqual(const XCadeCanState* a, const XCadeCanState* b);
+
+class XCadeCanNode
+{
+	public:
+		XCadeCanNode();
+
+		void begin(XCadeCanPort* port, uint8_t node, uint32_t refreshMs = XCADE_CAN_REFRESH_MS);
+		// Call every time around the loop with the board's current state.
+		//  Anything that couldn't be sent goes next time.
+		void update(const XCadeCanState* state, uint32_t nowMs);
+		uint8_t lastSeq() { return seq - 1; }
+
+		uint32_t framesSent;
+		uint32_t sendBusy;
+
+	private:
+		bool send(uint8_t cls, const uint8_t* data, uint8_t len);
+
+		XCadeCanPort* port;
+		XCadeCanState sent;
+		uint32_t refreshMs;
+		uint32_t lastRefreshMs;
+		uint8_t node;
+		uint8_t seq;
+};
+
+class XCadeCanListener
+{
+	public:
+		XCadeCanListener();
+
+		void begin(XCadeCanPort* port);
+		void clear();
+		// Takes everything waiting on the port, returns how many frames
+		uint16_t poll(uint32_t nowMs);
+		bool handle(const XCadeCanFrame* frame, uint32_t nowMs);
+
+		const XCadeCanRemote* remote(uint8_t node);
+		bool online(uint8_t node, uint32_t nowMs, uint32_t refreshMs = XCADE_CAN_REFRESH_MS);
+
+		uint32_t framesReceived;
+		uint32_t badFrames;
+
+	private:
+		XCadeCanPort* port;
+		XCadeCanRemote remotes[XCADE_CAN_MAX_NODES];
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*************************************************************************
+Title:    XCade CAN Transport - ESP32 TWAI Adapter
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeCanTwai.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_CAN_TWAI_H_
+#define _XCADE_CAN_TWAI_H_
+
+#include <string.h>
+#include <driver/twai.h>
+#include "xcadeCan.h"
+
+// Frames the driver holds while the bus is busy.  A change that doesn't fit
+//  just goes on the next update.
+#define XCADE_CAN_TWAI_TX_QUEUE  16
+#define XCADE_CAN_TWAI_RX_QUEUE  32
+
+class XCadeCanTwai : public XCadeCanPort
+{
+	public:
+		XCadeCanTwai() : running(false) {}
+
+		// bitrate is 125000, 250000 or 500000
+		bool begin(int txPin, int rxPin, uint32_t bitrate)
+		{
+			twai_general_config_t general = TWAI_GENERAL_CONFIG_DEFAULT((gpio_num_t)txPin, (gpio_num_t)rxPin, TWAI_MODE_NORMAL);
+			twai_timing_config_t timing125 = TWAI_TIMING_CONFIG_125KBITS();
+			twai_timing_config_t timing250 = TWAI_TIMING_CONFIG_250KBITS();
+			twai_timing_config_t timing500 = TWAI_TIMING_CONFIG_500KBITS();
+			twai_filter_config_t filter = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+			twai_timing_config_t* timing = &timing250;
+
+			if (125000 == bitrate)
+				timing = &timing125;
+			else if (500000 == bitrate)
+				timing = &timing500;
+
+			general.tx_queue_len = XCADE_CAN_TWAI_TX_QUEUE;
+			general.rx_queue_len = XCADE_CAN_TWAI_RX_QUEUE;
+
+			if (ESP_OK != twai_driver_install(&general, timing, &filter))
+				return false;
+			running = (ESP_OK == twai_start());
+			return running;
+		}
+
+		bool send(const XCadeCanFrame* frame)
+		{
+			twai_message_t msg;
+
+			if (!running)
+				return false;
+
+			memset(&msg, 0, sizeof(msg));
+			msg.identifier = frame->id;
+			msg.data_length_code = frame->len;
+			memcpy(msg.data, frame->data, frame->len);
+			if (ESP_OK == twai_transmit(&msg, 0))
+				return true;
+
+			recover();
+			return false;
+		}
+
+		bool receive(XCadeCanFrame* frame)
+		{
+			twai_message_t msg;
+
+			while (running && ESP_OK == twai_receive(&msg, 0))
+			{
+				// Nothing of ours uses remote or extended frames
+				if (msg.rtr || msg.extd || msg.data_length_code > 8)
+					continue;
+				frame->id = msg.identifier;
+				frame->len = msg.data_length_code;
+				memcpy(frame->data, msg.data, frame->len);
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		// Too many errors takes the controller off the bus, and it stays off
+		//  until told to come back
+		void recover()
+		{
+			twai_status_info_t status;
+
+			if (ESP_OK != twai_get_status_info(&status))
+				return;
+			if (TWAI_STATE_BUS_OFF == status.state)
+				twai_initiate_recovery();
+			else if (TWAI_STATE_STOPPED == status.state)
+				twai_start();
+		}
+
+		bool running;
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*************************************************************************
+Title:    XCade Wide Input Debouncer
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeDebounce.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_DEBOUNCE_H_
+#define _XCADE_DEBOUNCE_H_
+
+#include <stdint.h>
+
+// Nothing in here touches Arduino, so the same code runs on the ESP32 and
+//  in src/xcade-debounce-bench
+
+/* The same vertical counter idea as debounce8() in src/i2c-shcp/debouncer.c,
+   one bit of every input per word, but as wide as the word type (uint32_t
+   or uint64_t) and with the number of samples settable per input.
+
+   Each input has a counter, spread across Planes words, that counts down
+   while the input disagrees with its debounced state.  A sample that
+   disagrees with the counter already at zero flips the debounced state.
+   A sample that agrees, or a flip, reloads the counter from the input's
+   depth.  So an input changes on the depth'th disagreeing sample in a row,
+   and depth 1 passes inputs straight through.  Depth 4 is exactly
+   debounce8().
+
+   Planes counter words give depths up to 2^Planes samples. */
+
+template <typename Word, uint8_t Planes = 3>
+class XCadeDebouncer
+{
+	public:
+		static const uint8_t MAX_DEPTH = 1 << Planes;
+
+		XCadeDebouncer()
+		{
+			for (uint8_t p=0; p<Planes; p++)
+				count[p] = reload[p] = 0;
+			begin(0, 4);
+		}
+
+		// Every input starts out debounced at initialState, depth samples deep
+		void begin(Word initialState, uint8_t depth)
+		{
+			state = initialState;
+			setDepth(~(Word)0, depth);
+		}
+
+		// depth is clamped to 1 - MAX_DEPTH.  The inputs in mask start counting
+		//  over.
+		void setDepth(Word mask, uint8_t depth)
+		{
+			if (depth < 1)
+				depth = 1;
+			else if (depth > MAX_DEPTH)
+				depth = MAX_DEPTH;
+			depth--;
+
+			for (uint8_t p=0; p<Planes; p++)
+			{
+				reload[p] = (reload[p] & ~mask) | (((depth >> p) & 0x01)?mask:0);
+				count[p] = (count[p] & ~mask) | (reload[p] & mask);
+			}
+		}
+
+		// Takes one sample of every input, returns the ones whose debounced
+		//  state flipped
+		Word update(Word raw)
+		{
+			Word delta = raw ^ state;
+			Word zero = 0;
+			Word borrow;
+			Word changes;
+			Word counting;
+
+			for (uint8_t p=0; p<Planes; p++)
+				zero |= count[p];
+			zero = ~zero;
+
+			changes = delta & zero;
+			state ^= changes;
+
+			// Count down anything still disagreeing, then reload anything that
+			//  agrees or just flipped
+			counting = delta & ~zero;
+			borrow = counting;
+			for (uint8_t p=0; p<Planes; p++)
+			{
+				Word c = count[p];
+				count[p] = ((c ^ borrow) & counting) | (reload[p] & ~counting);
+				borrow &= ~c;
+			}
+
+			return changes;
+		}
+
+		Word debounced() const { return state; }
+
+	private:
+		Word state;
+		Word count[Planes];
+		Word reload[Planes];
+};
+
+/* Encoded inputs, like the indication decoded from an MSS port, can't go
+   through the vertical counter a bit at a time.  While a code changes,
+   each bit settles on its own schedule, so the debounced bits can spell out
+   a code that was never sent.  This debounces each value whole instead: a
+   new value takes over once it has come in depth samples in a row.  Any
+   other value in between starts the run over, and so does a sample that
+   matches the debounced value.  It uses the same timing as XCadeDebouncer,
+   so depth 1 passes values straight through. */
+
+template <uint8_t Slots>
+class XCadeValueDebouncer
+{
+	public:
+		XCadeValueDebouncer()
+		{
+			for (uint8_t i=0; i<Slots; i++)
+				state[i] = pending[i] = run[i] = 0;
+			depth = 1;
+		}
+
+		// Each slot starts out debounced at its initialValues entry
+		void begin(const uint8_t* initialValues, uint8_t depth)
+		{
+			for (uint8_t i=0; i<Slots; i++)
+			{
+				state[i] = pending[i] = initialValues[i];
+				run[i] = 0;
+			}
+			this->depth = (depth < 1)?1:depth;
+		}
+
+		// Takes one sample of one slot, returns true if its debounced value
+		//  changed
+		bool update(uint8_t slot, uint8_t raw)
+		{
+			if (raw == state[slot])
+			{
+				run[slot] = 0;
+				return false;
+			}
+			if (raw != pending[slot])
+			{
+				pending[slot] = raw;
+				run[slot] = 0;
+			}
+			if (++run[slot] < depth)
+				return false;
+			state[slot] = raw;
+			run[slot] = 0;
+			return true;
+		}
+
+		uint8_t debounced(uint8_t slot) const { return state[slot]; }
+
+	private:
+		uint8_t state[Slots];
+		uint8_t pending[Slots];
+		uint8_t run[Slots];
+		uint8_t depth;
+};
+
+#endif
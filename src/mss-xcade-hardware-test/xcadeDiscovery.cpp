@@ -0,0 +1,287 @@
+/*************************************************************************
+Title:    XCade Bus Discovery
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeDiscovery.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <string.h>
+#include <stddef.h>
+#include "xcadeDiscovery.h"
+#include "shcpRegisters.h"
+
+#define TAG_NONE 0xFF
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t firstAddr;
+	uint8_t lastAddr;
+	uint8_t idReg;
+	uint8_t idLen;
+	uint8_t magic;     // id[0] has to be this to count, 0 for anything
+} XCadeDeviceKind;
+
+// Where things live and what to read to tell them apart.  The PCA9555's
+//  polarity registers are plain data, so reading them only says something
+//  answered.
+static const XCadeDeviceKind deviceKinds[] =
+{
+	{ XCADE_DEVICE_PCA9555, 0x20, 0x27, 0x04, 2, 0 },
+	{ XCADE_DEVICE_SHCP, SHCP_I2C_ADDR, SHCP_I2C_ADDR, SHCP_REG_ID, 3, SHCP_ID },
+};
+
+#define NUM_DEVICE_KINDS (sizeof(deviceKinds) / sizeof(deviceKinds[0]))
+
+static uint8_t topologyCrc(const XCadeTopology* topo)
+{
+	const uint8_t* p = (const uint8_t*)topo;
+	uint8_t crc = 0;
+
+	for (size_t i=0; i<sizeof(XCadeTopology); i++)
+	{
+		if (offsetof(XCadeTopology, check) == i)
+			continue;
+		crc ^= p[i];
+		for (uint8_t b=0; b<8; b++)
+			crc = (crc & 0x80)?((crc << 1) ^ 0x07):(crc << 1);
+	}
+	return crc;
+}
+
+void xcadeTopologySeal(XCadeTopology* topo)
+{
+	topo->check = topologyCrc(topo);
+}
+
+bool xcadeTopologyValid(const XCadeTopology* topo)
+{
+	return (XCADE_TOPOLOGY_VERSION == topo->version
+		&& topo->numDevices <= XCADE_DISCOVERY_MAX_DEVICES
+		&& topo->check == topologyCrc(topo));
+}
+
+static const XCadeDeviceKind* deviceKind(uint8_t type, uint8_t addr)
+{
+	for (uint8_t k=0; k<NUM_DEVICE_KINDS; k++)
+		if (addr >= deviceKinds[k].firstAddr && addr <= deviceKinds[k].lastAddr
+			&& (XCADE_DEVICE_UNKNOWN == type || deviceKinds[k].type == type))
+			return &deviceKinds[k];
+	return NULL;
+}
+
+XCadeDiscovery::XCadeDiscovery()
+{
+	scheduler = NULL;
+	numBuses = 0;
+	channels = XCADE_BUS_MUX_CHANNELS;
+	muxAddr = XCADE_BUS_MUX_ADDR;
+	lastJobs = 0;
+	clearJobs();
+}
+
+void XCadeDiscovery::begin(XCadeBusScheduler* scheduler, uint8_t numBuses, uint8_t channels, uint8_t muxAddr)
+{
+	this->scheduler = scheduler;
+	this->numBuses = (numBuses > XCADE_BUS_MAX)?XCADE_BUS_MAX:numBuses;
+	this->channels = (channels > 8)?8:channels;
+	this->muxAddr = muxAddr;
+}
+
+void XCadeDiscovery::clearJobs()
+{
+	numJobs = 0;
+	queueFull = false;
+}
+
+XCadeBusJob* XCadeDiscovery::queue(uint8_t bus, uint8_t channel, uint8_t addr, uint8_t reg, uint8_t len, bool read, uint8_t tag)
+{
+	XCadeBusJob* job;
+
+	if (numJobs >= XCADE_DISCOVERY_MAX_JOBS || len > XCADE_DISCOVERY_ID_LEN)
+	{
+		queueFull = true;
+		return NULL;
+	}
+
+	job = &jobs[numJobs];
+	job->channel = channel;
+	job->addr = addr;
+	job->reg = reg;
+	job->len = len;
+	job->data = jobData[numJobs];
+	job->read = read;
+	job->bus = bus;
+	job->ok = false;
+	memset(jobData[numJobs], 0, XCADE_DISCOVERY_ID_LEN);
+	jobTag[numJobs] = tag;
+
+	if (!scheduler->add(job))
+	{
+		queueFull = true;
+		return NULL;
+	}
+	numJobs++;
+	return job;
+}
+
+// One identity read for every address a known device can be at, except the
+//  ones already found in front of the mux
+void XCadeDiscovery::queueCandidates(uint8_t bus, uint8_t channel, const XCadeTopology* skip)
+{
+	for (uint8_t k=0; k<NUM_DEVICE_KINDS; k++)
+	{
+		const XCadeDeviceKind* kind = &deviceKinds[k];
+
+		for (uint8_t addr=kind->firstAddr; addr<=kind->lastAddr; addr++)
+		{
+			bool found = false;
+			for (uint8_t d=0; NULL != skip && d<skip->numDevices && !found; d++)
+				found = (skip->devices[d].bus == bus && skip->devices[d].addr == addr);
+			if (!found)
+				queue(bus, channel, addr, kind->idReg, kind->idLen, true, k);
+		}
+	}
+}
+
+bool XCadeDiscovery::run()
+{
+	lastJobs += numJobs;
+	// Misses are most of what discovery does, so only the queue matters here
+	scheduler->run();
+	scheduler->clear();
+	return !queueFull;
+}
+
+void XCadeDiscovery::collect(XCadeTopology* topo)
+{
+	for (uint16_t j=0; j<numJobs; j++)
+	{
+		const XCadeDeviceKind* kind;
+		XCadeDevice* dev;
+
+		if (TAG_NONE == jobTag[j] || !jobs[j].ok || topo->numDevices >= XCADE_DISCOVERY_MAX_DEVICES)
+			continue;
+
+		kind = &deviceKinds[jobTag[j]];
+		dev = &topo->devices[topo->numDevices++];
+		dev->bus = jobs[j].bus;
+		dev->channel = jobs[j].channel;
+		dev->addr = jobs[j].addr;
+		dev->type = (0 == kind->magic || kind->magic == jobData[j][0])?kind->type:XCADE_DEVICE_UNKNOWN;
+		memcpy(dev->id, jobData[j], XCADE_DISCOVERY_ID_LEN);
+	}
+}
+
+bool XCadeDiscovery::discover(XCadeTopology* topo)
+{
+	XCadeBusJob* muxOff[XCADE_BUS_MAX] = { NULL, NULL };
+	bool ok;
+
+	memset(topo, 0, sizeof(XCadeTopology));
+	topo->version = XCADE_TOPOLOGY_VERSION;
+	lastJobs = 0;
+
+	if (NULL == scheduler || 0 == numBuses)
+		return false;
+
+	// In front of the mux, with every channel turned off first
+	clearJobs();
+	for (uint8_t bus=0; bus<numBuses; bus++)
+	{
+		muxOff[bus] = queue(bus, XCADE_MUX_NONE, muxAddr, 0x00, 0, false, TAG_NONE);
+		queueCandidates(bus, XCADE_MUX_NONE, NULL);
+	}
+	ok = run();
+	for (uint8_t bus=0; bus<numBuses; bus++)
+		if (NULL != muxOff[bus] && muxOff[bus]->ok)
+			topo->muxes |= 1 << bus;
+	collect(topo);
+
+	// Behind each channel.  The mux gets turned off again at the end (channel
+	//  jobs sort ahead of unmuxed ones) so nothing is left hanging on the bus.
+	clearJobs();
+	for (uint8_t bus=0; bus<numBuses; bus++)
+	{
+		if (0 == (topo->muxes & (1 << bus)))
+			continue;
+		for (uint8_t ch=0; ch<channels; ch++)
+			queueCandidates(bus, ch, topo);
+		queue(bus, XCADE_MUX_NONE, muxAddr, 0x00, 0, false, TAG_NONE);
+	}
+	if (numJobs)
+	{
+		ok = run() && ok;
+		collect(topo);
+	}
+
+	xcadeTopologySeal(topo);
+	return ok && topo->numDevices > 0;
+}
+
+bool XCadeDiscovery::validate(const XCadeTopology* topo)
+{
+	uint16_t jobDevice[XCADE_DISCOVERY_MAX_DEVICES];
+	uint16_t j;
+
+	lastJobs = 0;
+	if (NULL == scheduler || !xcadeTopologyValid(topo) || 0 == topo->numDevices)
+		return false;
+
+	clearJobs();
+
+	// Channel jobs all run before unmuxed ones, so turning each mux off here
+	//  lands after the channels and before the devices in front of it
+	for (uint8_t bus=0; bus<numBuses; bus++)
+		if (topo->muxes & (1 << bus))
+			queue(bus, XCADE_MUX_NONE, muxAddr, 0x00, 0, false, TAG_NONE);
+
+	for (uint8_t d=0; d<topo->numDevices; d++)
+	{
+		const XCadeDevice* dev = &topo->devices[d];
+		const XCadeDeviceKind* kind = deviceKind(dev->type, dev->addr);
+
+		if (dev->bus >= numBuses || NULL == kind
+			|| (XCADE_MUX_NONE != dev->channel && 0 == (topo->muxes & (1 << dev->bus))))
+		{
+			scheduler->clear();
+			return false;
+		}
+		jobDevice[d] = numJobs;
+		queue(dev->bus, dev->channel, dev->addr, kind->idReg, kind->idLen, true, d);
+	}
+
+	if (!run())
+		return false;
+
+	for (j=0; j<numJobs; j++)
+		if (!jobs[j].ok)
+			return false;
+
+	for (uint8_t d=0; d<topo->numDevices; d++)
+	{
+		const XCadeDevice* dev = &topo->devices[d];
+		const XCadeDeviceKind* kind = deviceKind(dev->type, dev->addr);
+		// Only compare what actually identifies something
+		if ((0 != kind->magic || XCADE_DEVICE_UNKNOWN == dev->type)
+			&& 0 != memcmp(dev->id, jobData[jobDevice[d]], kind->idLen))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,119 @@
+/*************************************************************************
+Title:    XCade Bus Discovery
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeDiscovery.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_DISCOVERY_H_
+#define _XCADE_DISCOVERY_H_
+
+#include <stdint.h>
+#include "xcadeBus.h"
+
+// Nothing in here touches Arduino, so the same code runs on the ESP32 (with
+//  the topology kept in NVS by the sketch) and in src/xcade-discovery-bench
+
+/* Finding what's on the buses.  Rather than pinging all 112 addresses on
+   every channel, only the addresses something XCade-related can live at
+   get tried (the expanders and the SHCP), and each try is the identity
+   read itself, so finding a device and reading what it is are the same
+   transaction.  Everything goes through the scheduler, so both buses are
+   swept at once and each mux channel is selected only once.
+
+   Two passes:
+   1. With the mux turned off, what answers in front of it.  Turning it off
+      is a write to the mux, so that ACK also says whether there's a mux.
+   2. Each channel of each bus that has a mux, leaving out the addresses
+      that already answered in front of it (they'd answer on every channel).
+
+   validate() is the quick check for a topology found earlier: one pass that
+   reads each known device's identity again and compares.  Anything
+   missing or different fails it, then it's time for discover() again.
+   New boards added since don't, so 'd' in the sketch looks from scratch. */
+
+#define XCADE_TOPOLOGY_VERSION         1
+#define XCADE_DISCOVERY_MAX_DEVICES   48
+#define XCADE_DISCOVERY_MAX_JOBS     (XCADE_BUS_MAX * XCADE_BUS_MAX_JOBS)
+#define XCADE_DISCOVERY_ID_LEN         3
+
+#define XCADE_DEVICE_UNKNOWN           0   // Answered, but not what lives there
+#define XCADE_DEVICE_PCA9555           1
+#define XCADE_DEVICE_SHCP              2
+
+typedef struct
+{
+	uint8_t bus;
+	uint8_t channel;     // XCADE_MUX_NONE if in front of the mux
+	uint8_t addr;
+	uint8_t type;        // XCADE_DEVICE_*
+	uint8_t id[XCADE_DISCOVERY_ID_LEN];   // Whatever the identity read returned
+} XCadeDevice;
+
+typedef struct
+{
+	uint8_t version;     // XCADE_TOPOLOGY_VERSION
+	uint8_t numDevices;
+	uint8_t muxes;       // Bit n set if bus n has a mux
+	uint8_t check;       // CRC-8 over everything else, see xcadeTopologySeal()
+	XCadeDevice devices[XCADE_DISCOVERY_MAX_DEVICES];
+} XCadeTopology;
+
+// A topology from NVS that's short, from an older layout or otherwise mangled
+//  doesn't pass xcadeTopologyValid()
+void xcadeTopologySeal(XCadeTopology* topo);
+bool xcadeTopologyValid(const XCadeTopology* topo);
+
+class XCadeDiscovery
+{
+	public:
+		XCadeDiscovery();
+
+		// The scheduler has to be begun with the buses already.  channels is
+		//  how many each mux has.
+		void begin(XCadeBusScheduler* scheduler, uint8_t numBuses, uint8_t channels = XCADE_BUS_MUX_CHANNELS, uint8_t muxAddr = XCADE_BUS_MUX_ADDR);
+
+		// Both return false if the bus didn't cooperate or nothing was there.
+		//  discover() fills in topo either way.
+		bool discover(XCadeTopology* topo);
+		bool validate(const XCadeTopology* topo);
+
+		// Transactions the last discover() or validate() took, for comparing
+		uint16_t lastJobs;
+
+	private:
+		void clearJobs();
+		XCadeBusJob* queue(uint8_t bus, uint8_t channel, uint8_t addr, uint8_t reg, uint8_t len, bool read, uint8_t tag);
+		void queueCandidates(uint8_t bus, uint8_t channel, const XCadeTopology* skip);
+		bool run();
+		void collect(XCadeTopology* topo);
+
+		XCadeBusScheduler* scheduler;
+		uint8_t numBuses;
+		uint8_t channels;
+		uint8_t muxAddr;
+
+		XCadeBusJob jobs[XCADE_DISCOVERY_MAX_JOBS];
+		uint8_t jobData[XCADE_DISCOVERY_MAX_JOBS][XCADE_DISCOVERY_ID_LEN];
+		uint8_t jobTag[XCADE_DISCOVERY_MAX_JOBS];   // Device kind or topology index
+		uint16_t numJobs;
+		bool queueFull;
+};
+
+#endif
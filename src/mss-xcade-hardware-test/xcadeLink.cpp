@@ -0,0 +1,191 @@
+/*************************************************************************
+Title:    XCade Device Link
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeLink.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <string.h>
+#include "xcadeLink.h"
+
+// Longest writeVerified() can check
+#define XCADE_LINK_VERIFY_MAX 32
+
+XCadeLink::XCadeLink()
+{
+	wires[0] = wires[1] = NULL;
+	topo = NULL;
+	device = NULL;
+	type = XCADE_DEVICE_UNKNOWN;
+	addr = 0;
+	muxAddr = XCADE_BUS_MUX_ADDR;
+	depth = 0;
+	muxSaved = 0;
+	muxRestore = false;
+	bus = 0;
+	channel = XCADE_MUX_NONE;
+}
+
+void XCadeLink::begin(TwoWire* wire0, TwoWire* wire1, const XCadeTopology* topo, uint8_t type, uint8_t addr, uint8_t muxAddr)
+{
+	wires[0] = wire0;
+	wires[1] = wire1;
+	this->topo = topo;
+	this->muxAddr = muxAddr;
+	retarget(type, addr);
+}
+
+void XCadeLink::retarget(uint8_t type, uint8_t addr)
+{
+	device = NULL;
+	this->type = type;
+	this->addr = addr;
+}
+
+void XCadeLink::retarget(const XCadeDevice* dev)
+{
+	device = dev;
+	type = dev->type;
+	addr = dev->addr;
+}
+
+uint8_t XCadeLink::open()
+{
+	const XCadeDevice* dev = device;
+	TwoWire* wire;
+	uint8_t err;
+
+	if (depth++)
+		return XCADE_LINK_OK;
+
+	// Looked up every time, 'd' can move things around
+	for (uint8_t d=0; NULL == dev && NULL != topo && d<topo->numDevices; d++)
+		if (topo->devices[d].type == type && topo->devices[d].addr == addr)
+			dev = &topo->devices[d];
+	bus = (NULL != dev)?dev->bus:0;
+	channel = (NULL != dev)?dev->channel:XCADE_MUX_NONE;
+	muxRestore = false;
+
+	wire = wires[bus];
+	if (NULL == wire)
+	{
+		depth = 0;
+		return XCADE_LINK_NO_BUS;
+	}
+	if (XCADE_MUX_NONE == channel)
+		return XCADE_LINK_OK;
+
+	// The PCA9546 control register is the only thing it has, so a plain read
+	//  gets it back
+	if (1 != wire->requestFrom(muxAddr, (uint8_t)1))
+	{
+		while(wire->available())
+			wire->read();
+		depth = 0;
+		return XCADE_LINK_MUX_ERROR;
+	}
+	muxSaved = wire->read();
+	if ((uint8_t)(1 << channel) == muxSaved)
+		return XCADE_LINK_OK;
+
+	wire->beginTransmission(muxAddr);
+	wire->write((uint8_t)(1 << channel));
+	err = wire->endTransmission();
+	if (0 != err)
+	{
+		depth = 0;
+		return XCADE_LINK_MUX_ERROR;
+	}
+	muxRestore = true;
+	return XCADE_LINK_OK;
+}
+
+void XCadeLink::close()
+{
+	if (0 == depth || --depth)
+		return;
+
+	if (muxRestore)
+	{
+		wires[bus]->beginTransmission(muxAddr);
+		wires[bus]->write(muxSaved);
+		wires[bus]->endTransmission();
+		muxRestore = false;
+	}
+}
+
+uint8_t XCadeLink::write(uint8_t reg, const uint8_t* data, uint8_t len)
+{
+	uint8_t err = open();
+
+	if (XCADE_LINK_OK == err)
+	{
+		wires[bus]->beginTransmission(addr);
+		wires[bus]->write(reg);
+		wires[bus]->write(data, len);
+		err = wires[bus]->endTransmission();
+		close();
+	}
+	return err;
+}
+
+uint8_t XCadeLink::read(uint8_t reg, uint8_t* data, uint8_t len)
+{
+	TwoWire* wire;
+	uint8_t err = open();
+
+	if (XCADE_LINK_OK != err)
+		return err;
+
+	wire = wires[bus];
+	wire->beginTransmission(addr);
+	wire->write(reg);
+	err = wire->endTransmission(false);
+	if (XCADE_LINK_OK == err && wire->requestFrom(addr, len) != len)
+	{
+		while(wire->available())
+			wire->read();
+		err = XCADE_LINK_SHORT_READ;
+	}
+	for (uint8_t i=0; XCADE_LINK_OK == err && i<len; i++)
+		data[i] = wire->read();
+	close();
+	return err;
+}
+
+uint8_t XCadeLink::writeVerified(uint8_t reg, const uint8_t* data, uint8_t len)
+{
+	uint8_t readback[XCADE_LINK_VERIFY_MAX];
+	uint8_t err;
+
+	// Can't read that much back
+	if (len > sizeof(readback))
+		return XCADE_LINK_SHORT_READ;
+
+	err = open();
+	if (XCADE_LINK_OK != err)
+		return err;
+	err = write(reg, data, len);
+	if (XCADE_LINK_OK == err)
+		err = read(reg, readback, len);
+	if (XCADE_LINK_OK == err && 0 != memcmp(data, readback, len))
+		err = XCADE_LINK_MISMATCH;
+	close();
+	return err;
+}
@@ -0,0 +1,89 @@
+/*************************************************************************
+Title:    XCade Device Link
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeLink.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_LINK_H_
+#define _XCADE_LINK_H_
+
+#include <Wire.h>
+#include "xcadeDiscovery.h"
+
+/* Talking to one device directly, outside the library.  The device is looked
+   up in the discovered topology each time a session opens, so it ends up on
+   the right bus and, if it's behind the mux, on the right channel.  A device
+   the topology doesn't know is taken to be on the first bus, in front of
+   the mux.
+
+   The library's WireMux keeps track of which channel it last selected, so
+   a session reads the mux control register first and puts it back the way
+   it was on close().  read() and write() open their own session if there
+   isn't one, so wrap a run of transactions in open()/close() to switch the
+   mux only once. */
+
+// Anything else is what TwoWire::endTransmission() returned
+#define XCADE_LINK_OK             0
+#define XCADE_LINK_ADDR_NACK      2
+#define XCADE_LINK_DATA_NACK      3
+#define XCADE_LINK_SHORT_READ     6
+#define XCADE_LINK_MUX_ERROR      7
+#define XCADE_LINK_MISMATCH       8
+#define XCADE_LINK_NO_BUS         9
+
+class XCadeLink
+{
+	public:
+		XCadeLink();
+
+		// wire1 and topo can be NULL
+		void begin(TwoWire* wire0, TwoWire* wire1, const XCadeTopology* topo, uint8_t type, uint8_t addr, uint8_t muxAddr = XCADE_BUS_MUX_ADDR);
+
+		uint8_t open();
+		void close();
+
+		uint8_t write(uint8_t reg, const uint8_t* data, uint8_t len);
+		uint8_t read(uint8_t reg, uint8_t* data, uint8_t len);
+		// Write, then read back and compare
+		uint8_t writeVerified(uint8_t reg, const uint8_t* data, uint8_t len);
+
+		// Moves to a different device, only between sessions.  The second one
+		//  is for going through the topology's devices one at a time, where
+		//  the same address can turn up on several channels.
+		void retarget(uint8_t type, uint8_t addr);
+		void retarget(const XCadeDevice* dev);
+
+		// Where the last open() found it
+		uint8_t bus;
+		uint8_t channel;
+
+	private:
+		TwoWire* wires[XCADE_BUS_MAX];
+		const XCadeTopology* topo;
+		const XCadeDevice* device;
+		uint8_t type;
+		uint8_t addr;
+		uint8_t muxAddr;
+		uint8_t depth;
+		uint8_t muxSaved;
+		bool muxRestore;
+};
+
+#endif
@@ -0,0 +1,282 @@
+/*************************************************************************
+Title:    Simulated SHCP Boards for the Uploader
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     bootSim.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shcpBus.h"
+#include "shcpRegisters.h"
+#include "bootloader.h"
+
+// Boards sit four to a PCA9546 starting at 0x70, one per channel, the same
+//  as XCade boards daisy chained on one bus segment.  Each runs the real
+//  command handler (../i2c-shcp/bootloader.c) against its own flash array,
+//  behind a copy of avr-i2c-slave.c's register map rules.
+
+#define SIM_MUX_BASE       0x70
+#define SIM_MUX_CHANNELS      4
+#define SIM_MAX_BOARDS       32
+#define SIM_FLASH_SIZE     (BOOT_START + 1024)
+#define SIM_PAGE_WRITE_US  9000   // Erase plus write, the CPU is stopped for both
+#define SIM_APP_REGISTERS    64
+
+typedef struct
+{
+	uint8_t flash[SIM_FLASH_SIZE];
+	volatile uint8_t regs[BOOT_REGISTER_MAP_SIZE];
+	volatile uint8_t attrs[BOOT_REGISTER_MAP_SIZE];
+	uint8_t appRegs[SIM_APP_REGISTERS];
+	uint8_t regIdx;
+	bool inBootloader;
+	uint32_t pageWrites;
+	uint32_t corrupted;
+	uint32_t runs;
+} SimBoard_t;
+
+typedef struct
+{
+	uint8_t numBoards;
+	SimBoard_t* boards;
+	uint8_t muxMask[SIM_MAX_BOARDS / SIM_MUX_CHANNELS];
+	double byteErrorRate;
+	uint32_t clockHz;
+	uint64_t wireUs;
+	uint64_t stretchUs;
+	uint32_t transfers;
+	uint32_t stretchThisTransfer;
+} BootSim_t;
+
+// bootloader.c's flash hooks act on whichever board is running a command
+static SimBoard_t* simCurrent = NULL;
+static uint32_t simStretchUs = 0;
+
+uint16_t bootFlashReadWord(uint16_t addr)
+{
+	return simCurrent->flash[addr] | ((uint16_t)simCurrent->flash[addr+1] << 8);
+}
+
+void bootFlashWritePage(uint16_t addr, const volatile uint8_t* data)
+{
+	for (uint8_t i=0; i<BOOT_PAGE_SIZE; i++)
+		simCurrent->flash[addr + i] = data[i];
+	simCurrent->pageWrites++;
+	simStretchUs += SIM_PAGE_WRITE_US;
+}
+
+static bool boardVisible(BootSim_t* sim, uint8_t b)
+{
+	return sim->muxMask[b / SIM_MUX_CHANNELS] & (1 << (b % SIM_MUX_CHANNELS));
+}
+
+// The bootloader starts the application by jumping to it, which here just
+//  means the board stops answering bootloader commands
+static void boardReset(SimBoard_t* board)
+{
+	simCurrent = board;
+	board->inBootloader = !bootAppValid();
+	if (board->inBootloader)
+		bootInitialize(board->regs, board->attrs);
+	memset(board->appRegs, 0, sizeof(board->appRegs));
+}
+
+static void boardWrite(BootSim_t* sim, SimBoard_t* board, const uint8_t* data, uint16_t len)
+{
+	uint8_t corrupt[len];
+
+	// Line noise, flipping a bit per hit byte.  The real board can't tell
+	//  either, it just gets a different byte.
+	memcpy(corrupt, data, len);
+	for (uint16_t i=0; i<len; i++)
+	{
+		if (sim->byteErrorRate > 0 && drand48() < sim->byteErrorRate)
+		{
+			corrupt[i] ^= 1 << (lrand48() & 0x07);
+			board->corrupted++;
+		}
+	}
+	data = corrupt;
+
+	if (0 == len)
+		return;
+
+	board->regIdx = data[0];
+	if (!board->inBootloader)
+	{
+		for (uint16_t i=1; i<len && board->regIdx < SIM_APP_REGISTERS; i++)
+			board->appRegs[board->regIdx++] = data[i];
+
+		if (BOOT_ENTER_MAGIC == board->appRegs[SHCP_REG_BOOTLOADER])
+		{
+			board->inBootloader = true;
+			bootInitialize(board->regs, board->attrs);
+		}
+		return;
+	}
+
+	for (uint16_t i=1; i<len; i++)
+	{
+		if (board->regIdx < BOOT_REGISTER_MAP_SIZE && !(board->attrs[board->regIdx] & I2CREG_ATTR_READONLY))
+			board->regs[board->regIdx] = data[i];
+		if (255 != board->regIdx)
+			board->regIdx++;
+	}
+
+	// Same as the main loop, once the write's over
+	if (BOOT_CMD_NONE != board->regs[BOOTREG_COMMAND])
+	{
+		uint32_t before = simStretchUs;
+		simCurrent = board;
+		if (bootCommand(board->regs))
+		{
+			board->runs++;
+			board->inBootloader = false;
+			memset(board->appRegs, 0, sizeof(board->appRegs));
+		}
+		// Boards program in parallel, so a broadcast only waits on the slowest
+		if (simStretchUs - before > sim->stretchThisTransfer)
+			sim->stretchThisTransfer = simStretchUs - before;
+		simStretchUs = before;
+	}
+}
+
+static void boardRead(SimBoard_t* board, uint8_t* data, uint16_t len)
+{
+	for (uint16_t i=0; i<len; i++)
+	{
+		if (board->inBootloader)
+			data[i] = (board->regIdx < BOOT_REGISTER_MAP_SIZE)?board->regs[board->regIdx]:0xFF;
+		else
+			data[i] = (board->regIdx < SIM_APP_REGISTERS)?board->appRegs[board->regIdx]:0xFF;
+		if (255 != board->regIdx)
+			board->regIdx++;
+	}
+}
+
+static bool simTransfer(ShcpBus_t* bus, uint8_t addr, const uint8_t* wdata, uint16_t wlen, uint8_t* rdata, uint16_t rlen)
+{
+	BootSim_t* sim = (BootSim_t*)bus->priv;
+	uint8_t numMux = (sim->numBoards + SIM_MUX_CHANNELS - 1) / SIM_MUX_CHANNELS;
+	uint8_t found = 0;
+	SimBoard_t* reader = NULL;
+
+	// Address byte for each half, then the data, 9 clocks a byte
+	sim->transfers++;
+	sim->stretchThisTransfer = 0;
+	sim->wireUs += ((uint64_t)(wlen + rlen + (wlen?1:0) + (rlen?1:0)) * 9 * 1000000) / sim->clockHz;
+
+	if (addr >= SIM_MUX_BASE && addr < SIM_MUX_BASE + numMux)
+	{
+		if (wlen >= 1)
+			sim->muxMask[addr - SIM_MUX_BASE] = wdata[wlen-1] & 0x0F;
+		if (rlen)
+			memset(rdata, sim->muxMask[addr - SIM_MUX_BASE], rlen);
+		return true;
+	}
+
+	if (SHCP_I2C_ADDR != addr && I2C_GENERAL_CALL != addr)
+		return false;
+
+	for (uint8_t b=0; b<sim->numBoards; b++)
+	{
+		SimBoard_t* board = &sim->boards[b];
+		if (!boardVisible(sim, b))
+			continue;
+		// Only the bootloader listens to general calls
+		if (I2C_GENERAL_CALL == addr && !board->inBootloader)
+			continue;
+
+		found++;
+		boardWrite(sim, board, wdata, wlen);
+		reader = board;
+	}
+
+	sim->stretchUs += sim->stretchThisTransfer;
+
+	if (0 == found)
+		return false;
+
+	if (rlen)
+	{
+		// Two boards answering a read at once is garbage on the real bus
+		if (found > 1 || I2C_GENERAL_CALL == addr)
+			return false;
+		boardRead(reader, rdata, rlen);
+	}
+	return true;
+}
+
+static void simClose(ShcpBus_t* bus)
+{
+	BootSim_t* sim = (BootSim_t*)bus->priv;
+	free(sim->boards);
+	free(sim);
+	free(bus);
+}
+
+ShcpBus_t* bootSimOpen(uint8_t numBoards, double byteErrorRate, uint32_t clockHz)
+{
+	ShcpBus_t* bus = calloc(1, sizeof(ShcpBus_t));
+	BootSim_t* sim = calloc(1, sizeof(BootSim_t));
+
+	if (numBoards > SIM_MAX_BOARDS)
+		numBoards = SIM_MAX_BOARDS;
+
+	sim->numBoards = numBoards;
+	sim->boards = calloc(numBoards, sizeof(SimBoard_t));
+	sim->byteErrorRate = byteErrorRate;
+	sim->clockHz = clockHz;
+	srand48(1);
+
+	// Fresh from "make bootflash" - nothing but the bootloader and its reset
+	//  vector, so they all start out waiting in the bootloader
+	for (uint8_t b=0; b<numBoards; b++)
+	{
+		SimBoard_t* board = &sim->boards[b];
+		memset(board->flash, 0xFF, sizeof(board->flash));
+		board->flash[0] = BOOT_RESET_RJMP & 0xFF;
+		board->flash[1] = BOOT_RESET_RJMP >> 8;
+		boardReset(board);
+	}
+
+	bus->transfer = simTransfer;
+	bus->close = simClose;
+	bus->priv = sim;
+	return bus;
+}
+
+void bootSimReport(ShcpBus_t* bus)
+{
+	BootSim_t* sim = (BootSim_t*)bus->priv;
+
+	printf("Simulated bus: %u transfers, %.2f s on the wire at %u Hz, %.2f s waiting on flash writes\n",
+		sim->transfers, sim->wireUs / 1e6, sim->clockHz, sim->stretchUs / 1e6);
+	for (uint8_t b=0; b<sim->numBoards; b++)
+	{
+		SimBoard_t* board = &sim->boards[b];
+		simCurrent = board;
+		printf("  board %2u (mux 0x%02X ch %u): %s, %u page writes, %u bytes hit by noise, vector 0x%04X\n",
+			b, SIM_MUX_BASE + b / SIM_MUX_CHANNELS, b % SIM_MUX_CHANNELS,
+			board->inBootloader?"in bootloader":"running application",
+			board->pageWrites, board->corrupted, bootFlashReadWord(BOOT_APP_VECTOR));
+	}
+}
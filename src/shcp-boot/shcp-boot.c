@@ -0,0 +1,627 @@
+/*************************************************************************
+Title:    SHCP I2C Firmware Uploader
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     shcp-boot.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "shcpBus.h"
+#include "shcpRegisters.h"
+#include "bootloader.h"
+
+#define MUX_BASE          0x70
+#define MUX_MAX              8
+#define MUX_CHANNELS         4
+#define MAX_TARGETS      (MUX_MAX * MUX_CHANNELS)
+#define MUX_NONE          0xFF
+
+#define ENTER_TRIES         10
+#define ENTER_WAIT_US    50000   // The application polls its registers every 50ms
+#define COMMAND_TRIES        4
+#define REPAIR_TRIES         3
+
+typedef struct
+{
+	uint8_t mux;
+	uint8_t channel;
+	bool present;
+	bool verified;
+	uint8_t repairs;
+} Target_t;
+
+Target_t targets[MAX_TARGETS];
+uint8_t numTargets = 0;
+
+uint8_t image[BOOT_START];
+uint16_t imageLen = 0;
+
+// How long to leave the boards after a page write.  The bootloader holds SCL
+//  while it's busy, but not every Linux I2C driver copes with that, so by
+//  default don't lean on it.
+uint32_t pageWaitUs = 10000;
+bool simulated = false;
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [options] (-f file.hex | -g bytes)\n", name);
+	fprintf(stderr, "  -d dev    I2C device (default /dev/i2c-1)\n");
+	fprintf(stderr, "  -M        no mux, one SHCP straight on the bus\n");
+	fprintf(stderr, "  -f file   Intel HEX file to upload (i2c-shcp.hex)\n");
+	fprintf(stderr, "  -g bytes  make up a random image this big instead\n");
+	fprintf(stderr, "  -S        one board at a time instead of broadcasting\n");
+	fprintf(stderr, "  -w us     wait after each page write (default %u)\n", pageWaitUs);
+	fprintf(stderr, "  -s boards simulate this many boards instead of a real bus\n");
+	fprintf(stderr, "  -e rate   simulated chance of a bit error per byte (default 0)\n");
+	fprintf(stderr, "  -c hz     simulated bus clock (default 400000)\n");
+	fprintf(stderr, "  -r count  upload this many times in a row (default 1)\n");
+	exit(1);
+}
+
+static uint64_t nowUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void waitUs(uint32_t us)
+{
+	if (!simulated && us)
+		usleep(us);
+}
+
+/*************************************************************************
+  Linux i2c-dev bus
+*************************************************************************/
+
+static bool i2cDevTransfer(ShcpBus_t* bus, uint8_t addr, const uint8_t* wdata, uint16_t wlen, uint8_t* rdata, uint16_t rlen)
+{
+	int fd = (int)(intptr_t)bus->priv;
+	struct i2c_msg msgs[2];
+	struct i2c_rdwr_ioctl_data xfer = { msgs, 0 };
+
+	if (wlen)
+	{
+		msgs[xfer.nmsgs].addr = addr;
+		msgs[xfer.nmsgs].flags = 0;
+		msgs[xfer.nmsgs].len = wlen;
+		msgs[xfer.nmsgs].buf = (uint8_t*)wdata;
+		xfer.nmsgs++;
+	}
+	if (rlen)
+	{
+		msgs[xfer.nmsgs].addr = addr;
+		msgs[xfer.nmsgs].flags = I2C_M_RD;
+		msgs[xfer.nmsgs].len = rlen;
+		msgs[xfer.nmsgs].buf = rdata;
+		xfer.nmsgs++;
+	}
+	return (ioctl(fd, I2C_RDWR, &xfer) >= 0);
+}
+
+static void i2cDevClose(ShcpBus_t* bus)
+{
+	close((int)(intptr_t)bus->priv);
+	free(bus);
+}
+
+ShcpBus_t* i2cDevOpen(const char* path)
+{
+	ShcpBus_t* bus;
+	int fd = open(path, O_RDWR);
+
+	if (fd < 0)
+		return NULL;
+
+	bus = calloc(1, sizeof(ShcpBus_t));
+	bus->transfer = i2cDevTransfer;
+	bus->close = i2cDevClose;
+	bus->priv = (void*)(intptr_t)fd;
+	return bus;
+}
+
+/*************************************************************************
+  Image
+*************************************************************************/
+
+static int hexByte(const char* s)
+{
+	int v;
+	return (1 == sscanf(s, "%2x", &v))?v:-1;
+}
+
+static bool readHex(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char line[600];
+	uint32_t base = 0;
+	uint32_t lineNum = 0;
+
+	if (NULL == f)
+	{
+		perror(path);
+		return false;
+	}
+
+	memset(image, 0xFF, sizeof(image));
+	while (fgets(line, sizeof(line), f))
+	{
+		int len, type;
+		uint32_t addr;
+		uint8_t sum = 0;
+
+		lineNum++;
+		if (':' != line[0])
+			continue;
+
+		len = hexByte(line + 1);
+		if (len < 0 || strlen(line) < 11 + 2 * (size_t)len)
+		{
+			fprintf(stderr, "%s:%u: short record\n", path, lineNum);
+			fclose(f);
+			return false;
+		}
+		for (int i=0; i<len + 5; i++)
+			sum += hexByte(line + 1 + 2*i);
+		if (0 != sum)
+		{
+			fprintf(stderr, "%s:%u: bad checksum\n", path, lineNum);
+			fclose(f);
+			return false;
+		}
+
+		addr = (hexByte(line + 3) << 8) | hexByte(line + 5);
+		type = hexByte(line + 7);
+
+		if (0x00 == type)
+		{
+			for (int i=0; i<len; i++)
+			{
+				uint32_t a = base + addr + i;
+				if (a >= BOOT_APP_VECTOR)
+				{
+					fprintf(stderr, "%s:%u: 0x%04X is past the end of the application space (0x%04X)\n", path, lineNum, a, BOOT_APP_VECTOR);
+					fclose(f);
+					return false;
+				}
+				image[a] = hexByte(line + 9 + 2*i);
+				if (a + 1 > imageLen)
+					imageLen = a + 1;
+			}
+		}
+		else if (0x01 == type)
+			break;
+		else if (0x02 == type)
+			base = ((hexByte(line + 9) << 8) | hexByte(line + 11)) << 4;
+		else if (0x04 == type)
+			base = ((hexByte(line + 9) << 8) | hexByte(line + 11)) << 16;
+	}
+	fclose(f);
+	return true;
+}
+
+// Random filler behind a reset vector that jumps past the vector table
+static void makeImage(uint16_t len)
+{
+	memset(image, 0xFF, sizeof(image));
+	srand48(len);
+	for (uint16_t i=0; i<len; i++)
+		image[i] = lrand48();
+	image[0] = (0xC000 | 0x0019) & 0xFF;
+	image[1] = (0xC000 | 0x0019) >> 8;
+	imageLen = len;
+}
+
+static uint16_t imageCrc(uint16_t addr, uint16_t len)
+{
+	uint16_t crc = 0xFFFF;
+	while (len--)
+		crc = bootCrc16(crc, image[addr++]);
+	return crc;
+}
+
+// Whole pages, the last one padded out with 0xFF
+static uint16_t pagesLen()
+{
+	return (imageLen + BOOT_PAGE_SIZE - 1) & ~(BOOT_PAGE_SIZE - 1);
+}
+
+// What the bootloader's CRC command covers - everything up to the vector
+static uint16_t crcLen()
+{
+	return (pagesLen() > BOOT_APP_VECTOR)?BOOT_APP_VECTOR:pagesLen();
+}
+
+/*************************************************************************
+  Mux and targets
+*************************************************************************/
+
+static const char* targetName(Target_t* t)
+{
+	static char name[24];
+	if (MUX_NONE == t->mux)
+		snprintf(name, sizeof(name), "SHCP 0x%02X", SHCP_I2C_ADDR);
+	else
+		snprintf(name, sizeof(name), "mux 0x%02X ch %u", t->mux, t->channel);
+	return name;
+}
+
+static bool muxSet(ShcpBus_t* bus, uint8_t mux, uint8_t mask)
+{
+	return bus->transfer(bus, mux, &mask, 1, NULL, 0);
+}
+
+// One board alone, so reads only come from it
+static void selectOnly(ShcpBus_t* bus, Target_t* t)
+{
+	for (uint8_t i=0; i<numTargets; i++)
+	{
+		if (MUX_NONE != targets[i].mux && targets[i].mux != t->mux && 0 == targets[i].channel)
+			muxSet(bus, targets[i].mux, 0);
+	}
+	if (MUX_NONE != t->mux)
+		muxSet(bus, t->mux, 1 << t->channel);
+}
+
+// Every board still in the running, for broadcasts
+static void selectAll(ShcpBus_t* bus)
+{
+	uint8_t mask[MUX_MAX] = {0};
+
+	for (uint8_t i=0; i<numTargets; i++)
+	{
+		if (targets[i].present && MUX_NONE != targets[i].mux)
+			mask[targets[i].mux - MUX_BASE] |= 1 << targets[i].channel;
+	}
+	for (uint8_t i=0; i<numTargets; i++)
+	{
+		if (MUX_NONE != targets[i].mux && 0 == targets[i].channel)
+			muxSet(bus, targets[i].mux, mask[targets[i].mux - MUX_BASE]);
+	}
+}
+
+static bool shcpRead(ShcpBus_t* bus, uint8_t reg, uint8_t* data, uint16_t len)
+{
+	return bus->transfer(bus, SHCP_I2C_ADDR, &reg, 1, data, len);
+}
+
+static void scan(ShcpBus_t* bus, bool noMux)
+{
+	uint8_t dummy;
+
+	numTargets = 0;
+	if (noMux)
+	{
+		targets[numTargets++] = (Target_t){ MUX_NONE, 0, true, false, 0 };
+		return;
+	}
+
+	for (uint8_t m=0; m<MUX_MAX; m++)
+	{
+		if (!muxSet(bus, MUX_BASE + m, 0))
+			continue;
+
+		// Each mux's channel 0 slot gets listed even if nothing answers there,
+		//  selectOnly() and selectAll() use it to find the mux
+		for (uint8_t c=0; c<MUX_CHANNELS; c++)
+		{
+			Target_t* t = &targets[numTargets];
+			*t = (Target_t){ MUX_BASE + m, c, false, false, 0 };
+			muxSet(bus, t->mux, 1 << c);
+			t->present = shcpRead(bus, BOOTREG_SIGNATURE, &dummy, 1);
+			if (t->present || 0 == c)
+				numTargets++;
+		}
+		muxSet(bus, MUX_BASE + m, 0);
+	}
+}
+
+/*************************************************************************
+  Bootloader commands
+*************************************************************************/
+
+static bool bootSend(ShcpBus_t* bus, uint8_t addr, uint8_t command, uint16_t start, uint16_t len, const uint8_t* page)
+{
+	uint8_t buf[BOOTREG_DATA + BOOT_PAGE_SIZE];
+	uint16_t crc = 0xFFFF;
+	uint16_t wlen = BOOTREG_DATA;
+
+	buf[0] = BOOTREG_COMMAND;
+	buf[BOOTREG_COMMAND] = command;
+	buf[BOOTREG_ADDR_L] = start & 0xFF;
+	buf[BOOTREG_ADDR_H] = start >> 8;
+	buf[BOOTREG_LEN_L] = len & 0xFF;
+	buf[BOOTREG_LEN_H] = len >> 8;
+	for (uint8_t i=BOOTREG_COMMAND; i<BOOTREG_CRC_L; i++)
+		crc = bootCrc16(crc, buf[i]);
+
+	if (NULL != page)
+	{
+		memcpy(buf + BOOTREG_DATA, page, BOOT_PAGE_SIZE);
+		for (uint8_t i=0; i<BOOT_PAGE_SIZE; i++)
+			crc = bootCrc16(crc, page[i]);
+		wlen += BOOT_PAGE_SIZE;
+	}
+
+	buf[BOOTREG_CRC_L] = crc & 0xFF;
+	buf[BOOTREG_CRC_H] = crc >> 8;
+
+	// buf[0] is the register index, so everything else lines up with the map
+	return bus->transfer(bus, addr, buf, wlen, NULL, 0);
+}
+
+// Addressed to the one selected board, retried until it says it took it
+static bool bootCommandChecked(ShcpBus_t* bus, uint8_t command, uint16_t start, uint16_t len, const uint8_t* page, uint16_t* result)
+{
+	for (uint8_t tries=0; tries<COMMAND_TRIES; tries++)
+	{
+		uint8_t status[5];
+
+		if (!bootSend(bus, SHCP_I2C_ADDR, command, start, len, page))
+			continue;
+		if (BOOT_CMD_WRITE_PAGE == command || BOOT_CMD_BEGIN == command)
+			waitUs(pageWaitUs);
+		if (!shcpRead(bus, BOOTREG_STATUS, status, sizeof(status)))
+			continue;
+		if (BOOT_STATUS_OK == status[0])
+		{
+			if (NULL != result)
+				*result = status[3] | ((uint16_t)status[4] << 8);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool enterBootloader(ShcpBus_t* bus, Target_t* t)
+{
+	uint8_t enter[2] = { SHCP_REG_BOOTLOADER, SHCP_BOOTLOADER_ENTER };
+
+	selectOnly(bus, t);
+	for (uint8_t tries=0; tries<ENTER_TRIES; tries++)
+	{
+		uint8_t sig[2];
+
+		if (shcpRead(bus, BOOTREG_SIGNATURE, sig, 1) && BOOT_SIGNATURE == sig[0]
+			&& shcpRead(bus, BOOTREG_VERSION, sig + 1, 1) && BOOT_VERSION == sig[1])
+			return true;
+
+		// If it's running the application this kicks it over, in the
+		//  bootloader it just lands in the page buffer
+		bus->transfer(bus, SHCP_I2C_ADDR, enter, sizeof(enter), NULL, 0);
+		usleep(simulated?0:ENTER_WAIT_US);
+	}
+	return false;
+}
+
+static bool verify(ShcpBus_t* bus, Target_t* t)
+{
+	uint16_t crc;
+
+	selectOnly(bus, t);
+	return bootCommandChecked(bus, BOOT_CMD_CRC, 0, crcLen(), NULL, &crc) && crc == imageCrc(0, crcLen());
+}
+
+// Find the pages that didn't make it and send just those, page 0 last as
+//  always so the application vector only comes back once the rest is right
+static bool repair(ShcpBus_t* bus, Target_t* t)
+{
+	bool bad[BOOT_START / BOOT_PAGE_SIZE] = {false};
+	uint16_t len = crcLen();
+
+	selectOnly(bus, t);
+	for (uint16_t page=0; page<len; page+=BOOT_PAGE_SIZE)
+	{
+		uint16_t pageLen = (len - page < BOOT_PAGE_SIZE)?(len - page):BOOT_PAGE_SIZE;
+		uint16_t crc;
+		if (!bootCommandChecked(bus, BOOT_CMD_CRC, page, pageLen, NULL, &crc) || crc != imageCrc(page, pageLen))
+			bad[page / BOOT_PAGE_SIZE] = true;
+	}
+
+	if (!bootCommandChecked(bus, BOOT_CMD_BEGIN, 0, 0, NULL, NULL))
+		return false;
+
+	for (int32_t page=pagesLen() - BOOT_PAGE_SIZE; page>=0; page-=BOOT_PAGE_SIZE)
+	{
+		if ((bad[page / BOOT_PAGE_SIZE] || 0 == page) && !bootCommandChecked(bus, BOOT_CMD_WRITE_PAGE, page, BOOT_PAGE_SIZE, image + page, NULL))
+			return false;
+	}
+	return true;
+}
+
+static void upload(ShcpBus_t* bus, bool sequential)
+{
+	uint16_t len = pagesLen();
+	uint64_t start = nowUs();
+	uint8_t good = 0;
+
+	for (uint8_t i=0; i<numTargets; i++)
+	{
+		Target_t* t = &targets[i];
+		if (!t->present)
+			continue;
+		t->verified = false;
+		t->repairs = 0;
+		if (!enterBootloader(bus, t))
+		{
+			printf("  %s: no bootloader, skipping\n", targetName(t));
+			t->present = false;
+		}
+	}
+
+	if (sequential)
+	{
+		for (uint8_t i=0; i<numTargets; i++)
+		{
+			Target_t* t = &targets[i];
+			if (!t->present)
+				continue;
+			selectOnly(bus, t);
+			bootSend(bus, SHCP_I2C_ADDR, BOOT_CMD_BEGIN, 0, 0, NULL);
+			waitUs(pageWaitUs);
+			for (int32_t page=pagesLen() - BOOT_PAGE_SIZE; page>=0; page-=BOOT_PAGE_SIZE)
+			{
+				bootSend(bus, SHCP_I2C_ADDR, BOOT_CMD_WRITE_PAGE, page, BOOT_PAGE_SIZE, image + page);
+				waitUs(pageWaitUs);
+			}
+		}
+	}
+	else
+	{
+		// One transfer per page for every board at once
+		selectAll(bus);
+		bootSend(bus, I2C_GENERAL_CALL, BOOT_CMD_BEGIN, 0, 0, NULL);
+		waitUs(pageWaitUs);
+		for (int32_t page=pagesLen() - BOOT_PAGE_SIZE; page>=0; page-=BOOT_PAGE_SIZE)
+		{
+			bootSend(bus, I2C_GENERAL_CALL, BOOT_CMD_WRITE_PAGE, page, BOOT_PAGE_SIZE, image + page);
+			waitUs(pageWaitUs);
+		}
+	}
+
+	// Broadcasts don't get answers, so check each board on its own
+	for (uint8_t i=0; i<numTargets; i++)
+	{
+		Target_t* t = &targets[i];
+		if (!t->present)
+			continue;
+
+		t->verified = verify(bus, t);
+		while (!t->verified && t->repairs < REPAIR_TRIES)
+		{
+			t->repairs++;
+			t->verified = repair(bus, t) && verify(bus, t);
+		}
+
+		if (t->verified)
+		{
+			uint8_t sig;
+			selectOnly(bus, t);
+			for (uint8_t tries=0; tries<COMMAND_TRIES; tries++)
+			{
+				bootSend(bus, SHCP_I2C_ADDR, BOOT_CMD_RUN, 0, 0, NULL);
+				// Once it's running the application the signature is gone
+				if (!shcpRead(bus, BOOTREG_SIGNATURE, &sig, 1) || BOOT_SIGNATURE != sig)
+					break;
+			}
+			good++;
+		}
+
+		printf("  %s: %s", targetName(t), t->verified?"ok":"FAILED");
+		if (t->repairs)
+			printf(" (%u repair pass%s)", t->repairs, (1 == t->repairs)?"":"es");
+		printf("\n");
+	}
+
+	if (MUX_NONE != targets[0].mux)
+	{
+		for (uint8_t i=0; i<numTargets; i++)
+		{
+			if (0 == targets[i].channel)
+				muxSet(bus, targets[i].mux, 0);
+		}
+	}
+
+	printf("%u bytes (%u pages) %s, %u board%s verified",
+		len, len / BOOT_PAGE_SIZE, sequential?"one board at a time":"by broadcast", good, (1 == good)?"":"s");
+	if (!simulated)
+		printf(", %.2f s", (nowUs() - start) / 1e6);
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* device = "/dev/i2c-1";
+	const char* hexFile = NULL;
+	uint32_t makeLen = 0;
+	uint32_t simBoards = 0;
+	double errorRate = 0;
+	uint32_t clockHz = 400000;
+	uint32_t repeats = 1;
+	bool noMux = false;
+	bool sequential = false;
+	ShcpBus_t* bus;
+	uint8_t present = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:Mf:g:Sw:s:e:c:r:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'd': device = optarg; break;
+			case 'M': noMux = true; break;
+			case 'f': hexFile = optarg; break;
+			case 'g': makeLen = atoi(optarg); break;
+			case 'S': sequential = true; break;
+			case 'w': pageWaitUs = atoi(optarg); break;
+			case 's': simBoards = atoi(optarg); break;
+			case 'e': errorRate = atof(optarg); break;
+			case 'c': clockHz = atoi(optarg); break;
+			case 'r': repeats = atoi(optarg); break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (NULL != hexFile)
+	{
+		if (!readHex(hexFile))
+			return 1;
+	}
+	else if (makeLen > 0 && makeLen < BOOT_APP_VECTOR)
+		makeImage(makeLen);
+	else
+		usage(argv[0]);
+
+	if (simBoards)
+	{
+		simulated = true;
+		bus = bootSimOpen(simBoards, errorRate, clockHz);
+	}
+	else if (NULL == (bus = i2cDevOpen(device)))
+	{
+		perror(device);
+		return 1;
+	}
+
+	scan(bus, noMux);
+	for (uint8_t i=0; i<numTargets; i++)
+		present += targets[i].present?1:0;
+	printf("Found %u SHCP%s, image %u bytes, CRC 0x%04X\n", present, (1 == present)?"":"s", imageLen, imageCrc(0, crcLen()));
+
+	for (uint32_t r=0; r<repeats; r++)
+		upload(bus, sequential);
+
+	if (simulated)
+		bootSimReport(bus);
+
+	bus->close(bus);
+	return 0;
+}
@@ -0,0 +1,46 @@
+/*************************************************************************
+Title:    SHCP Uploader Bus Interface
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     shcpBus.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _SHCP_BUS_H_
+#define _SHCP_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The uploader talks to either a real bus (/dev/i2c-N) or simulated boards
+//  (bootSim.c) through this
+
+#define I2C_GENERAL_CALL  0x00
+
+typedef struct ShcpBus
+{
+	// Whole transfers, START to STOP.  rlen of 0 is a plain write.
+	bool (*transfer)(struct ShcpBus* bus, uint8_t addr, const uint8_t* wdata, uint16_t wlen, uint8_t* rdata, uint16_t rlen);
+	void (*close)(struct ShcpBus* bus);
+	void* priv;
+} ShcpBus_t;
+
+ShcpBus_t* i2cDevOpen(const char* path);
+ShcpBus_t* bootSimOpen(uint8_t numBoards, double byteErrorRate, uint32_t clockHz);
+void bootSimReport(ShcpBus_t* bus);
+
+#endif
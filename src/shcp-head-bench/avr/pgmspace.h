@@ -0,0 +1,10 @@
+// Flash is just memory on the host
+#ifndef _BENCH_AVR_PGMSPACE_H_
+#define _BENCH_AVR_PGMSPACE_H_
+#include <stdint.h>
+#include <string.h>
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t*)(a))
+#define pgm_read_word(a) (*(const uint16_t*)(a))
+#define memcpy_P(d, s, n) memcpy((d), (s), (n))
+#endif
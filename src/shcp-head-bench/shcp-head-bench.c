@@ -0,0 +1,251 @@
+/*************************************************************************
+Title:    SHCP Signal Head Bench
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     shcp-head-bench.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+#include "signalHead.h"
+
+// What colorMix.h has, so the steady states can be checked against it.
+//  The EEPROM set starts out the same as RGB.
+static const uint8_t mixes[3][ASPECT_END][3] =
+{
+	{
+		{  0,  0,  0 }, {  0,  0, 32 }, {  0,  0, 32 }, {  0, 32,  0 },
+		{  0, 32,  0 }, { 32,  0,  0 }, { 32,  0,  0 }, {  0,  0,  0 }
+	},
+	{
+		{  0,  0,  0 }, {  0, 32, 10 }, {  0, 32, 10 }, { 32, 14,  0 },
+		{ 32, 14,  0 }, { 32,  0,  0 }, { 32,  0,  0 }, { 18, 22, 32 }
+	},
+	{
+		{  0,  0,  0 }, {  0, 32, 10 }, {  0, 32, 10 }, { 32, 14,  0 },
+		{ 32, 14,  0 }, { 32,  0,  0 }, { 32,  0,  0 }, { 18, 22, 32 }
+	}
+};
+
+static const char* mixNames[3] = { "lamp per color", "RGB", "EEPROM" };
+static const char* aspectNames[ASPECT_END] = { "off", "green", "fl green", "yellow", "fl yellow", "red", "fl red", "lunar" };
+
+#define MAX_FRAMES 64
+
+static int failures = 0;
+
+static void check(const char* what, int ok)
+{
+	printf("%-58s %s\n", what, ok?"ok":"FAILED");
+	if (!ok)
+		failures++;
+}
+
+// Full intensity is 248, 8 to a PWM step
+static uint8_t levelIntensity(uint8_t level)
+{
+	return ((uint16_t)level * 248) >> 5;
+}
+
+static void frame(SignalState_t* sig, uint8_t options, uint8_t* pwm)
+{
+	// Flashing aspects stay lit, the flasher isn't what's being looked at
+	signalHeadISR_AspectToNextPWM(sig, 1, options);
+	pwm[0] = sig->redPWM;
+	pwm[1] = sig->yellowPWM;
+	pwm[2] = sig->greenPWM;
+}
+
+static void settle(SignalState_t* sig, uint8_t options, SignalAspect_t aspect)
+{
+	uint8_t pwm[3];
+
+	signalHeadInitialize(sig);
+	signalHeadAspectSet(sig, aspect);
+	for (int i=0; i<MAX_FRAMES && !(sig->startAspect == aspect && sig->endAspect == aspect); i++)
+		frame(sig, options, pwm);
+}
+
+// Frames from the first one after the change up to the one that finishes
+//  it, or -1 if it never does
+static int transition(uint8_t options, SignalAspect_t from, SignalAspect_t to, uint8_t pwm[][3])
+{
+	SignalState_t sig;
+
+	settle(&sig, options, from);
+	signalHeadAspectSet(&sig, to);
+	for (int n=0; n<MAX_FRAMES; n++)
+	{
+		frame(&sig, options, pwm[n]);
+		if (sig.startAspect == to && sig.endAspect == to)
+			return n + 1;
+	}
+	return -1;
+}
+
+// The outputs show a mix if they're dark where it's dark and no dimmer
+//  where it's brighter, whatever the overall brightness
+static int follows(const uint8_t* pwm, const uint8_t* mix)
+{
+	for (int a=0; a<3; a++)
+	{
+		if (0 == mix[a] && 0 != pwm[a])
+			return 0;
+		for (int b=0; b<3; b++)
+			if (mix[a] > mix[b] && pwm[a] < pwm[b])
+				return 0;
+	}
+	return 1;
+}
+
+static void checkSteady(void)
+{
+	char what[80];
+
+	for (int set=0; set<3; set++)
+	{
+		int ok = 1;
+		int okDither = 1;
+
+		for (int aspect=0; aspect<ASPECT_END; aspect++)
+		{
+			SignalState_t sig;
+			uint8_t pwm[3];
+			uint16_t sum[3] = { 0, 0, 0 };
+
+			settle(&sig, SIGNAL_OPTION_MIX(set), aspect);
+			frame(&sig, SIGNAL_OPTION_MIX(set), pwm);
+			for (int c=0; c<3; c++)
+				ok &= (pwm[c] == levelIntensity(mixes[set][aspect][c]) >> 3);
+
+			// Dithered, 8 frames add up to the 8 bit intensity
+			settle(&sig, SIGNAL_OPTION_MIX(set) | SIGNAL_OPTION_DITHER, aspect);
+			for (int f=0; f<8; f++)
+			{
+				frame(&sig, SIGNAL_OPTION_MIX(set) | SIGNAL_OPTION_DITHER, pwm);
+				for (int c=0; c<3; c++)
+					sum[c] += pwm[c];
+			}
+			for (int c=0; c<3; c++)
+				okDither &= (sum[c] == levelIntensity(mixes[set][aspect][c]));
+		}
+		snprintf(what, sizeof(what), "%s steady aspects show their mix", mixNames[set]);
+		check(what, ok);
+		snprintf(what, sizeof(what), "%s dithered, they average out to it", mixNames[set]);
+		check(what, okDither);
+	}
+}
+
+// Every frame has to show one of the candidate mixes at some brightness.
+//  Green/yellow searchlights also get to show red, and red on top of the
+//  end aspect where the bounce overlaps it coming up.
+static void checkTransition(int set, bool searchlight, SignalAspect_t from, SignalAspect_t to)
+{
+	uint8_t options = SIGNAL_OPTION_MIX(set) | (searchlight?SIGNAL_OPTION_SEARCHLIGHT:0);
+	bool throughRed = searchlight
+		&& ((ASPECT_GREEN == from && ASPECT_YELLOW == to) || (ASPECT_YELLOW == from && ASPECT_GREEN == to));
+	const uint8_t* red = mixes[set][ASPECT_RED];
+	uint8_t endRed[3];
+	uint8_t pwm[MAX_FRAMES][3];
+	char what[80];
+	int ok = 1;
+	int sawRed = 0;
+	int frames = transition(options, from, to, pwm);
+
+	for (int c=0; c<3; c++)
+		endRed[c] = mixes[set][to][c] + red[c];
+
+	for (int n=0; n<frames; n++)
+	{
+		int shown = follows(pwm[n], mixes[set][from]) || follows(pwm[n], mixes[set][to]);
+		if (throughRed && !shown)
+			shown = follows(pwm[n], red) || follows(pwm[n], endRed);
+		ok &= shown;
+
+		// A dim yellow can round off to just its red, so red has to be
+		//  at least half on to count
+		if (follows(pwm[n], red) && pwm[n][0] >= 16)
+			sawRed = 1;
+	}
+	for (int c=0; frames > 0 && c<3; c++)
+		ok &= (pwm[frames - 1][c] == levelIntensity(mixes[set][to][c]) >> 3);
+
+	snprintf(what, sizeof(what), "%s %s %s to %s", mixNames[set], searchlight?"searchlight":"fade",
+		aspectNames[from], aspectNames[to]);
+	check(what, frames > 0 && ok && (!throughRed || sawRed));
+}
+
+// Turning dither on shouldn't change how a transition looks, only fill in
+//  between the frames.  Each dithered frame is somewhere between the
+//  undithered head's last frame and this one, give or take the dither.
+static void checkDither(int set, bool searchlight, SignalAspect_t from, SignalAspect_t to)
+{
+	uint8_t options = SIGNAL_OPTION_MIX(set) | (searchlight?SIGNAL_OPTION_SEARCHLIGHT:0);
+	uint8_t plain[MAX_FRAMES][3];
+	uint8_t dithered[MAX_FRAMES][3];
+	uint8_t steady[3];
+	char what[80];
+	int frames = transition(options, from, to, plain);
+	int ok = (frames > 0 && frames == transition(options | SIGNAL_OPTION_DITHER, from, to, dithered));
+
+	for (int c=0; c<3; c++)
+		steady[c] = levelIntensity(mixes[set][from][c]) >> 3;
+
+	for (int n=0; ok && n<frames; n++)
+	{
+		for (int c=0; c<3; c++)
+		{
+			uint8_t last = (n)?plain[n - 1][c]:steady[c];
+			uint8_t lo = (last < plain[n][c])?last:plain[n][c];
+			uint8_t hi = (last > plain[n][c])?last:plain[n][c];
+			ok &= (dithered[n][c] >= lo && dithered[n][c] <= hi + 1);
+		}
+	}
+
+	snprintf(what, sizeof(what), "%s %s %s to %s dithered follows it", mixNames[set], searchlight?"searchlight":"fade",
+		aspectNames[from], aspectNames[to]);
+	check(what, ok);
+}
+
+int main(void)
+{
+	checkSteady();
+
+	for (int set=0; set<3; set++)
+	{
+		checkTransition(set, false, ASPECT_YELLOW, ASPECT_RED);
+		checkTransition(set, false, ASPECT_GREEN, ASPECT_YELLOW);
+		checkTransition(set, false, ASPECT_LUNAR, ASPECT_GREEN);
+		checkTransition(set, true, ASPECT_YELLOW, ASPECT_RED);
+		checkTransition(set, true, ASPECT_RED, ASPECT_GREEN);
+		checkTransition(set, true, ASPECT_GREEN, ASPECT_YELLOW);
+		checkTransition(set, true, ASPECT_YELLOW, ASPECT_GREEN);
+	}
+
+	for (int set=0; set<3; set++)
+	{
+		checkDither(set, false, ASPECT_YELLOW, ASPECT_RED);
+		checkDither(set, false, ASPECT_OFF, ASPECT_GREEN);
+		checkDither(set, false, ASPECT_GREEN, ASPECT_OFF);
+		checkDither(set, true, ASPECT_YELLOW, ASPECT_RED);
+		checkDither(set, true, ASPECT_GREEN, ASPECT_YELLOW);
+	}
+
+	return failures?1:0;
+}
@@ -0,0 +1,4 @@
+#ifndef _BENCH_AVR_INTERRUPT_H_
+#define _BENCH_AVR_INTERRUPT_H_
+#define ISR(v, ...) void v(void)
+#endif
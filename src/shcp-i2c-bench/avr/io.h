@@ -0,0 +1,27 @@
+// Host stand-ins for the few ATtiny registers avr-i2c-slave.c touches.  The
+//  bench drives TWSR/TWDR itself and plays the part of the EEPROM.
+#ifndef _BENCH_AVR_IO_H_
+#define _BENCH_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(b) (1<<(b))
+
+extern volatile uint8_t TWBR, TWAR, TWCR, TWSR, TWDR;
+extern volatile uint16_t EEAR;
+extern volatile uint8_t EECR;
+
+// Reading EEDR after an EERE strobe gets the byte at EEAR, like the real one
+volatile uint8_t* benchEedr(void);
+#define EEDR (*benchEedr())
+
+#define TWIE   0
+#define TWEN   2
+#define TWSTO  4
+#define TWEA   6
+#define TWINT  7
+
+#define EERE   0
+#define EEPE   1
+
+#endif
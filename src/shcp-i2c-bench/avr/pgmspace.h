@@ -0,0 +1,17 @@
+// Flash is just memory on the host.  Pointers are wider than on the AVR, so
+//  a "word" read of one has to get all of it.
+#ifndef _BENCH_AVR_PGMSPACE_H_
+#define _BENCH_AVR_PGMSPACE_H_
+#include <stdint.h>
+#include <string.h>
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t*)(uintptr_t)(a))
+#define pgm_read_word(a) benchReadPointer(a)
+
+static inline uintptr_t benchReadPointer(const void* a)
+{
+	uintptr_t p;
+	memcpy(&p, a, sizeof(p));
+	return p;
+}
+#endif
@@ -0,0 +1,298 @@
+/*************************************************************************
+Title:    SHCP I2C Slave Bench
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     shcp-i2c-bench.c
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "avr-i2c-slave.h"
+
+// The TWI and EEPROM, as far as avr-i2c-slave.c can tell
+volatile uint8_t TWBR, TWAR, TWCR, TWSR, TWDR;
+volatile uint16_t EEAR;
+volatile uint8_t EECR;
+static volatile uint8_t eedr;
+static uint8_t eeprom[64];
+
+volatile uint8_t* benchEedr(void)
+{
+	if (EECR & _BV(EERE))
+	{
+		EECR &= ~_BV(EERE);
+		eedr = eeprom[EEAR & (sizeof(eeprom) - 1)];
+	}
+	return &eedr;
+}
+
+// Laid out like i2c-shcp.c, down to the read-only ranges
+#define MAP_SIZE     54
+#define PAGE_SELECT  52
+#define FRAME_STATUS 46
+
+volatile uint8_t i2c_registerMap[MAP_SIZE];
+const uint8_t i2c_registerMapSize = MAP_SIZE;
+const uint8_t i2c_frameStatusReg = FRAME_STATUS;
+const uint8_t i2c_pageSelectReg = PAGE_SELECT;
+
+const I2CRegisterRange i2c_registerRanges[] PROGMEM =
+{
+	{ 17, 21, I2CREG_ATTR_READONLY },
+	{ 26, 27, I2CREG_ATTR_READONLY },
+	{ 30, 34, I2CREG_ATTR_READONLY },
+	{ 39, 43, I2CREG_ATTR_READONLY },
+	{ 46, 48, I2CREG_ATTR_READONLY },
+	{ 49, 51, I2CREG_ATTR_READONLY },
+};
+const uint8_t i2c_registerRangeCount = sizeof(i2c_registerRanges) / sizeof(i2c_registerRanges[0]);
+
+// Something shaped like SignalState_t, to pick fields out of
+typedef struct
+{
+	uint8_t startAspect, endAspect, nextAspect;
+	uint8_t phase, redPWM, yellowPWM, greenPWM;
+	uint8_t ditherFrame;
+} Head;
+
+#define HEADS 8
+static Head heads[HEADS];
+static const uint8_t build[] PROGMEM = { 0x5C, 2, HEADS };
+
+#define PAGE_BUILD    0
+#define PAGE_OUTPUTS  1
+#define PAGE_ASPECTS  2
+#define PAGE_EEPROM   3
+
+const I2CPage i2c_pages[] PROGMEM =
+{
+	[PAGE_BUILD]   = { I2C_PAGE_FLASH,  sizeof(build), sizeof(build), sizeof(build), build },
+	[PAGE_OUTPUTS] = { I2C_PAGE_RAM,    4, sizeof(Head), 4 * HEADS, &heads[0].phase },
+	[PAGE_ASPECTS] = { I2C_PAGE_RAM,    1, sizeof(Head), HEADS, &heads[0].endAspect },
+	[PAGE_EEPROM]  = { I2C_PAGE_EEPROM, 4, 4, 4, (const void*)0x10 },
+};
+const uint8_t i2c_pageCount = sizeof(i2c_pages) / sizeof(i2c_pages[0]);
+
+static int failures = 0;
+
+static void check(const char* what, int ok)
+{
+	printf("%-58s %s\n", what, ok?"ok":"FAILED");
+	if (!ok)
+		failures++;
+}
+
+// One TWI event, as the hardware would hand it to the state machine
+static void twi(uint8_t status, uint8_t data)
+{
+	TWSR = status;
+	TWDR = data;
+	TWCR |= _BV(TWINT);
+	i2cSlaveService();
+}
+
+static void i2cWrite(const uint8_t* buf, int len)
+{
+	twi(I2C_SRX_ADR_ACK, 0);
+	for (int i=0; i<len; i++)
+		twi(I2C_SRX_ADR_DATA_ACK, buf[i]);
+	twi(I2C_SRX_STOP_RESTART, 0);
+}
+
+static void i2cWriteReg(uint8_t reg, uint8_t value)
+{
+	uint8_t buf[2] = { reg, value };
+	i2cWrite(buf, 2);
+}
+
+static void i2cRead(uint8_t reg, uint8_t* buf, int len)
+{
+	i2cWrite(&reg, 1);
+	twi(I2C_STX_ADR_ACK, 0);
+	buf[0] = TWDR;
+	for (int i=1; i<len; i++)
+	{
+		twi(I2C_STX_DATA_ACK, 0);
+		buf[i] = TWDR;
+	}
+	twi(I2C_STX_DATA_NACK, 0);
+}
+
+static uint8_t crc8(const uint8_t* buf, int len)
+{
+	uint8_t crc = 0;
+	for (int i=0; i<len; i++)
+	{
+		crc ^= buf[i];
+		for (int b=0; b<8; b++)
+			crc = (crc & 0x80)?((crc << 1) ^ 0x07):(crc << 1);
+	}
+	return crc;
+}
+
+static void checkAttributes(void)
+{
+	int ok = 1;
+
+	for (int r=0; r<MAP_SIZE; r++)
+	{
+		int readOnly = 0;
+		for (unsigned i=0; i<i2c_registerRangeCount; i++)
+			readOnly |= (r >= i2c_registerRanges[i].first && r <= i2c_registerRanges[i].last);
+		i2c_registerMap[r] = 0;
+		i2cWriteReg(r, 0xA5);
+		ok &= ((0xA5 == i2c_registerMap[r]) != readOnly);
+	}
+	check("read-only ranges hold, everything else writes", ok);
+
+	{
+		uint8_t buf[MAP_SIZE + 1];
+		memset(buf, 0x11, sizeof(buf));
+		buf[0] = 0;
+		i2cWrite(buf, sizeof(buf));
+		check("a block write from 0 reaches the last register", 0x11 == i2c_registerMap[MAP_SIZE - 1]);
+	}
+}
+
+static void checkPages(void)
+{
+	uint8_t buf[64];
+	int ok;
+
+	i2cWriteReg(PAGE_SELECT, PAGE_OUTPUTS);
+	i2cRead(I2C_PAGE_WINDOW, buf, 4 * HEADS + 2);
+	ok = 1;
+	for (int h=0; h<HEADS; h++)
+		ok &= (buf[4*h] == heads[h].phase && buf[4*h+1] == heads[h].redPWM
+			&& buf[4*h+2] == heads[h].yellowPWM && buf[4*h+3] == heads[h].greenPWM);
+	check("a RAM page picks its fields out of each element", ok);
+	check("past the end of a page reads 0xFF", 0xFF == buf[4 * HEADS] && 0xFF == buf[4 * HEADS + 1]);
+
+	i2cWriteReg(PAGE_SELECT, PAGE_BUILD);
+	i2cRead(I2C_PAGE_WINDOW + 1, buf, 3);
+	check("a read can start part way into a flash page", 2 == buf[0] && HEADS == buf[1] && 0xFF == buf[2]);
+
+	i2cWriteReg(PAGE_SELECT, 9);
+	i2cRead(I2C_PAGE_WINDOW, buf, 2);
+	check("a page that doesn't exist reads 0xFF", 0xFF == buf[0] && 0xFF == buf[1]);
+
+	{
+		Head saved[HEADS];
+		uint8_t write[5] = { I2C_PAGE_WINDOW, 1, 2, 3, 4 };
+		memcpy(saved, heads, sizeof(heads));
+		i2cWriteReg(PAGE_SELECT, PAGE_OUTPUTS);
+		i2cWrite(write, sizeof(write));
+		check("writes to the window go nowhere", 0 == memcmp(saved, heads, sizeof(heads)));
+	}
+
+	// Each byte is read as it goes out, nothing's kept from earlier
+	{
+		uint8_t reg = I2C_PAGE_WINDOW;
+		uint8_t red = heads[0].redPWM;
+		i2cWrite(&reg, 1);
+		twi(I2C_STX_ADR_ACK, 0);
+		heads[0].redPWM = 99;
+		twi(I2C_STX_DATA_ACK, 0);
+		check("RAM pages are read live", 99 == TWDR);
+		twi(I2C_STX_DATA_NACK, 0);
+		heads[0].redPWM = red;
+	}
+
+	// Reading one page and then running into the window from below has to
+	//  show the page selected now
+	i2cWriteReg(PAGE_SELECT, PAGE_OUTPUTS);
+	i2cRead(I2C_PAGE_WINDOW, buf, 8);
+	i2cWriteReg(PAGE_SELECT, PAGE_ASPECTS);
+	i2cRead(PAGE_SELECT - 1, buf, (I2C_PAGE_WINDOW - (PAGE_SELECT - 1)) + HEADS + 1);
+	ok = (buf[0] == i2c_registerMap[PAGE_SELECT - 1] && PAGE_ASPECTS == buf[1]);
+	for (int i=PAGE_SELECT + 1; i<MAP_SIZE; i++)
+		ok &= (buf[i - (PAGE_SELECT - 1)] == i2c_registerMap[i]);
+	for (int i=MAP_SIZE; i<I2C_PAGE_WINDOW; i++)
+		ok &= (0xFF == buf[i - (PAGE_SELECT - 1)]);
+	check("a read runs from the registers through the gap", ok);
+	ok = 1;
+	for (int h=0; h<HEADS; h++)
+		ok &= (buf[I2C_PAGE_WINDOW - (PAGE_SELECT - 1) + h] == heads[h].endAspect);
+	ok &= (0xFF == buf[I2C_PAGE_WINDOW - (PAGE_SELECT - 1) + HEADS]);
+	check("and into the window, getting the page selected now", ok);
+}
+
+static void checkEeprom(void)
+{
+	uint8_t buf[5];
+
+	i2cWriteReg(PAGE_SELECT, PAGE_EEPROM);
+	EEAR = 0x123;
+	eedr = 0x5A;
+	EECR = 0;
+	i2cRead(I2C_PAGE_WINDOW, buf, 5);
+	check("an EEPROM page reads what's in EEPROM",
+		0 == memcmp(buf, &eeprom[0x10], 4) && 0xFF == buf[4]);
+	check("and leaves the main loop's EEAR and EEDR alone", 0x123 == EEAR && 0x5A == eedr);
+
+	// Waiting out a write would stall the PWM timer for milliseconds
+	EECR = _BV(EEPE);
+	i2cRead(I2C_PAGE_WINDOW, buf, 2);
+	check("during an EEPROM write it reads 0xFF without waiting",
+		0xFF == buf[0] && 0xFF == buf[1] && 0x123 == EEAR && 0x5A == eedr);
+	EECR = 0;
+}
+
+static void checkFrames(void)
+{
+	uint8_t frame[7] = { I2C_FRAME_FLAG | 0, 1, 2, 3, 4, 7, 0 };
+	uint8_t good = i2c_registerMap[FRAME_STATUS + I2C_FRAME_STATUS_GOOD];
+	uint8_t rejects = i2c_registerMap[FRAME_STATUS + I2C_FRAME_STATUS_REJECTS];
+
+	frame[6] = crc8(frame, 6);
+	i2cWrite(frame, sizeof(frame));
+	check("a framed write lands whole",
+		1 == i2c_registerMap[0] && 4 == i2c_registerMap[3] && 7 == i2c_registerMap[FRAME_STATUS + I2C_FRAME_STATUS_SEQ]
+		&& (uint8_t)(good + 1) == i2c_registerMap[FRAME_STATUS + I2C_FRAME_STATUS_GOOD]);
+
+	frame[1] = 9;
+	i2cWrite(frame, sizeof(frame));
+	check("and one with a bad CRC doesn't land at all",
+		1 == i2c_registerMap[0] && (uint8_t)(rejects + 1) == i2c_registerMap[FRAME_STATUS + I2C_FRAME_STATUS_REJECTS]);
+}
+
+int main(void)
+{
+	for (int h=0; h<HEADS; h++)
+	{
+		heads[h].endAspect = h + 1;
+		heads[h].phase = h;
+		heads[h].redPWM = 10 + h;
+		heads[h].yellowPWM = 20 + h;
+		heads[h].greenPWM = 30 + h;
+	}
+	for (unsigned i=0; i<sizeof(eeprom); i++)
+		eeprom[i] = 0x80 + i;
+
+	i2cSlaveInitialize(0x40, false);
+
+	checkAttributes();
+	checkPages();
+	checkEeprom();
+	checkFrames();
+
+	return failures?1:0;
+}
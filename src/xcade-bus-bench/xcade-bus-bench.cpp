@@ -0,0 +1,262 @@
+/*************************************************************************
+Title:    XCade Dual I2C Bus Scheduler Bench
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     xcade-bus-bench.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "xcadeBus.h"
+
+#define EXPANDERS_PER_BOARD   3
+#define EXPANDER_BASE_ADDR    0x20
+#define MAX_BOARDS            (XCADE_BUS_MAX_JOBS / (2 * EXPANDERS_PER_BOARD))
+
+// PCA9555 registers
+#define PCA9555_INPUT         0x00
+#define PCA9555_OUTPUT        0x02
+
+static uint64_t nowUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Stand-in for a TwoWire with muxes and expanders hanging off it.  Every
+//  channel has the same set of expander addresses, just like the real boards.
+class StubBus : public XCadeBus
+{
+	public:
+		StubBus(uint32_t hz) : hz(hz), selected(XCADE_MUX_NONE)
+		{
+			memset(regs, 0, sizeof(regs));
+		}
+
+		bool muxSelect(uint8_t channel)
+		{
+			transfer(2);
+			selected = channel;
+			return true;
+		}
+
+		bool write(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t len)
+		{
+			uint8_t* dev = device(addr);
+			transfer(2 + len);
+			if (NULL == dev || reg + len > 8)
+				return false;
+			memcpy(dev + reg, data, len);
+			return true;
+		}
+
+		bool read(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len)
+		{
+			uint8_t* dev = device(addr);
+			transfer(3 + len);
+			if (NULL == dev || reg + len > 8)
+				return false;
+			// Inputs read back whatever was last written to the outputs
+			if (PCA9555_INPUT == reg)
+				memcpy(dev + PCA9555_INPUT, dev + PCA9555_OUTPUT, 2);
+			memcpy(data, dev + reg, len);
+			return true;
+		}
+
+		uint32_t clockHz() { return hz; }
+
+	private:
+		uint8_t* device(uint8_t addr)
+		{
+			if (selected >= MAX_BOARDS || addr < EXPANDER_BASE_ADDR || addr >= EXPANDER_BASE_ADDR + EXPANDERS_PER_BOARD)
+				return NULL;
+			return regs[selected][addr - EXPANDER_BASE_ADDR];
+		}
+
+		// Sleep for as long as the bytes would take, 9 clocks each
+		void transfer(uint8_t bytes)
+		{
+			usleep((useconds_t)(((uint64_t)bytes * 9 + 2) * 1000000 / hz));
+		}
+
+		uint32_t hz;
+		uint8_t selected;
+		uint8_t regs[MAX_BOARDS][EXPANDERS_PER_BOARD][8];
+};
+
+typedef struct
+{
+	XCadeBusJob out;
+	XCadeBusJob in;
+	uint8_t outData[2];
+	uint8_t inData[2];
+} Expander;
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-n boards] [-c clock Hz] [-r refreshes]\n", name);
+	fprintf(stderr, "  boards up to %u\n", MAX_BOARDS);
+	exit(1);
+}
+
+// Returns the average refresh time in us, or 0 if anything went wrong.
+//  overlap leaves bus 0 to the caller, see the README.
+static uint32_t bench(Expander* exp, uint8_t numExp, uint8_t buses, bool overlap, uint32_t hz, uint16_t refreshes, uint32_t* muxSwitches)
+{
+	StubBus bus0(hz), bus1(hz);
+	XCadeBusScheduler sched;
+	XCadeBusJob plan[XCADE_BUS_MAX_JOBS];
+	uint64_t start;
+	uint32_t errors = 0;
+
+	sched.begin(&bus0, (buses > 1)?&bus1:NULL);
+
+	// One plan entry per expander, then both jobs for that expander follow it
+	for (uint8_t i=0; i<numExp; i++)
+	{
+		plan[i] = exp[i].out;
+		plan[i].bus = XCADE_BUS_AUTO;
+	}
+	sched.plan(plan, numExp);
+
+	// Each bus has its own muxes, so hand out channels per bus
+	uint8_t nextChannel[XCADE_BUS_MAX] = {0, 0};
+	for (uint8_t i=0; i<numExp; i+=EXPANDERS_PER_BOARD)
+	{
+		uint8_t bus = plan[i].bus;
+		for (uint8_t j=i; j<i+EXPANDERS_PER_BOARD && j<numExp; j++)
+		{
+			exp[j].out.bus = exp[j].in.bus = bus;
+			exp[j].out.channel = exp[j].in.channel = nextChannel[bus];
+		}
+		nextChannel[bus]++;
+	}
+
+	start = nowUs();
+	for (uint16_t r=0; r<refreshes; r++)
+	{
+		sched.clear();
+		for (uint8_t i=0; i<numExp; i++)
+		{
+			exp[i].outData[0] = r + i;
+			exp[i].outData[1] = ~(r + i);
+			if (overlap && 0 == exp[i].out.bus)
+				continue;
+			sched.add(&exp[i].out);
+			sched.add(&exp[i].in);
+		}
+
+		if (!overlap)
+		{
+			if (!sched.run())
+				errors++;
+		}
+		else
+		{
+			uint8_t selected = XCADE_MUX_NONE;
+
+			sched.start();
+			for (uint8_t i=0; i<numExp; i++)
+			{
+				if (0 != exp[i].out.bus)
+					continue;
+				if (exp[i].out.channel != selected)
+				{
+					bus0.muxSelect(exp[i].out.channel);
+					selected = exp[i].out.channel;
+				}
+				if (!bus0.write(exp[i].out.addr, exp[i].out.reg, exp[i].outData, 2)
+					|| !bus0.read(exp[i].in.addr, exp[i].in.reg, exp[i].inData, 2))
+					errors++;
+			}
+			if (!sched.finish())
+				errors++;
+		}
+		for (uint8_t i=0; i<numExp; i++)
+		{
+			if (0 != memcmp(exp[i].outData, exp[i].inData, 2))
+				errors++;
+		}
+	}
+
+	*muxSwitches = sched.muxSwitches[0] + sched.muxSwitches[1];
+	if (errors)
+	{
+		printf("  %u errors\n", errors);
+		return 0;
+	}
+	return (uint32_t)((nowUs() - start) / refreshes);
+}
+
+int main(int argc, char** argv)
+{
+	Expander exp[MAX_BOARDS * EXPANDERS_PER_BOARD];
+	uint32_t boards = 16, hz = 100000, refreshes = 20;
+	uint32_t oneBus, twoBus, overlapped, switches1, switches2, switches3;
+	uint8_t numExp;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:c:r:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				boards = atoi(optarg);
+				break;
+			case 'c':
+				hz = atoi(optarg);
+				break;
+			case 'r':
+				refreshes = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (0 == boards || boards > MAX_BOARDS || 0 == hz || 0 == refreshes)
+		usage(argv[0]);
+
+	numExp = boards * EXPANDERS_PER_BOARD;
+	for (uint8_t i=0; i<numExp; i++)
+	{
+		XCadeBusJob out = { 0, (uint8_t)(EXPANDER_BASE_ADDR + i % EXPANDERS_PER_BOARD), PCA9555_OUTPUT, 2, exp[i].outData, false, 0, false };
+		XCadeBusJob in  = { 0, (uint8_t)(EXPANDER_BASE_ADDR + i % EXPANDERS_PER_BOARD), PCA9555_INPUT,  2, exp[i].inData,  true,  0, false };
+		exp[i].out = out;
+		exp[i].in = in;
+	}
+
+	printf("%u boards, %u expanders, %u Hz, %u refreshes\n", boards, numExp, hz, refreshes);
+
+	oneBus = bench(exp, numExp, 1, false, hz, refreshes, &switches1);
+	printf("One bus:  %8u us/refresh  %6u mux switches\n", oneBus, switches1);
+	twoBus = bench(exp, numExp, 2, false, hz, refreshes, &switches2);
+	printf("Two bus:  %8u us/refresh  %6u mux switches\n", twoBus, switches2);
+	overlapped = bench(exp, numExp, 2, true, hz, refreshes, &switches3);
+	printf("Overlap:  %8u us/refresh  %6u mux switches (bus 1 only)\n", overlapped, switches3);
+
+	if (0 == oneBus || 0 == twoBus || 0 == overlapped)
+		return 1;
+
+	printf("Speedup:  %u.%02ux, %u.%02ux overlapped\n", oneBus / twoBus, (oneBus % twoBus) * 100 / twoBus,
+		oneBus / overlapped, (oneBus % overlapped) * 100 / overlapped);
+	return 0;
+}
@@ -0,0 +1,482 @@
+/*************************************************************************
+Title:    XCade CAN Transport Bench
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcade-can-bench.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include "xcadeCan.h"
+#include "xcadeCanSocket.h"
+
+// Boards publish through a paced bus that stands in for the wire: each
+//  frame takes as long as its bits would at the bitrate, and when more than
+//  one board has something queued the lowest ID goes first, same as CAN
+//  arbitration.  vcan has no bitrate of its own, so without this everything
+//  would look instant.  Frames coming off the paced bus go either straight
+//  to the listeners or out through each board's own SocketCAN socket.
+
+#define TICK_US              100
+#define TX_QUEUE_FRAMES       16   // Same as XCADE_CAN_TWAI_TX_QUEUE
+#define MAX_BOARDS          (XCADE_CAN_MAX_NODES - 1)
+
+static uint64_t nowUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct
+{
+	XCadeCanFrame frame;
+	uint64_t queuedUs;
+} QueuedFrame;
+
+// Listener side port for the simulated bus
+class SimPort : public XCadeCanPort
+{
+	public:
+		bool send(const XCadeCanFrame* frame) { return false; }
+		bool receive(XCadeCanFrame* frame)
+		{
+			if (rx.empty())
+				return false;
+			*frame = rx.front();
+			rx.pop_front();
+			return true;
+		}
+		std::deque<XCadeCanFrame> rx;
+};
+
+// Time from a board queueing an event frame to a listener taking it, by
+//  the node and sequence number the frame carries
+class LatencyPort : public XCadeCanPort
+{
+	public:
+		LatencyPort(XCadeCanPort* port, uint64_t (*queued)[256], const uint64_t* now)
+			: port(port), queued(queued), now(now) {}
+
+		bool send(const XCadeCanFrame* frame) { return false; }
+		bool receive(XCadeCanFrame* frame)
+		{
+			if (!port->receive(frame))
+				return false;
+			if (frame->len && XCADE_CAN_STATE != XCADE_CAN_CLASS(frame->id))
+				latencies.push_back(*now - queued[XCADE_CAN_NODE(frame->id)][frame->data[0]]);
+			return true;
+		}
+
+		std::vector<uint32_t> latencies;
+
+	private:
+		XCadeCanPort* port;
+		uint64_t (*queued)[256];
+		const uint64_t* now;
+};
+
+class PacedBus
+{
+	public:
+		PacedBus(uint32_t bitrate) : bitrate(bitrate), busy(false), busyUs(0), frames(0), refreshFrames(0), bits(0), full(0), doneUs(0)
+		{
+			memset(queued, 0, sizeof(queued));
+			for (uint8_t i=0; i<XCADE_CAN_MAX_NODES; i++)
+				sockets[i] = NULL;
+		}
+
+		bool queue(const XCadeCanFrame* frame, uint64_t now)
+		{
+			std::deque<QueuedFrame>& q = txQueue[XCADE_CAN_NODE(frame->id)];
+			if (q.size() >= TX_QUEUE_FRAMES)
+			{
+				full++;
+				return false;
+			}
+			q.push_back({*frame, now});
+			return true;
+		}
+
+		// Finish whatever's on the wire by now and start the next
+		void run(uint64_t now)
+		{
+			while (1)
+			{
+				if (busy)
+				{
+					if (now < doneUs)
+						return;
+					deliver(&current);
+					busy = false;
+				}
+				// Back to back with the last frame, unless nothing was queued then
+				if (!start(doneUs))
+					return;
+			}
+		}
+
+		uint32_t bitrate;
+		bool busy;
+		uint64_t busyUs;
+		uint32_t frames;
+		uint32_t refreshFrames;
+		uint64_t bits;
+		uint32_t full;
+		uint64_t doneUs;
+		uint64_t queued[XCADE_CAN_MAX_NODES][256];
+		std::vector<SimPort*> listeners;
+		XCadeCanSocket* sockets[XCADE_CAN_MAX_NODES];
+
+	private:
+		// Every board whose transmit queue isn't empty competes with the
+		//  frame at the front of it
+		bool start(uint64_t at)
+		{
+			int winner = -1;
+			for (uint8_t n=1; n<XCADE_CAN_MAX_NODES; n++)
+			{
+				if (!txQueue[n].empty() && (winner < 0 || txQueue[n].front().frame.id < txQueue[winner].front().frame.id))
+					winner = n;
+			}
+			if (winner < 0)
+				return false;
+
+			current = txQueue[winner].front();
+			txQueue[winner].pop_front();
+			uint16_t frameBits = xcadeCanFrameBits(current.frame.len);
+			uint64_t frameUs = ((uint64_t)frameBits * 1000000 + bitrate - 1) / bitrate;
+			// Can't start before it was queued
+			doneUs = std::max(at, current.queuedUs) + frameUs;
+			busyUs += frameUs;
+			bits += frameBits;
+			busy = true;
+			return true;
+		}
+
+		void deliver(QueuedFrame* qf)
+		{
+			uint8_t node = XCADE_CAN_NODE(qf->frame.id);
+			queued[node][qf->frame.data[0]] = qf->queuedUs;
+			frames++;
+			if (XCADE_CAN_STATE == XCADE_CAN_CLASS(qf->frame.id))
+				refreshFrames++;
+
+			if (NULL != sockets[node])
+				sockets[node]->send(&qf->frame);
+			for (SimPort* l : listeners)
+				l->rx.push_back(qf->frame);
+		}
+
+		std::deque<QueuedFrame> txQueue[XCADE_CAN_MAX_NODES];
+		QueuedFrame current;
+};
+
+// What the board's CAN controller looks like from XCadeCanNode
+class BoardPort : public XCadeCanPort
+{
+	public:
+		BoardPort() : bus(NULL), now(NULL) {}
+		bool send(const XCadeCanFrame* frame) { return bus->queue(frame, *now); }
+		bool receive(XCadeCanFrame* frame) { return false; }
+		PacedBus* bus;
+		const uint64_t* now;
+};
+
+typedef struct
+{
+	const char* ifname;
+	uint8_t boards;
+	uint32_t bitrate;
+	double changesPerSec;
+	uint32_t refreshMs;
+	uint32_t seconds;
+	bool quiet;
+} BenchConfig;
+
+typedef struct
+{
+	double load;
+	uint32_t p50, p99, worst;
+	uint32_t frames;
+	uint32_t joinMs;       // 0 if the late listener never caught up
+	uint32_t mismatches;
+	uint32_t missed;
+	uint32_t deferred;
+	double bitsPerBoard;
+	bool ok;
+} BenchResult;
+
+// Something on the board changed: track occupancy, a sensor, or what a
+//  port's neighbour is showing
+static void randomChange(XCadeCanState* state)
+{
+	double r = drand48();
+	if (r < 0.5)
+		state->occupancy ^= 1 << (lrand48() % XCADE_CAN_PORTS);
+	else if (r < 0.8)
+		state->sensors ^= 1 << (lrand48() % 10);
+	else
+		state->indication[lrand48() % XCADE_CAN_PORTS] = lrand48() % 5;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& v, double p)
+{
+	if (v.empty())
+		return 0;
+	return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static bool bench(const BenchConfig* cfg, BenchResult* res)
+{
+	PacedBus bus(cfg->bitrate);
+	XCadeCanNode nodes[XCADE_CAN_MAX_NODES];
+	BoardPort boardPorts[XCADE_CAN_MAX_NODES];
+	XCadeCanState states[XCADE_CAN_MAX_NODES];
+	XCadeCanSocket boardSockets[XCADE_CAN_MAX_NODES];
+	XCadeCanSocket mainSocket, lateSocket;
+	SimPort mainSim, lateSim;
+	uint64_t now = 0;
+	LatencyPort mainPort(cfg->ifname?(XCadeCanPort*)&mainSocket:&mainSim, bus.queued, &now);
+	XCadeCanListener mainListener, lateListener;
+	uint64_t endUs = (uint64_t)cfg->seconds * 1000000;
+	// Quiet time at the end so every board's last change and one refresh
+	//  make it through before the listener gets checked
+	uint64_t settleUs = endUs + (uint64_t)cfg->refreshMs * 2000;
+	uint64_t joinUs = endUs / 2;
+	uint64_t joinedUs = 0;
+	bool lateJoined = false;
+	uint64_t startUs;
+
+	srand48(1);
+	memset(states, 0, sizeof(states));
+	memset(res, 0, sizeof(BenchResult));
+
+	if (cfg->ifname)
+	{
+		if (!mainSocket.open(cfg->ifname))
+			return false;
+		for (uint8_t n=1; n<=cfg->boards; n++)
+		{
+			if (!boardSockets[n].open(cfg->ifname, false))
+				return false;
+			bus.sockets[n] = &boardSockets[n];
+		}
+	}
+	else
+		bus.listeners.push_back(&mainSim);
+
+	mainListener.begin(&mainPort);
+	for (uint8_t n=1; n<=cfg->boards; n++)
+	{
+		boardPorts[n].bus = &bus;
+		boardPorts[n].now = &now;
+		nodes[n].begin(&boardPorts[n], n, cfg->refreshMs);
+	}
+
+	startUs = nowUs();
+	for (uint64_t t=0; t<settleUs; t+=TICK_US)
+	{
+		// Simulated time just jumps ahead, vcan runs in real time
+		now = t;
+		if (cfg->ifname)
+		{
+			while (nowUs() - startUs < t)
+				usleep(std::min((uint64_t)TICK_US, t - (nowUs() - startUs)));
+			now = nowUs() - startUs;
+		}
+
+		for (uint8_t n=1; n<=cfg->boards; n++)
+		{
+			if (t < endUs && drand48() < cfg->changesPerSec * TICK_US / 1e6)
+				randomChange(&states[n]);
+			nodes[n].update(&states[n], now / 1000);
+		}
+		bus.run(now);
+		mainListener.poll(now / 1000);
+
+		// A second listener that starts halfway through has to get
+		//  everything from the refreshes
+		if (!lateJoined && t >= joinUs)
+		{
+			lateJoined = true;
+			if (cfg->ifname)
+			{
+				if (!lateSocket.open(cfg->ifname))
+					return false;
+				lateListener.begin(&lateSocket);
+			}
+			else
+			{
+				bus.listeners.push_back(&lateSim);
+				lateListener.begin(&lateSim);
+			}
+		}
+		if (lateJoined)
+		{
+			lateListener.poll(now / 1000);
+			if (0 == joinedUs)
+			{
+				uint8_t n;
+				for (n=1; n<=cfg->boards; n++)
+				{
+					const XCadeCanRemote* r = lateListener.remote(n);
+					if (XCADE_CAN_HAVE_ALL != r->have || !xcadeCanStateEqual(&r->state, &states[n]))
+						break;
+				}
+				if (n > cfg->boards)
+					joinedUs = t;
+			}
+		}
+	}
+
+	for (uint8_t n=1; n<=cfg->boards; n++)
+	{
+		const XCadeCanRemote* r = mainListener.remote(n);
+		if (XCADE_CAN_HAVE_ALL != r->have || !xcadeCanStateEqual(&r->state, &states[n]))
+			res->mismatches++;
+		res->missed += r->missed;
+		res->deferred += nodes[n].sendBusy;
+	}
+
+	std::sort(mainPort.latencies.begin(), mainPort.latencies.end());
+	res->p50 = percentile(mainPort.latencies, 0.5);
+	res->p99 = percentile(mainPort.latencies, 0.99);
+	res->worst = mainPort.latencies.empty()?0:mainPort.latencies.back();
+	res->load = (double)bus.busyUs / settleUs;
+	res->frames = bus.frames;
+	res->joinMs = joinedUs?(uint32_t)((joinedUs - joinUs) / 1000):0;
+	res->bitsPerBoard = (double)bus.bits / cfg->boards / (settleUs / 1e6);
+	res->ok = (0 == res->mismatches && mainListener.framesReceived == bus.frames);
+
+	if (!cfg->quiet)
+	{
+		printf("%u boards, %u bit/s, %.1f changes/s per board, %u ms refresh, %u s on %s\n",
+			cfg->boards, cfg->bitrate, cfg->changesPerSec, cfg->refreshMs, cfg->seconds, cfg->ifname?cfg->ifname:"the simulated bus");
+		printf("  %u frames (%u refreshes), %.0f frames/s, bus load %.1f%%\n",
+			bus.frames, bus.refreshFrames, bus.frames / (settleUs / 1e6), res->load * 100);
+		printf("  event latency us: p50 %u  p99 %u  max %u  (%zu events)\n", res->p50, res->p99, res->worst, mainPort.latencies.size());
+		if (res->joinMs)
+			printf("  late listener had every board's state %u ms after joining\n", res->joinMs);
+		else
+			printf("  late listener never caught up\n");
+		printf("  %u frames received of %u, %u bad, %u missed sequence numbers\n",
+			mainListener.framesReceived, bus.frames, mainListener.badFrames, res->missed);
+		printf("  %u sends waited on a full transmit queue, %u boards wrong at the end\n", res->deferred, res->mismatches);
+		printf("  %.0f bits/s per board, so ~%.0f boards at 50%% load (node numbers stop at %u)\n",
+			res->bitsPerBoard, 0.5 * cfg->bitrate / res->bitsPerBoard, MAX_BOARDS);
+	}
+	return true;
+}
+
+// Most boards each bitrate carries inside the load and latency limits
+static void sweep(BenchConfig cfg, double loadLimit, uint32_t latencyLimitUs)
+{
+	static const uint32_t bitrates[] = { 125000, 250000, 500000 };
+
+	printf("Sweep, %.1f changes/s per board, %u ms refresh, limits %.0f%% load and %u us p99\n",
+		cfg.changesPerSec, cfg.refreshMs, loadLimit * 100, latencyLimitUs);
+	printf("  Bitrate  Boards   Load    p50 us   p99 us   max us\n");
+	cfg.quiet = true;
+
+	for (uint8_t b=0; b<sizeof(bitrates)/sizeof(bitrates[0]); b++)
+	{
+		BenchResult res, best;
+		uint8_t bestBoards = 0;
+
+		cfg.bitrate = bitrates[b];
+		for (uint32_t boards=8; boards<=MAX_BOARDS+7; boards+=8)
+		{
+			cfg.boards = std::min(boards, (uint32_t)MAX_BOARDS);
+			if (!bench(&cfg, &res))
+				return;
+			if (!res.ok || res.load > loadLimit || res.p99 > latencyLimitUs)
+				break;
+			best = res;
+			bestBoards = cfg.boards;
+		}
+
+		if (0 == bestBoards)
+			printf("  %7u  none fit\n", cfg.bitrate);
+		else
+			printf("  %7u  %6u  %5.1f%%  %8u %8u %8u%s\n", cfg.bitrate, bestBoards, best.load * 100, best.p50, best.p99, best.worst,
+				(MAX_BOARDS == bestBoards)?"  (out of node numbers)":"");
+	}
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [options]\n", name);
+	fprintf(stderr, "  -i if     SocketCAN interface (e.g. vcan0) instead of the simulated bus\n");
+	fprintf(stderr, "  -n boards boards on the segment, up to %u (default 16)\n", MAX_BOARDS);
+	fprintf(stderr, "  -b bps    bitrate (default 250000)\n");
+	fprintf(stderr, "  -e rate   input changes per second per board (default 4)\n");
+	fprintf(stderr, "  -r ms     state refresh period (default %u)\n", XCADE_CAN_REFRESH_MS);
+	fprintf(stderr, "  -t sec    how long to run (default 10)\n");
+	fprintf(stderr, "  -S        find the most boards 125k, 250k and 500k segments carry\n");
+	fprintf(stderr, "  -l pct    bus load limit for -S (default 50)\n");
+	fprintf(stderr, "  -L us     p99 latency limit for -S (default 5000)\n");
+	exit(1);
+}
+
+int main(int argc, char** argv)
+{
+	BenchConfig cfg = { NULL, 16, 250000, 4.0, XCADE_CAN_REFRESH_MS, 10, false };
+	BenchResult res;
+	bool doSweep = false;
+	double loadLimit = 0.5;
+	uint32_t latencyLimitUs = 5000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:n:b:e:r:t:Sl:L:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'i': cfg.ifname = optarg; break;
+			case 'n': cfg.boards = atoi(optarg); break;
+			case 'b': cfg.bitrate = atoi(optarg); break;
+			case 'e': cfg.changesPerSec = atof(optarg); break;
+			case 'r': cfg.refreshMs = atoi(optarg); break;
+			case 't': cfg.seconds = atoi(optarg); break;
+			case 'S': doSweep = true; break;
+			case 'l': loadLimit = atof(optarg) / 100; break;
+			case 'L': latencyLimitUs = atoi(optarg); break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (0 == cfg.boards || cfg.boards > MAX_BOARDS || 0 == cfg.bitrate || 0 == cfg.refreshMs || 0 == cfg.seconds)
+		usage(argv[0]);
+
+	if (doSweep)
+	{
+		sweep(cfg, loadLimit, latencyLimitUs);
+		return 0;
+	}
+
+	if (!bench(&cfg, &res))
+		return 1;
+	return res.ok?0:1;
+}
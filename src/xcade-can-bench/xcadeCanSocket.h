@@ -0,0 +1,124 @@
+/*************************************************************************
+Title:    XCade CAN Transport - SocketCAN Adapter
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+          Iowa Scaled Engineering
+File:     xcadeCanSocket.h
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#ifndef _XCADE_CAN_SOCKET_H_
+#define _XCADE_CAN_SOCKET_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include "xcadeCan.h"
+
+// Raw SocketCAN, for vcan or a USB adapter on a real segment.  Every socket
+//  on the interface sees every other socket's frames (but not its own), the
+//  same as separate boards on one bus.
+class XCadeCanSocket : public XCadeCanPort
+{
+	public:
+		XCadeCanSocket() : fd(-1) {}
+		~XCadeCanSocket() { close(); }
+
+		// Sockets that only send can skip receiving, so nothing piles up
+		bool open(const char* ifname, bool receiving = true)
+		{
+			struct ifreq ifr;
+			struct sockaddr_can addr;
+
+			fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+			if (fd < 0)
+			{
+				perror("socket");
+				return false;
+			}
+
+			memset(&ifr, 0, sizeof(ifr));
+			strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+			if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0)
+			{
+				fprintf(stderr, "%s: no such CAN interface\n", ifname);
+				close();
+				return false;
+			}
+
+			if (!receiving)
+				setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0);
+
+			memset(&addr, 0, sizeof(addr));
+			addr.can_family = AF_CAN;
+			addr.can_ifindex = ifr.ifr_ifindex;
+			if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+			{
+				perror("bind");
+				close();
+				return false;
+			}
+
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			return true;
+		}
+
+		void close()
+		{
+			if (fd >= 0)
+				::close(fd);
+			fd = -1;
+		}
+
+		bool send(const XCadeCanFrame* frame)
+		{
+			struct can_frame f;
+
+			memset(&f, 0, sizeof(f));
+			f.can_id = frame->id & CAN_SFF_MASK;
+			f.can_dlc = frame->len;
+			memcpy(f.data, frame->data, frame->len);
+			return (sizeof(f) == write(fd, &f, sizeof(f)));
+		}
+
+		bool receive(XCadeCanFrame* frame)
+		{
+			struct can_frame f;
+
+			while (sizeof(f) == read(fd, &f, sizeof(f)))
+			{
+				if (f.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG) || f.can_dlc > 8)
+					continue;
+				frame->id = f.can_id & CAN_SFF_MASK;
+				frame->len = f.can_dlc;
+				memcpy(frame->data, f.data, f.can_dlc);
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		int fd;
+};
+
+#endif
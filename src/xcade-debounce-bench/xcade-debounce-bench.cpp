@@ -0,0 +1,372 @@
+/*************************************************************************
+Title:    XCade Wide Input Debouncer Bench
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     xcade-debounce-bench.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "xcadeDebounce.h"
+
+extern "C"
+{
+#include "debouncer.h"
+}
+
+// Same as LOOP_UPDATE_TIME_MS and INPUT_*_SAMPLES in the sketch
+#define LOOP_MS          50
+#define SENSOR_SAMPLES   4
+#define MSS_SAMPLES      2
+#define MSS_PORTS        4
+
+static uint32_t seed = 1;
+static int failures = 0;
+
+static uint32_t rnd()
+{
+	// xorshift32, so runs repeat from the same -s
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static uint64_t rnd64()
+{
+	return ((uint64_t)rnd() << 32) | rnd();
+}
+
+static uint64_t nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void check(bool ok, const char* what)
+{
+	printf("%-58s %s\n", what, ok?"ok":"FAILED");
+	if (!ok)
+		failures++;
+}
+
+// Bouncy inputs: each bit holds for a while, and now and then chatters for
+//  a few samples first.  Runs are short enough to land either side of every
+//  depth.
+static uint64_t bounce(uint64_t* settled)
+{
+	uint64_t flip = rnd64() & rnd64() & rnd64();
+	uint64_t chatter = rnd64() & rnd64() & rnd64() & rnd64();
+	*settled ^= flip;
+	return *settled ^ chatter;
+}
+
+// One input the slow way, for comparing against
+typedef struct
+{
+	uint8_t state;
+	uint8_t run;
+	uint8_t depth;
+} ScalarInput;
+
+static bool scalarUpdate(ScalarInput* in, uint8_t raw)
+{
+	if (raw == in->state)
+	{
+		in->run = 0;
+		return false;
+	}
+	if (++in->run < in->depth)
+		return false;
+	in->state = raw;
+	in->run = 0;
+	return true;
+}
+
+// Depth 4 everywhere against debounce8() on each byte
+static void checkDebounce8(uint32_t samples)
+{
+	XCadeDebouncer<uint32_t> wide;
+	DebounceState8_t narrow[4];
+	uint64_t settled = 0, raw;
+	bool ok = true;
+
+	wide.begin(0, 4);
+	for (uint8_t b=0; b<4; b++)
+		initDebounceState8(&narrow[b], 0);
+
+	for (uint32_t i=0; i<samples && ok; i++)
+	{
+		uint32_t state = 0;
+		raw = bounce(&settled);
+		wide.update((uint32_t)raw);
+		for (uint8_t b=0; b<4; b++)
+		{
+			debounce8((raw >> (8*b)) & 0xFF, &narrow[b]);
+			state |= (uint32_t)getDebouncedState(&narrow[b]) << (8*b);
+		}
+		ok = (state == wide.debounced());
+	}
+	check(ok, "32 bit, depth 4, matches debounce8()");
+}
+
+// Random depth for every input against one counter per input
+template <typename Word, uint8_t Planes>
+static void checkScalar(uint32_t samples, const char* what)
+{
+	const uint8_t bits = sizeof(Word) * 8;
+	XCadeDebouncer<Word, Planes> wide;
+	ScalarInput inputs[64];
+	uint64_t settled = 0, raw;
+	bool ok = true;
+
+	wide.begin(0, 1);
+	for (uint8_t b=0; b<bits; b++)
+	{
+		inputs[b].state = inputs[b].run = 0;
+		inputs[b].depth = 1 + rnd() % (1 << Planes);
+		wide.setDepth((Word)1 << b, inputs[b].depth);
+	}
+
+	for (uint32_t i=0; i<samples && ok; i++)
+	{
+		Word changes, expected = 0, state = 0;
+
+		// Change a group's depth part way through now and then
+		if (0 == rnd() % 5000)
+		{
+			uint8_t b = rnd() % bits, depth = 1 + rnd() % (1 << Planes);
+			inputs[b].depth = depth;
+			inputs[b].run = 0;
+			wide.setDepth((Word)1 << b, depth);
+		}
+
+		raw = bounce(&settled);
+		changes = wide.update((Word)raw);
+		for (uint8_t b=0; b<bits; b++)
+		{
+			if (scalarUpdate(&inputs[b], (raw >> b) & 0x01))
+				expected |= (Word)1 << b;
+			state |= (Word)inputs[b].state << b;
+		}
+		ok = (changes == expected && state == wide.debounced());
+	}
+	check(ok, what);
+}
+
+// A clean step gets through on exactly the depth'th sample, and a glitch
+//  one sample short never does
+static void checkDepths()
+{
+	XCadeDebouncer<uint32_t, 4> d;
+	bool ok = true;
+
+	for (uint8_t depth=1; depth<=d.MAX_DEPTH; depth++)
+	{
+		uint8_t n;
+		d.begin(0, depth);
+		for (n=1; n<=d.MAX_DEPTH + 1; n++)
+			if (d.update(0xFFFFFFFF))
+				break;
+		ok = ok && (n == depth);
+
+		d.begin(0, depth);
+		for (n=1; n<depth; n++)
+			ok = ok && !d.update(0xFFFFFFFF);
+		ok = ok && !d.update(0);
+	}
+	check(ok, "steps take exactly depth samples, shorter glitches none");
+}
+
+// Indications change a line at a time, so on the way from one code to the
+//  next the port can decode codes that were never sent, for a sample or a
+//  few.  Whatever comes out has to be a value that came in depth samples in
+//  a row, right then.
+static void checkValues(uint32_t samples)
+{
+	XCadeValueDebouncer<MSS_PORTS> d;
+	uint8_t settled[MSS_PORTS] = { 0, 0, 0, 0 };
+	uint8_t history[MSS_PORTS][16];
+	bool ok = true;
+
+	for (uint8_t depth=1; depth<=8 && ok; depth++)
+	{
+		d.begin(settled, depth);
+		memset(history, 0, sizeof(history));
+		for (uint32_t i=0; i<samples / 8 && ok; i++)
+		{
+			for (uint8_t p=0; p<MSS_PORTS && ok; p++)
+			{
+				uint8_t raw;
+				bool held = true;
+
+				if (0 == rnd() % 8)
+					settled[p] = rnd() & 0x0F;
+				// Bits on their way to the new code, now and then
+				raw = (0 == rnd() % 3)?((settled[p] ^ rnd()) & 0x0F):settled[p];
+
+				memmove(&history[p][1], &history[p][0], sizeof(history[p]) - 1);
+				history[p][0] = raw;
+				if (d.update(p, raw))
+				{
+					for (uint8_t h=0; h<depth; h++)
+						held = held && (history[p][h] == raw);
+					ok = held && (d.debounced(p) == raw);
+				}
+			}
+		}
+	}
+	check(ok, "indications only change to a value held depth samples");
+}
+
+// One bit lands a sample ahead of the other.  The vertical counter passes
+//  the half-way code through, the value debouncer doesn't.
+static void checkTransition()
+{
+	const uint8_t from = 0x1, halfway = 0x3, to = 0x6;
+	const uint8_t seq[] = { halfway, to, to, to };
+	XCadeDebouncer<uint32_t> bits;
+	XCadeValueDebouncer<1> values;
+	bool bitsHalfway = false, valuesHalfway = false;
+
+	bits.begin(from, MSS_SAMPLES);
+	values.begin(&from, MSS_SAMPLES);
+	for (uint8_t i=0; i<sizeof(seq); i++)
+	{
+		bits.update(seq[i]);
+		values.update(0, seq[i]);
+		bitsHalfway = bitsHalfway || (bits.debounced() != from && bits.debounced() != to);
+		valuesHalfway = valuesHalfway || (values.debounced(0) != from && values.debounced(0) != to);
+	}
+	check(bitsHalfway && !valuesHalfway && to == values.debounced(0), "half-way codes get through bit-wise, not whole");
+}
+
+template <typename Word>
+static double benchWide(uint32_t boards, uint32_t samples, uint64_t* sink)
+{
+	const uint32_t perWord = sizeof(Word) / sizeof(uint32_t);
+	const uint32_t words = (boards + perWord - 1) / perWord;
+	XCadeDebouncer<Word>* d = new XCadeDebouncer<Word>[words];
+	Word* raw = new Word[words];
+	uint64_t start;
+
+	for (uint32_t w=0; w<words; w++)
+	{
+		d[w].begin(0, SENSOR_SAMPLES);
+		raw[w] = (Word)rnd64();
+	}
+
+	start = nowNs();
+	for (uint32_t i=0; i<samples; i++)
+		for (uint32_t w=0; w<words; w++)
+			*sink += d[w].update(raw[w] ^ (Word)i);
+	start = nowNs() - start;
+
+	delete[] d;
+	delete[] raw;
+	return (double)start / ((double)samples * boards);
+}
+
+static double benchDebounce8(uint32_t boards, uint32_t samples, uint64_t* sink)
+{
+	DebounceState8_t* d = new DebounceState8_t[boards * 4];
+	uint8_t* raw = new uint8_t[boards * 4];
+	uint64_t start;
+
+	for (uint32_t i=0; i<boards * 4; i++)
+	{
+		initDebounceState8(&d[i], 0);
+		raw[i] = rnd();
+	}
+
+	start = nowNs();
+	for (uint32_t i=0; i<samples; i++)
+		for (uint32_t b=0; b<boards * 4; b++)
+			*sink += debounce8(raw[b] ^ i, &d[b]);
+	start = nowNs() - start;
+
+	delete[] d;
+	delete[] raw;
+	return (double)start / ((double)samples * boards);
+}
+
+static void usage(const char* name)
+{
+	printf("Usage: %s [-n samples] [-b boards] [-s seed]\n", name);
+	printf("  -n  samples for the checks and the benchmark (default 1000000)\n");
+	printf("  -b  boards' worth of inputs to benchmark, 32 each (default 64)\n");
+	printf("  -s  random seed (default 1)\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t samples = 1000000;
+	uint32_t boards = 64;
+	uint64_t sink = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:s:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				samples = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				boards = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				seed = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (0 == seed || 0 == boards || 0 == samples)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	checkDebounce8(samples);
+	checkScalar<uint32_t, 3>(samples, "32 bit, depth 1-8 per input, matches one counter each");
+	checkScalar<uint64_t, 3>(samples, "64 bit, depth 1-8 per input, matches one counter each");
+	checkScalar<uint64_t, 4>(samples, "64 bit, depth 1-16 per input, matches one counter each");
+	checkDepths();
+	checkValues(samples);
+	checkTransition();
+
+	printf("\nAt %ums a loop, sensors and GPIO at %u samples take %ums, MSS ports at %u take %ums\n",
+		LOOP_MS, SENSOR_SAMPLES, SENSOR_SAMPLES * LOOP_MS, MSS_SAMPLES, MSS_SAMPLES * LOOP_MS);
+
+	samples = (samples / boards) + 1;
+	printf("\n%u boards, 32 inputs each, ns per board per sample:\n", boards);
+	printf("  debounce8() x4    %6.2f\n", benchDebounce8(boards, samples, &sink));
+	printf("  32 bit, 3 planes  %6.2f\n", benchWide<uint32_t>(boards, samples, &sink));
+	printf("  64 bit, 3 planes  %6.2f\n", benchWide<uint64_t>(boards, samples, &sink));
+	// Keeps the compiler from throwing the benchmark loops away
+	if (1 == sink)
+		printf("\n");
+
+	return failures?1:0;
+}
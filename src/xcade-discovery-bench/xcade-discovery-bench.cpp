@@ -0,0 +1,404 @@
+/*************************************************************************
+Title:    XCade Bus Discovery Bench
+Authors:  Michael Petersen <railfan@drgw.net>
+          Nathan D. Holmes <maverick@drgw.net>
+File:     xcade-discovery-bench.cpp
+License:  GNU General Public License v3
+
+LICENSE:
+    Copyright (C) 2025 Michael Petersen & Nathan Holmes
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "xcadeDiscovery.h"
+#include "shcpRegisters.h"
+
+#define EXPANDERS_PER_BOARD   3
+#define EXPANDER_BASE_ADDR    0x20
+#define MAX_DEVICES_PER_SLOT  8
+
+// Whatever an ordinary scanner would try, 0x08-0x77
+#define SCAN_FIRST_ADDR       0x08
+#define SCAN_LAST_ADDR        0x77
+
+#define SHCP_TEST_CAPS        (SHCP_CAP_FRAMED_WRITES | SHCP_CAP_FLIGHT_RECORDER | SHCP_CAP_DITHER)
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	printf("%-58s %s\n", what, ok?"ok":"FAILED");
+	if (!ok)
+		failures++;
+}
+
+typedef struct
+{
+	uint8_t addr;
+	uint8_t type;
+	uint8_t regs[64];
+} StubDevice;
+
+typedef struct
+{
+	uint8_t num;
+	StubDevice devices[MAX_DEVICES_PER_SLOT];
+} StubSlot;
+
+// Stand-in for a TwoWire with a PCA9546 and boards behind it.  Nothing sleeps,
+//  each bus just adds up how long its transfers would take on the wire, so
+//  the two buses' totals overlap the same way they would on the ESP32.
+//  Anything selected that shares an address answers together, the data
+//  wire-ANDed, like the real thing.
+class StubBus : public XCadeBus
+{
+	public:
+		StubBus(uint32_t hz) : hz(hz)
+		{
+			hasMux = false;
+			selected = 0;
+			memset(&front, 0, sizeof(front));
+			memset(behind, 0, sizeof(behind));
+			resetTime();
+		}
+
+		bool muxSelect(uint8_t channel)
+		{
+			if (!hasMux)
+			{
+				transfer(1);
+				return false;
+			}
+			transfer(2);
+			selected = 1 << channel;
+			return true;
+		}
+
+		bool write(uint8_t addr, uint8_t reg, const uint8_t* data, uint8_t len)
+		{
+			StubDevice* found[XCADE_BUS_MUX_CHANNELS + 1];
+
+			if (hasMux && XCADE_BUS_MUX_ADDR == addr)
+			{
+				transfer(2);
+				selected = reg & ((1 << XCADE_BUS_MUX_CHANNELS) - 1);
+				return true;
+			}
+			if (0 == responders(addr, found))
+			{
+				transfer(1);
+				return false;
+			}
+			transfer(2 + len);
+			return true;
+		}
+
+		bool read(uint8_t addr, uint8_t reg, uint8_t* data, uint8_t len)
+		{
+			StubDevice* found[XCADE_BUS_MUX_CHANNELS + 1];
+			uint8_t n = responders(addr, found);
+
+			if (0 == n)
+			{
+				transfer(1);
+				return false;
+			}
+			transfer(3 + len);
+			memset(data, 0xFF, len);
+			for (uint8_t i=0; i<n; i++)
+				for (uint8_t b=0; b<len; b++)
+					data[b] &= (reg + b < sizeof(found[i]->regs))?found[i]->regs[reg + b]:0xFF;
+			return true;
+		}
+
+		uint32_t clockHz() { return hz; }
+
+		StubDevice* add(uint8_t channel, uint8_t addr, uint8_t type)
+		{
+			StubSlot* slot = (XCADE_MUX_NONE == channel)?&front:&behind[channel];
+			StubDevice* dev = &slot->devices[slot->num++];
+
+			memset(dev, 0, sizeof(StubDevice));
+			dev->addr = addr;
+			dev->type = type;
+			if (XCADE_DEVICE_SHCP == type)
+			{
+				dev->regs[SHCP_REG_ID] = SHCP_ID;
+				dev->regs[SHCP_REG_FW_VERSION] = 1;
+				dev->regs[SHCP_REG_CAPABILITIES] = SHCP_TEST_CAPS;
+			}
+			return dev;
+		}
+
+		void remove(uint8_t channel, uint8_t addr)
+		{
+			StubSlot* slot = (XCADE_MUX_NONE == channel)?&front:&behind[channel];
+			for (uint8_t i=0; i<slot->num; i++)
+				if (slot->devices[i].addr == addr)
+					slot->devices[i] = slot->devices[--slot->num];
+		}
+
+		StubDevice* find(uint8_t channel, uint8_t addr)
+		{
+			StubSlot* slot = (XCADE_MUX_NONE == channel)?&front:&behind[channel];
+			for (uint8_t i=0; i<slot->num; i++)
+				if (slot->devices[i].addr == addr)
+					return &slot->devices[i];
+			return NULL;
+		}
+
+		void resetTime() { ns = 0; transactions = 0; }
+
+		bool hasMux;
+		StubSlot front;
+		StubSlot behind[XCADE_BUS_MUX_CHANNELS];
+		uint64_t ns;
+		uint32_t transactions;
+
+	private:
+		uint8_t responders(uint8_t addr, StubDevice** found)
+		{
+			uint8_t n = 0;
+			for (uint8_t i=0; i<front.num; i++)
+				if (front.devices[i].addr == addr)
+					found[n++] = &front.devices[i];
+			for (uint8_t ch=0; ch<XCADE_BUS_MUX_CHANNELS; ch++)
+			{
+				if (0 == (selected & (1 << ch)))
+					continue;
+				for (uint8_t i=0; i<behind[ch].num; i++)
+					if (behind[ch].devices[i].addr == addr)
+						found[n++] = &behind[ch].devices[i];
+			}
+			return n;
+		}
+
+		// 9 clocks a byte including the ACK, plus start and stop
+		void transfer(uint8_t bytes)
+		{
+			ns += ((uint64_t)bytes * 9 + 2) * 1000000000ULL / hz;
+			transactions++;
+		}
+
+		uint32_t hz;
+		uint8_t selected;
+};
+
+// Board b goes on bus b % buses, channel b / buses, with the XCade's own
+//  SHCP in front of the mux on bus 0
+static void buildLayout(StubBus** bus, uint8_t buses, uint8_t boards)
+{
+	for (uint8_t i=0; i<buses; i++)
+		bus[i]->hasMux = true;
+	bus[0]->add(XCADE_MUX_NONE, SHCP_I2C_ADDR, XCADE_DEVICE_SHCP);
+	for (uint8_t b=0; b<boards; b++)
+		for (uint8_t e=0; e<EXPANDERS_PER_BOARD; e++)
+			bus[b % buses]->add(b / buses, EXPANDER_BASE_ADDR + e, XCADE_DEVICE_PCA9555);
+}
+
+// Does the topology say exactly what the stub buses have
+static bool matches(const XCadeTopology* topo, StubBus** bus, uint8_t buses)
+{
+	uint8_t expected = 0;
+
+	for (uint8_t i=0; i<buses; i++)
+	{
+		expected += bus[i]->front.num;
+		for (uint8_t ch=0; ch<XCADE_BUS_MUX_CHANNELS; ch++)
+			expected += bus[i]->behind[ch].num;
+		if (bus[i]->hasMux != (0 != (topo->muxes & (1 << i))))
+			return false;
+	}
+	if (topo->numDevices != expected)
+		return false;
+
+	for (uint8_t d=0; d<topo->numDevices; d++)
+	{
+		const XCadeDevice* dev = &topo->devices[d];
+		StubDevice* stub;
+
+		if (dev->bus >= buses)
+			return false;
+		stub = bus[dev->bus]->find(dev->channel, dev->addr);
+		if (NULL == stub || stub->type != dev->type)
+			return false;
+		if (XCADE_DEVICE_SHCP == dev->type && 0 != memcmp(dev->id, stub->regs + SHCP_REG_ID, XCADE_DISCOVERY_ID_LEN))
+			return false;
+	}
+	return true;
+}
+
+// Both buses run at once, so it takes as long as the slower one
+static uint32_t elapsedUs(StubBus** bus, uint8_t buses)
+{
+	uint64_t ns = 0;
+	for (uint8_t i=0; i<buses; i++)
+		if (bus[i]->ns > ns)
+			ns = bus[i]->ns;
+	return (uint32_t)(ns / 1000);
+}
+
+static void resetTime(StubBus** bus, uint8_t buses)
+{
+	for (uint8_t i=0; i<buses; i++)
+		bus[i]->resetTime();
+}
+
+// For comparison, what a plain scanner does: every address on every channel
+//  of every bus, one bus after the other, then an identity read of whatever
+//  answered
+static uint32_t scanUs(StubBus** bus, uint8_t buses, uint32_t* transactions)
+{
+	uint8_t id[XCADE_DISCOVERY_ID_LEN];
+	uint64_t ns = 0;
+
+	*transactions = 0;
+	for (uint8_t i=0; i<buses; i++)
+	{
+		bus[i]->resetTime();
+		for (int16_t ch=-1; ch<XCADE_BUS_MUX_CHANNELS; ch++)
+		{
+			if (ch < 0)
+				bus[i]->write(XCADE_BUS_MUX_ADDR, 0x00, NULL, 0);
+			else
+				bus[i]->muxSelect(ch);
+			for (uint8_t addr=SCAN_FIRST_ADDR; addr<=SCAN_LAST_ADDR; addr++)
+				if (XCADE_BUS_MUX_ADDR != addr && bus[i]->write(addr, 0x00, NULL, 0))
+					bus[i]->read(addr, 0x00, id, sizeof(id));
+		}
+		bus[i]->write(XCADE_BUS_MUX_ADDR, 0x00, NULL, 0);
+		ns += bus[i]->ns;
+		*transactions += bus[i]->transactions;
+	}
+	return (uint32_t)(ns / 1000);
+}
+
+static void usage(const char* name)
+{
+	printf("Usage: %s [-n boards] [-b buses] [-c clock Hz]\n", name);
+	printf("  -n  boards, three expanders each behind a mux channel (default 4)\n");
+	printf("  -b  buses, 1 or 2 (default 1)\n");
+	printf("  -c  bus clock (default 100000)\n");
+	printf("  Each bus's mux has %u channels, so up to %u boards a bus\n", XCADE_BUS_MUX_CHANNELS, XCADE_BUS_MUX_CHANNELS);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t boards = 4, buses = 1, hz = 100000;
+	uint32_t discoverUs, validateUs, fullUs, scanTransactions;
+	uint16_t discoverJobs, validateJobs;
+	XCadeTopology topo, cached, again;
+	XCadeBusScheduler sched;
+	XCadeDiscovery discovery;
+	StubBus* bus[XCADE_BUS_MAX];
+	StubDevice* shcp;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:c:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				boards = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				buses = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				hz = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (0 == buses || buses > XCADE_BUS_MAX || boards > buses * XCADE_BUS_MUX_CHANNELS || 0 == hz)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (uint8_t i=0; i<XCADE_BUS_MAX; i++)
+		bus[i] = new StubBus(hz);
+	buildLayout(bus, buses, boards);
+	sched.begin(bus[0], (buses > 1)?bus[1]:NULL);
+	discovery.begin(&sched, buses);
+
+	printf("%u boards on %u bus%s at %u Hz, %u expanders and an SHCP\n\n",
+		boards, buses, (buses > 1)?"es":"", hz, boards * EXPANDERS_PER_BOARD);
+
+	// First boot
+	resetTime(bus, buses);
+	check(discovery.discover(&topo), "discover() finds something");
+	discoverUs = elapsedUs(bus, buses);
+	discoverJobs = discovery.lastJobs;
+	check(matches(&topo, bus, buses), "every device found, right place and type");
+	check(xcadeTopologyValid(&topo), "topology sealed");
+
+	// What comes back out of NVS on the next boot
+	memcpy(&cached, &topo, sizeof(cached));
+	resetTime(bus, buses);
+	check(discovery.validate(&cached), "validate() passes with nothing changed");
+	validateUs = elapsedUs(bus, buses);
+	validateJobs = discovery.lastJobs;
+
+	cached.devices[0].addr ^= 0x01;
+	check(!xcadeTopologyValid(&cached) && !discovery.validate(&cached), "a corrupted cache isn't trusted");
+	cached.devices[0].addr ^= 0x01;
+	cached.version++;
+	xcadeTopologySeal(&cached);
+	check(!discovery.validate(&cached), "a cache from another layout version isn't trusted");
+	cached.version--;
+	xcadeTopologySeal(&cached);
+
+	shcp = bus[0]->find(XCADE_MUX_NONE, SHCP_I2C_ADDR);
+	shcp->regs[SHCP_REG_FW_VERSION]++;
+	check(!discovery.validate(&cached), "new SHCP firmware fails validate()");
+	check(discovery.discover(&again) && matches(&again, bus, buses), "and discover() picks it up");
+	shcp->regs[SHCP_REG_FW_VERSION]--;
+
+	if (boards)
+	{
+		uint8_t last = boards - 1;
+		bus[last % buses]->remove(last / buses, EXPANDER_BASE_ADDR + 1);
+		check(!discovery.validate(&cached), "a missing expander fails validate()");
+		check(discovery.discover(&again) && matches(&again, bus, buses), "and discover() leaves it out");
+		bus[last % buses]->add(last / buses, EXPANDER_BASE_ADDR + 1, XCADE_DEVICE_PCA9555);
+		check(discovery.validate(&cached), "validate() passes once it's back");
+	}
+
+	bus[0]->remove(XCADE_MUX_NONE, SHCP_I2C_ADDR);
+	bus[0]->add(XCADE_MUX_NONE, SHCP_I2C_ADDR, XCADE_DEVICE_UNKNOWN);
+	check(discovery.discover(&again) && XCADE_DEVICE_UNKNOWN == again.devices[0].type,
+		"something else at the SHCP address isn't an SHCP");
+	check(!discovery.validate(&cached), "and fails validate()");
+
+	fullUs = scanUs(bus, buses, &scanTransactions);
+
+	printf("\n                        us  transactions\n");
+	printf("  full scan     %10u  %12u\n", fullUs, scanTransactions);
+	printf("  discover()    %10u  %12u\n", discoverUs, discoverJobs);
+	printf("  validate()    %10u  %12u\n", validateUs, validateJobs);
+	if (discoverUs && validateUs)
+		printf("  discover() %.1fx faster than a full scan, validate() %.1fx\n",
+			(double)fullUs / discoverUs, (double)fullUs / validateUs);
+	printf("\n");
+
+	for (uint8_t i=0; i<XCADE_BUS_MAX; i++)
+		delete bus[i];
+	return failures?1:0;
+}